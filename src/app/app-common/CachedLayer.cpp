@@ -26,29 +26,71 @@
 
 #include <DirectXColors.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace OpenKneeboard {
 
-CachedLayer::CachedLayer(const audited_ptr<DXResources>& dxr) : mDXR(dxr) {
+CachedLayer::CachedLayer(const audited_ptr<DXResources>& dxr, size_t maxBytes)
+  : mDXR(dxr), mMaxBytes(maxBytes) {
 }
 
 CachedLayer::~CachedLayer() {
 }
 
-void CachedLayer::Render(
-  const PixelRect& destRect,
+CachedLayer::Entry& CachedLayer::GetEntry(
   Key cacheKey,
-  RenderTarget* rt,
-  std::function<void(RenderTarget*, const PixelSize&)> impl,
-  const std::optional<PixelSize>& providedCacheDimensions) {
-  std::scoped_lock lock(mCacheMutex);
+  const std::function<void(RenderTarget*, const PixelSize&)>& impl,
+  const PixelSize& cacheDimensions) {
+  auto it = std::ranges::find_if(mEntries, [&](const Entry& entry) {
+    return entry.mKey == cacheKey && entry.mDimensions == cacheDimensions;
+  });
+  if (it != mEntries.end()) {
+    ++mStatistics.mHits;
+    mEntries.splice(mEntries.begin(), mEntries, it);
+    return mEntries.front();
+  }
 
-  const PixelSize cacheDimensions
-    = providedCacheDimensions ? *providedCacheDimensions : destRect.mSize;
+  ++mStatistics.mMisses;
+
+  const size_t bytes = static_cast<size_t>(cacheDimensions.mWidth)
+    * cacheDimensions.mHeight * sizeof(uint32_t);
+
+  // Evict least-recently-used entries until the new one fits; if we evict an
+  // entry with the same dimensions, reuse its texture instead of creating a
+  // new one.
+  //
+  // Entries that are currently shown are kept, even if over budget; otherwise
+  // prefetches or other views would evict them, and they'd need to be
+  // rendered again on the next repaint.
+  const auto now = std::chrono::steady_clock::now();
+  std::erase_if(mDisplays, [now](const auto& it) {
+    return now - it.second.mLastRenderedAt > DisplayPinTime;
+  });
+  std::list<Entry> recycled;
+  auto candidates = mEntries.end();
+  while (
+    candidates != mEntries.begin()
+    && mStatistics.mBytes + bytes > mMaxBytes) {
+    const auto lru = std::prev(candidates);
+    if (this->IsDisplayed(*lru)) {
+      candidates = lru;
+      continue;
+    }
+    ++mStatistics.mEvictions;
+    mStatistics.mBytes -= lru->mBytes;
+    if (recycled.empty() && lru->mDimensions == cacheDimensions) {
+      recycled.splice(recycled.begin(), mEntries, lru);
+    } else {
+      mEntries.erase(lru);
+    }
+  }
 
-  if (mCacheDimensions != cacheDimensions || !mCache) {
-    mKey = ~Key {0};
-    mCache = nullptr;
-    mCacheDimensions = cacheDimensions;
+  if (recycled.empty()) {
+    Entry entry {
+      .mDimensions = cacheDimensions,
+      .mBytes = bytes,
+    };
     D3D11_TEXTURE2D_DESC textureDesc {
       .Width = cacheDimensions.mWidth,
       .Height = cacheDimensions.mHeight,
@@ -59,44 +101,106 @@ void CachedLayer::Render(
       .Usage = D3D11_USAGE_DEFAULT,
       .BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET,
     };
-    winrt::check_hresult(
-      mDXR->mD3D11Device->CreateTexture2D(&textureDesc, nullptr, mCache.put()));
+    winrt::check_hresult(mDXR->mD3D11Device->CreateTexture2D(
+      &textureDesc, nullptr, entry.mTexture.put()));
     winrt::check_hresult(mDXR->mD3D11Device->CreateShaderResourceView(
-      mCache.get(), nullptr, mCacheSRV.put()));
-    mCacheRenderTarget = RenderTarget::Create(mDXR, mCache);
+      entry.mTexture.get(), nullptr, entry.mSRV.put()));
+    entry.mRenderTarget = RenderTarget::Create(mDXR, entry.mTexture);
+    mEntries.push_front(std::move(entry));
+  } else {
+    mEntries.splice(mEntries.begin(), recycled);
   }
 
-  if (mKey != cacheKey) {
-    {
-      auto d3d = mCacheRenderTarget->d3d();
-      mDXR->mD3D11ImmediateContext->ClearRenderTargetView(
-        d3d.rtv(), DirectX::Colors::Transparent);
-    }
-    impl(mCacheRenderTarget.get(), cacheDimensions);
-    mKey = cacheKey;
+  auto& entry = mEntries.front();
+  mStatistics.mBytes += entry.mBytes;
+  mStatistics.mEntryCount = mEntries.size();
+
+  // Invalidate before rendering, in case `impl` throws
+  entry.mKey = ~Key {0};
+  {
+    auto d3d = entry.mRenderTarget->d3d();
+    mDXR->mD3D11ImmediateContext->ClearRenderTargetView(
+      d3d.rtv(), DirectX::Colors::Transparent);
   }
+  impl(entry.mRenderTarget.get(), cacheDimensions);
+  entry.mKey = cacheKey;
+
+  return entry;
+}
+
+void CachedLayer::Render(
+  const PixelRect& destRect,
+  Key cacheKey,
+  RenderTarget* rt,
+  std::function<void(RenderTarget*, const PixelSize&)> impl,
+  const std::optional<PixelSize>& providedCacheDimensions) {
+  std::scoped_lock lock(mCacheMutex);
+
+  const PixelSize cacheDimensions
+    = providedCacheDimensions ? *providedCacheDimensions : destRect.mSize;
+
+  // Before `GetEntry()`, so that what this render target showed previously
+  // can be evicted
+  mDisplays.insert_or_assign(
+    rt->GetID(),
+    Display {
+      .mKey = cacheKey,
+      .mDimensions = cacheDimensions,
+      .mLastRenderedAt = std::chrono::steady_clock::now(),
+    });
+  const auto& entry = this->GetEntry(cacheKey, impl, cacheDimensions);
 
   auto d3d = rt->d3d();
 
   const PixelRect sourceRect {
     {0, 0},
-    mCacheDimensions,
+    entry.mDimensions,
   };
 
   auto sb = mDXR->mSpriteBatch.get();
 
   sb->Begin(d3d.rtv(), rt->GetDimensions());
-  sb->Draw(mCacheSRV.get(), sourceRect, destRect);
+  sb->Draw(entry.mSRV.get(), sourceRect, destRect);
   sb->End();
 }
 
+void CachedLayer::Prefetch(
+  Key cacheKey,
+  std::function<void(RenderTarget*, const PixelSize&)> impl,
+  const PixelSize& cacheDimensions) {
+  std::scoped_lock lock(mCacheMutex);
+  const auto hits = mStatistics.mHits;
+  // Always move the prefetched entry to the front, even if it was already
+  // cached; it's expected to be requested soon
+  this->GetEntry(cacheKey, impl, cacheDimensions);
+  if (mStatistics.mHits != hits) {
+    // Don't count prefetches as hits
+    --mStatistics.mHits;
+  } else {
+    --mStatistics.mMisses;
+    ++mStatistics.mPrefetches;
+  }
+}
+
 void CachedLayer::Reset() {
   std::scoped_lock lock(mCacheMutex);
 
-  mKey = ~Key {0};
-  mCache = nullptr;
-  mCacheRenderTarget = nullptr;
-  mCacheSRV = nullptr;
+  mEntries.clear();
+  mDisplays.clear();
+  mStatistics.mBytes = 0;
+  mStatistics.mEntryCount = 0;
+}
+
+bool CachedLayer::IsDisplayed(const Entry& entry) const {
+  return std::ranges::any_of(mDisplays, [&entry](const auto& it) {
+    return it.second.mKey == entry.mKey
+      && it.second.mDimensions == entry.mDimensions;
+  });
+}
+
+CachedLayer::Statistics CachedLayer::GetStatistics() const {
+  std::scoped_lock lock(mCacheMutex);
+  return mStatistics;
 }
 
 }// namespace OpenKneeboard
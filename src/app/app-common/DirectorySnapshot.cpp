@@ -0,0 +1,270 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/DirectorySnapshot.h>
+#include <OpenKneeboard/Win32.h>
+
+#include <OpenKneeboard/dprint.h>
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+namespace OpenKneeboard {
+
+namespace {
+
+bool FilesystemHasReliableDirectoryTimes(const std::filesystem::path& root) {
+  wchar_t volume[MAX_PATH];
+  if (!GetVolumePathNameW(root.c_str(), volume, MAX_PATH)) {
+    return false;
+  }
+  wchar_t filesystem[MAX_PATH + 1];
+  if (!GetVolumeInformationW(
+        volume,
+        nullptr,
+        0,
+        nullptr,
+        nullptr,
+        nullptr,
+        filesystem,
+        MAX_PATH + 1)) {
+    return false;
+  }
+  const std::wstring_view name {filesystem};
+  return name == L"NTFS" || name == L"ReFS";
+}
+
+std::filesystem::file_time_type ToFileTime(const LARGE_INTEGER& value) {
+  // MSVC's `file_clock` uses the same epoch and tick length as FILETIME
+  return std::filesystem::file_time_type {
+    std::filesystem::file_time_type::duration {value.QuadPart}};
+}
+
+std::filesystem::file_time_type ToFileTime(const FILETIME& value) {
+  LARGE_INTEGER ret {};
+  ret.LowPart = value.dwLowDateTime;
+  ret.HighPart = static_cast<LONG>(value.dwHighDateTime);
+  return ToFileTime(ret);
+}
+
+}// namespace
+
+bool DirectorySnapshot::Diff::IsEmpty() const noexcept {
+  return mAdded.empty() && mRemoved.empty() && mModified.empty()
+    && mRenamed.empty();
+}
+
+DirectorySnapshot::DirectorySnapshot(const std::filesystem::path& root)
+  : mRoot(root) {
+  mTrustDirectoryTimes = FilesystemHasReliableDirectoryTimes(root);
+}
+
+std::filesystem::path DirectorySnapshot::GetRoot() const {
+  return mRoot;
+}
+
+const std::map<std::filesystem::path, DirectorySnapshot::FileInfo>&
+DirectorySnapshot::GetFiles() const {
+  return mFiles;
+}
+
+DirectorySnapshot::Diff DirectorySnapshot::Update(
+  const std::set<std::filesystem::path>& recheck) {
+  Diff diff {.mIsInitialScan = !mScanned};
+  mScanned = true;
+  decltype(mDirectories) directories;
+  decltype(mFiles) removed;
+
+  std::vector<std::filesystem::path> pending {mRoot};
+  while (!pending.empty()) {
+    const auto directory = std::move(pending.back());
+    pending.pop_back();
+
+    const auto handle = Win32::CreateFileW(
+      directory.c_str(),
+      FILE_LIST_DIRECTORY,
+      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+      nullptr,
+      OPEN_EXISTING,
+      FILE_FLAG_BACKUP_SEMANTICS,
+      NULL);
+    FILE_BASIC_INFO basicInfo {};
+    if (
+      (!handle)
+      || !GetFileInformationByHandleEx(
+        handle.get(), FileBasicInfo, &basicInfo, sizeof(basicInfo))) {
+      // Removed while we were scanning; any files will be picked up as
+      // removed below, and we'll get another notification if it comes back
+      continue;
+    }
+    const auto lastWriteTime = ToFileTime(basicInfo.LastWriteTime);
+
+    const auto previous = mDirectories.find(directory);
+    if (
+      mTrustDirectoryTimes && previous != mDirectories.end()
+      && previous->second.mLastWriteTime == lastWriteTime) {
+      auto& info = directories[directory];
+      info = std::move(previous->second);
+      std::ranges::copy(info.mSubdirectories, std::back_inserter(pending));
+      continue;
+    }
+
+    // Unlike `std::filesystem::directory_iterator`, this gives us the file
+    // IDs without having to open every file
+    DirectoryInfo info {lastWriteTime};
+    alignas(FILE_ID_BOTH_DIR_INFO) std::byte buffer[16 * 1024];
+    auto infoClass = FileIdBothDirectoryRestartInfo;
+    while (GetFileInformationByHandleEx(
+      handle.get(), infoClass, buffer, sizeof(buffer))) {
+      infoClass = FileIdBothDirectoryInfo;
+      size_t offset = 0;
+      DWORD lastEntryOffset = 0;
+      do {
+        const auto& entry
+          = *reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(buffer + offset);
+        const std::wstring_view name {
+          entry.FileName, entry.FileNameLength / sizeof(wchar_t)};
+        lastEntryOffset = entry.NextEntryOffset;
+        offset += entry.NextEntryOffset;
+        if (name == L"." || name == L"..") {
+          continue;
+        }
+
+        auto path = directory / name;
+        if (entry.FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+          // Match `recursive_directory_iterator`: don't follow directory
+          // symlinks or junctions
+          if (!(entry.FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+            info.mSubdirectories.push_back(path);
+            pending.push_back(std::move(path));
+          }
+          continue;
+        }
+
+        const FileInfo file {
+          .mSize = static_cast<uint64_t>(entry.EndOfFile.QuadPart),
+          .mLastWriteTime = ToFileTime(entry.LastWriteTime),
+          .mFileID = static_cast<uint64_t>(entry.FileId.QuadPart),
+        };
+        info.mFiles.push_back(path);
+
+        auto existing = mFiles.find(path);
+        if (existing == mFiles.end()) {
+          mFiles.emplace(path, file);
+          diff.mAdded.push_back(std::move(path));
+          continue;
+        }
+        if (
+          existing->second.mSize != file.mSize
+          || existing->second.mLastWriteTime != file.mLastWriteTime) {
+          existing->second = file;
+          diff.mModified.push_back(std::move(path));
+        }
+      } while (lastEntryOffset);
+    }
+    if (const auto error = GetLastError(); error != ERROR_NO_MORE_FILES) {
+      dprintf("Error listing directory '{}': {:#08x}", directory, error);
+    }
+
+    std::ranges::sort(info.mFiles);
+    if (previous != mDirectories.end()) {
+      for (const auto& path: previous->second.mFiles) {
+        if (!std::ranges::binary_search(info.mFiles, path)) {
+          removed.insert(mFiles.extract(path));
+        }
+      }
+    }
+    directories[directory] = std::move(info);
+  }
+
+  // Directories that no longer exist
+  for (const auto& [directory, info]: mDirectories) {
+    if (directories.contains(directory)) {
+      continue;
+    }
+    for (const auto& path: info.mFiles) {
+      if (auto it = mFiles.find(path); it != mFiles.end()) {
+        removed.insert(mFiles.extract(it));
+      }
+    }
+  }
+  mDirectories = std::move(directories);
+
+  // Writing to a file doesn't change its directory's last write time, so
+  // these might not have been listed again above
+  for (const auto& path: recheck) {
+    const auto it = mFiles.find(path);
+    WIN32_FILE_ATTRIBUTE_DATA data {};
+    if (
+      it == mFiles.end()
+      || !GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+      continue;
+    }
+    const auto size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32)
+      | data.nFileSizeLow;
+    const auto lastWriteTime = ToFileTime(data.ftLastWriteTime);
+    if (
+      size == it->second.mSize && lastWriteTime == it->second.mLastWriteTime) {
+      continue;
+    }
+    it->second.mSize = size;
+    it->second.mLastWriteTime = lastWriteTime;
+    diff.mModified.push_back(path);
+  }
+
+  if (diff.mAdded.empty() || removed.empty()) {
+    for (const auto& [path, info]: removed) {
+      diff.mRemoved.push_back(path);
+    }
+    return diff;
+  }
+
+  std::unordered_map<uint64_t, std::filesystem::path> addedByID;
+  for (const auto& path: diff.mAdded) {
+    if (const auto id = mFiles.at(path).mFileID) {
+      addedByID.emplace(id, path);
+    }
+  }
+
+  std::vector<std::filesystem::path> renamedTo;
+  for (const auto& [path, info]: removed) {
+    const auto it
+      = info.mFileID ? addedByID.find(info.mFileID) : addedByID.end();
+    if (it == addedByID.end()) {
+      diff.mRemoved.push_back(path);
+      continue;
+    }
+    diff.mRenamed.push_back({path, it->second});
+    renamedTo.push_back(it->second);
+    addedByID.erase(it);
+  }
+
+  if (!renamedTo.empty()) {
+    std::erase_if(diff.mAdded, [&renamedTo](const auto& path) {
+      return std::ranges::find(renamedTo, path) != renamedTo.end();
+    });
+  }
+
+  return diff;
+}
+
+}// namespace OpenKneeboard
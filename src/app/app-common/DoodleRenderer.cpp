@@ -25,42 +25,135 @@
 #include <OpenKneeboard/config.h>
 #include <OpenKneeboard/dprint.h>
 
+#include <algorithm>
+#include <cmath>
 #include <mutex>
 
 namespace OpenKneeboard {
 
+namespace {
+
+uint16_t QuantizePosition(float value) {
+  return static_cast<uint16_t>(
+    std::lround(std::clamp(value, 0.0f, 1.0f) * 65535));
+}
+
+uint8_t QuantizePressure(float value) {
+  return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255));
+}
+
+uint32_t ToARGB(const D2D1_COLOR_F& color) {
+  const auto channel = [](float value) {
+    return static_cast<uint32_t>(
+      std::lround(std::clamp(value, 0.0f, 1.0f) * 255));
+  };
+  return (channel(color.a) << 24) | (channel(color.r) << 16)
+    | (channel(color.g) << 8) | channel(color.b);
+}
+
+void DrawSegment(
+  DoodleTileSurface* surface,
+  const DoodleStroke& stroke,
+  const DoodleStroke::Point* previous,
+  const DoodleStroke::Point& point) {
+  const auto size = surface->GetSize();
+  const auto toVertex = [&](const DoodleStroke::Point& p) {
+    return DoodleTileSurface::Vertex {
+      (p.mX * size.Width<float>()) / 65535,
+      (p.mY * size.Height<float>()) / 65535,
+      stroke.GetRadius(p) * size.Height<float>(),
+    };
+  };
+  const auto to = toVertex(point);
+  const auto from = previous ? toVertex(*previous) : to;
+
+  if (stroke.mTool == DoodleStroke::Tool::Eraser) {
+    surface->EraseSegment(from, to);
+  } else {
+    surface->DrawSegment(from, to, stroke.mColor);
+  }
+}
+
+void DrawStroke(DoodleTileSurface* surface, const DoodleStroke& stroke) {
+  const DoodleStroke::Point* previous = nullptr;
+  for (const auto& point: stroke.mPoints) {
+    DrawSegment(surface, stroke, previous, point);
+    previous = &point;
+  }
+}
+
+}// namespace
+
+bool DoodleRenderer::Drawing::HaveStrokes() const {
+  return mCurrentStroke || !mStrokes.empty();
+}
+
+void DoodleRenderer::Drawing::DropCache() {
+  mTiles = nullptr;
+  mTexture = nullptr;
+  mBitmap = nullptr;
+}
+
 DoodleRenderer::DoodleRenderer(
   const audited_ptr<DXResources>& dxr,
   KneeboardState* kbs)
   : mDXR(dxr), mKneeboard(kbs) {
   mBrush = dxr->mBlackBrush;
-  mEraser = dxr->mEraserBrush;
   mDrawingContext = mDXR->mD2DBackBufferDeviceContext;
 }
 
 DoodleRenderer::~DoodleRenderer() = default;
 
+void DoodleRenderer::SetPersistentStore(
+  const std::shared_ptr<DoodleStore>& store,
+  PageIndexLookup lookup) {
+  std::scoped_lock lock(mBufferedEventsMutex);
+  mStore = store;
+  mPageIndexLookup = std::move(lookup);
+  for (auto& [pageID, page]: mDrawings) {
+    page.mLoaded = false;
+  }
+}
+
 void DoodleRenderer::Clear() {
+  std::scoped_lock lock(mBufferedEventsMutex);
   mDrawings.clear();
+  mCachedPages.clear();
+  if (mStore) {
+    mStore->Clear();
+  }
 }
 
 void DoodleRenderer::ClearPage(PageID pageID) {
+  std::scoped_lock lock(mBufferedEventsMutex);
   mDrawings.erase(pageID);
+  mCachedPages.remove(pageID);
+  if (!mStore) {
+    return;
+  }
+  if (const auto index = mPageIndexLookup(pageID)) {
+    mStore->ClearPage(*index);
+  }
 }
 
 void DoodleRenderer::ClearExcept(const std::unordered_set<PageID>& keep) {
+  std::scoped_lock lock(mBufferedEventsMutex);
   for (auto it = mDrawings.begin(); it != mDrawings.end(); /* no increment */) {
     if (keep.contains(it->first)) {
       it++;
     } else {
+      mCachedPages.remove(it->first);
       it = mDrawings.erase(it);
     }
   }
 }
 
 bool DoodleRenderer::HaveDoodles() const {
+  if (mStore && mStore->HaveStrokes()) {
+    return true;
+  }
   for (const auto& [id, drawing]: mDrawings) {
-    if (drawing.mBitmap) {
+    if (drawing.HaveStrokes()) {
       return true;
     }
   }
@@ -72,10 +165,19 @@ bool DoodleRenderer::HaveDoodles(PageID pageID) const {
     return false;
   }
   auto it = mDrawings.find(pageID);
-  if (it == mDrawings.end()) {
+  if (it != mDrawings.end()) {
+    if (it->second.HaveStrokes()) {
+      return true;
+    }
+    if (it->second.mLoaded) {
+      return false;
+    }
+  }
+  if (!mStore) {
     return false;
   }
-  return static_cast<bool>(it->second.mBitmap);
+  const auto index = mPageIndexLookup(pageID);
+  return index && mStore->HaveStrokes(*index);
 }
 
 void DoodleRenderer::PostCursorEvent(
@@ -99,81 +201,185 @@ void DoodleRenderer::PostCursorEvent(
   }
 }
 
-void DoodleRenderer::FlushCursorEvents() {
-  auto ctx = mDrawingContext;
+bool DoodleRenderer::LoadStrokes(PageID pageID, Drawing* page) {
+  if (page->mLoaded) {
+    return false;
+  }
+  page->mLoaded = true;
+  if (!mStore) {
+    return false;
+  }
+  const auto index = mPageIndexLookup(pageID);
+  if (!index) {
+    return false;
+  }
+
+  auto strokes = mStore->GetStrokes(*index);
+  if (strokes.empty()) {
+    return false;
+  }
+  const auto wasEmpty = !page->HaveStrokes();
+  // Anything we already have is newer
+  strokes.insert(
+    strokes.end(),
+    std::make_move_iterator(page->mStrokes.begin()),
+    std::make_move_iterator(page->mStrokes.end()));
+  page->mStrokes = std::move(strokes);
+  page->DropCache();
+  return wasEmpty;
+}
+
+void DoodleRenderer::FinishStroke(PageID pageID, Drawing* page) {
+  if (!page->mCurrentStroke) {
+    return;
+  }
+  auto stroke = std::move(*page->mCurrentStroke);
+  page->mCurrentStroke.reset();
+
+  SimplifyDoodleStroke(&stroke);
+  if (mStore) {
+    if (const auto index = mPageIndexLookup(pageID)) {
+      mStore->Append(*index, stroke);
+    }
+  }
+  page->mStrokes.push_back(std::move(stroke));
+}
+
+bool DoodleRenderer::FlushCursorEvents() {
   std::scoped_lock lock(mBufferedEventsMutex);
 
+  bool addedPage = false;
+  const auto settings = mKneeboard->GetDoodlesSettings();
   for (auto& [pageID, page]: mDrawings) {
     if (page.mBufferedEvents.empty()) {
       continue;
     }
+    // Make sure new strokes are persisted after existing ones
+    addedPage = this->LoadStrokes(pageID, &page) || addedPage;
+
+    const auto nativeSize = page.mNativeSize;
+    const auto canonicalHeight
+      = nativeSize.ScaledToFit(MaxViewRenderSize).Height<float>();
 
-    bool drawing = false;
     for (const auto& event: page.mBufferedEvents) {
       if (event.mTouchState != CursorTouchState::TOUCHING_SURFACE) {
-        page.mHaveCursor = false;
+        this->FinishStroke(pageID, &page);
         continue;
       }
 
-      if (!drawing) {
-        drawing = true;
-        ctx->BeginDraw();
-        ctx->SetTarget(GetDrawingSurface(pageID));
-      }
-
       // ignore tip button - any other pen button == erase
       const bool erasing = event.mButtons & ~1;
+      const auto toolType
+        = erasing ? DoodleStroke::Tool::Eraser : DoodleStroke::Tool::Pen;
+      if (page.mCurrentStroke && page.mCurrentStroke->mTool != toolType) {
+        this->FinishStroke(pageID, &page);
+      }
 
-      const auto scale = page.mScale;
-
-      const auto pressure = std::clamp(event.mPressure - 0.40f, 0.0f, 0.60f);
-
-      auto ds = mKneeboard->GetDoodlesSettings();
-      const auto tool = erasing ? ds.mEraser : ds.mPen;
-      auto radius = tool.mMinimumRadius + (tool.mSensitivity * pressure);
-
-      const auto x = event.mX * scale;
-      const auto y = event.mY * scale;
-      const auto brush = erasing ? mEraser : mBrush;
-
-      ctx->SetPrimitiveBlend(
-        erasing ? D2D1_PRIMITIVE_BLEND_COPY : D2D1_PRIMITIVE_BLEND_SOURCE_OVER);
+      if (!page.mCurrentStroke) {
+        addedPage = addedPage || !page.HaveStrokes();
+        const auto& tool = erasing ? settings.mEraser : settings.mPen;
+        // Tool settings are in pixels at `MaxViewRenderSize`
+        page.mCurrentStroke = DoodleStroke {
+          .mTool = toolType,
+          .mColor = erasing ? 0 : ToARGB(mBrush->GetColor()),
+          .mMinimumRadius = tool.mMinimumRadius / canonicalHeight,
+          .mSensitivity = tool.mSensitivity / canonicalHeight,
+        };
+      }
 
-      if (page.mHaveCursor) {
-        ctx->DrawLine(page.mCursorPoint, {x, y}, brush.get(), radius * 2);
+      auto& stroke = *page.mCurrentStroke;
+      const DoodleStroke::Point point {
+        .mX = QuantizePosition(event.mX / nativeSize.Width<float>()),
+        .mY = QuantizePosition(event.mY / nativeSize.Height<float>()),
+        .mPressure = QuantizePressure(event.mPressure),
+      };
+
+      if (page.mTiles) {
+        DrawSegment(
+          page.mTiles.get(),
+          stroke,
+          stroke.mPoints.empty() ? nullptr : &stroke.mPoints.back(),
+          point);
       }
-      ctx->FillEllipse(D2D1::Ellipse({x, y}, radius, radius), brush.get());
-      page.mHaveCursor = true;
-      page.mCursorPoint = {x, y};
-    }
-    if (drawing) {
-      winrt::check_hresult(ctx->EndDraw());
+      stroke.mPoints.push_back(point);
     }
     page.mBufferedEvents.clear();
+    this->UploadDirtyTiles(&page);
   }
+  return addedPage;
 }
 
-ID2D1Bitmap* DoodleRenderer::GetDrawingSurface(PageID pageID) {
-  auto it = mDrawings.find(pageID);
-  if (it == mDrawings.end()) {
-    // Should have been initialized by cursor events
-    OPENKNEEBOARD_BREAK;
-    return nullptr;
+void DoodleRenderer::UploadDirtyTiles(Drawing* page) {
+  if (!page->mTiles) {
+    return;
+  }
+  const auto dirty = page->mTiles->TakeDirtyTiles();
+  if (dirty.empty()) {
+    return;
   }
 
-  auto& page = it->second;
-  if (page.mBitmap) {
-    return page.mBitmap.get();
+  // Tiles that have been cleared
+  static const std::vector<uint32_t> sTransparent(
+    DoodleTileSurface::TileSize * DoodleTileSurface::TileSize, 0);
+
+  const std::unique_lock lock(*mDXR);
+  auto ctx = mDXR->mD3D11ImmediateContext.get();
+  for (const auto& tile: dirty) {
+    const auto rect = page->mTiles->GetTileRect(tile);
+    const D3D11_BOX box {
+      .left = rect.Left(),
+      .top = rect.Top(),
+      .front = 0,
+      .right = rect.Right(),
+      .bottom = rect.Bottom(),
+      .back = 1,
+    };
+    const auto pixels = page->mTiles->GetTilePixels(tile);
+    ctx->UpdateSubresource(
+      page->mTexture.get(),
+      0,
+      &box,
+      pixels ? pixels : sTransparent.data(),
+      DoodleTileSurface::TileSize * sizeof(uint32_t),
+      0);
   }
+}
 
-  const auto& contentPixels = page.mNativeSize;
+void DoodleRenderer::MarkCachedPageUsed(PageID pageID) {
+  if (mCachedPages.empty() || mCachedPages.front() != pageID) {
+    mCachedPages.remove(pageID);
+    mCachedPages.push_front(pageID);
+  }
+
+  while (mCachedPages.size() > MaxCachedPages) {
+    const auto evicted = mCachedPages.back();
+    mCachedPages.pop_back();
+    auto it = mDrawings.find(evicted);
+    if (it != mDrawings.end()) {
+      it->second.DropCache();
+    }
+  }
+}
+
+ID2D1Bitmap* DoodleRenderer::GetCachedBitmap(
+  PageID pageID,
+  Drawing* page,
+  const PixelSize& fallbackSize) {
+  if (page->mBitmap) {
+    this->MarkCachedPageUsed(pageID);
+    return page->mBitmap.get();
+  }
+
+  // Strokes are resolution-independent, so if we've not had any input for
+  // this page yet, the destination size is good enough
+  const auto& contentPixels
+    = page->mNativeSize ? page->mNativeSize : fallbackSize;
   if (!contentPixels) {
     OPENKNEEBOARD_BREAK;
     return nullptr;
   }
 
   const auto surfaceSize = contentPixels.ScaledToFit(MaxViewRenderSize);
-  page.mScale = surfaceSize.Height<float>() / contentPixels.Height();
 
   D3D11_TEXTURE2D_DESC textureDesc {
     .Width = surfaceSize.mWidth,
@@ -186,33 +392,61 @@ ID2D1Bitmap* DoodleRenderer::GetDrawingSurface(PageID pageID) {
     .BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET,
   };
 
-  const std::unique_lock lock(*mDXR);
-  winrt::com_ptr<ID3D11Texture2D> texture;
-  winrt::check_hresult(
-    mDXR->mD3D11Device->CreateTexture2D(&textureDesc, nullptr, texture.put()));
-  page.mSurface = texture.as<IDXGISurface>();
-
-  mDXR->mD2DDeviceContext->CreateBitmapFromDxgiSurface(
-    page.mSurface.get(), nullptr, page.mBitmap.put());
+  page->mTiles = std::make_unique<DoodleTileSurface>(surfaceSize);
+  for (const auto& stroke: page->mStrokes) {
+    DrawStroke(page->mTiles.get(), stroke);
+  }
+  if (page->mCurrentStroke) {
+    DrawStroke(page->mTiles.get(), *page->mCurrentStroke);
+  }
 
-  evAddedPageEvent.Emit();
+  {
+    const std::unique_lock lock(*mDXR);
+    winrt::check_hresult(mDXR->mD3D11Device->CreateTexture2D(
+      &textureDesc, nullptr, page->mTexture.put()));
+    winrt::check_hresult(mDXR->mD2DDeviceContext->CreateBitmapFromDxgiSurface(
+      page->mTexture.as<IDXGISurface>().get(), nullptr, page->mBitmap.put()));
+
+    // Tiles that haven't been drawn on aren't uploaded
+    auto ctx = mDrawingContext;
+    ctx->BeginDraw();
+    ctx->SetTarget(page->mBitmap.get());
+    ctx->Clear(D2D1::ColorF(0.0f, 0.0f, 0.0f, 0.0f));
+    winrt::check_hresult(ctx->EndDraw());
+  }
+  this->UploadDirtyTiles(page);
 
-  return page.mBitmap.get();
+  this->MarkCachedPageUsed(pageID);
+  return page->mBitmap.get();
 }
 
 void DoodleRenderer::Render(
   ID2D1DeviceContext* ctx,
   PageID pageID,
   const PixelRect& rect) {
-  FlushCursorEvents();
+  bool addedPage = FlushCursorEvents();
 
-  auto it = mDrawings.find(pageID);
-  if (it == mDrawings.end()) {
-    return;
+  winrt::com_ptr<ID2D1Bitmap> bitmap;
+  {
+    std::scoped_lock lock(mBufferedEventsMutex);
+    auto it = mDrawings.find(pageID);
+    if (it == mDrawings.end() && mStore) {
+      it = mDrawings.try_emplace(pageID).first;
+    }
+    if (it != mDrawings.end()) {
+      auto& page = it->second;
+      addedPage = this->LoadStrokes(pageID, &page) || addedPage;
+      // Skip compositing if nothing has been drawn, e.g. only erasing
+      if (page.HaveStrokes() && !(page.mTiles && page.mTiles->IsEmpty())) {
+        bitmap.copy_from(this->GetCachedBitmap(pageID, &page, rect.mSize));
+      }
+    }
+  }
+
+  if (addedPage) {
+    evAddedPageEvent.Emit();
   }
-  auto& page = it->second;
 
-  auto bitmap = page.mBitmap;
   if (!bitmap) {
     return;
   }
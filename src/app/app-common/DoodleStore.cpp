@@ -0,0 +1,449 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/DoodleStore.h>
+
+#include <OpenKneeboard/Filesystem.h>
+#include <OpenKneeboard/dprint.h>
+#include <OpenKneeboard/utf8.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cwctype>
+#include <format>
+#include <iterator>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+namespace OpenKneeboard {
+
+namespace {
+
+constexpr std::string_view Magic {"OKDOODLE"};
+constexpr uint32_t FormatVersion = 2;
+
+enum class RecordType : uint8_t {
+  Stroke = 1,
+  ClearPage = 2,
+  Clear = 3,
+};
+
+template <class T>
+  requires std::is_trivially_copyable_v<T>
+void Put(std::string* out, const T& value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class Reader final {
+ public:
+  Reader(std::string_view data) : mData(data) {
+  }
+
+  template <class T>
+    requires std::is_trivially_copyable_v<T>
+  bool Get(T* value) {
+    if (mData.size() < sizeof(T)) {
+      return false;
+    }
+    memcpy(value, mData.data(), sizeof(T));
+    mData.remove_prefix(sizeof(T));
+    return true;
+  }
+
+  bool Get(std::string* value, size_t size) {
+    if (mData.size() < size) {
+      return false;
+    }
+    *value = mData.substr(0, size);
+    mData.remove_prefix(size);
+    return true;
+  }
+
+  bool IsEmpty() const noexcept {
+    return mData.empty();
+  }
+
+  size_t Remaining() const noexcept {
+    return mData.size();
+  }
+
+ private:
+  std::string_view mData;
+};
+
+std::string GetHeader(
+  const std::filesystem::path& document,
+  const DoodleStore::DocumentVersion& version) {
+  const auto path = to_utf8(document);
+  std::string ret {Magic};
+  Put(&ret, FormatVersion);
+  Put(&ret, static_cast<uint32_t>(path.size()));
+  ret += path;
+  Put(&ret, version.mSize);
+  Put(&ret, version.mModified);
+  return ret;
+}
+
+DoodleStore::DocumentVersion GetDocumentVersion(
+  const std::filesystem::path& document) {
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(document, ec);
+  if (ec) {
+    return {};
+  }
+  const auto modified = std::filesystem::last_write_time(document, ec);
+  if (ec) {
+    return {};
+  }
+  return {
+    .mSize = size,
+    .mModified = modified.time_since_epoch().count(),
+  };
+}
+
+std::string GetStrokeRecord(PageIndex page, const DoodleStroke& stroke) {
+  std::string ret;
+  ret.reserve(22 + (stroke.mPoints.size() * 5));
+  Put(&ret, RecordType::Stroke);
+  Put(&ret, page);
+  Put(&ret, stroke.mTool);
+  Put(&ret, stroke.mColor);
+  Put(&ret, stroke.mMinimumRadius);
+  Put(&ret, stroke.mSensitivity);
+  Put(&ret, static_cast<uint32_t>(stroke.mPoints.size()));
+  // Field-by-field to avoid padding
+  for (const auto& point: stroke.mPoints) {
+    Put(&ret, point.mX);
+    Put(&ret, point.mY);
+    Put(&ret, point.mPressure);
+  }
+  return ret;
+}
+
+bool ReadStroke(Reader* reader, DoodleStroke* stroke) {
+  uint32_t pointCount {};
+  if (!(reader->Get(&stroke->mTool) && reader->Get(&stroke->mColor)
+        && reader->Get(&stroke->mMinimumRadius)
+        && reader->Get(&stroke->mSensitivity) && reader->Get(&pointCount))) {
+    return false;
+  }
+  // Don't trust the count from a truncated or corrupt file with an allocation
+  using Point = DoodleStroke::Point;
+  constexpr auto bytesPerPoint = sizeof(Point::mX) + sizeof(Point::mY)
+    + sizeof(Point::mPressure);
+  if (static_cast<uint64_t>(pointCount) * bytesPerPoint > reader->Remaining()) {
+    return false;
+  }
+  stroke->mPoints.resize(pointCount);
+  for (auto& point: stroke->mPoints) {
+    if (!(reader->Get(&point.mX) && reader->Get(&point.mY)
+          && reader->Get(&point.mPressure))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::filesystem::path GetStorePath(const std::filesystem::path& document) {
+  // FNV-1a of the case-folded path; std::hash isn't guaranteed to be stable
+  // between builds
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const auto c: document.wstring()) {
+    hash ^= static_cast<uint64_t>(std::towlower(c));
+    hash *= 0x100000001b3;
+  }
+  return Filesystem::GetLocalAppDataDirectory() / "Doodles"
+    / std::format("{:016x}.okdoodles", hash);
+}
+
+}// namespace
+
+float DoodleStroke::GetRadius(const Point& point) const {
+  const auto pressure
+    = std::clamp((point.mPressure / 255.0f) - 0.40f, 0.0f, 0.60f);
+  return mMinimumRadius + (mSensitivity * pressure);
+}
+
+void SimplifyDoodleStroke(DoodleStroke* stroke, uint16_t tolerance) {
+  auto& points = stroke->mPoints;
+  if (points.size() < 3) {
+    return;
+  }
+
+  // In the same units as the coordinates
+  const auto radius
+    = [stroke](const auto& point) { return stroke->GetRadius(point) * 65535; };
+
+  std::vector<bool> keep(points.size(), false);
+  keep.front() = true;
+  keep.back() = true;
+
+  std::vector<std::tuple<size_t, size_t>> pending {{0, points.size() - 1}};
+  while (!pending.empty()) {
+    const auto [first, last] = pending.back();
+    pending.pop_back();
+    if (last - first < 2) {
+      continue;
+    }
+
+    const auto& a = points.at(first);
+    const auto& b = points.at(last);
+    const float dx = b.mX - a.mX;
+    const float dy = b.mY - a.mY;
+    const auto lengthSquared = (dx * dx) + (dy * dy);
+    const auto ra = radius(a);
+    const auto rb = radius(b);
+
+    float maxDistance = -1;
+    size_t furthest = first;
+    for (size_t i = first + 1; i < last; ++i) {
+      const auto& p = points.at(i);
+      const auto t = (lengthSquared > 0)
+        ? std::clamp(
+          (((p.mX - a.mX) * dx) + ((p.mY - a.mY) * dy)) / lengthSquared,
+          0.0f,
+          1.0f)
+        : 0.0f;
+      const auto ex = a.mX + (t * dx) - p.mX;
+      const auto ey = a.mY + (t * dy) - p.mY;
+      const auto distance = std::max(
+        std::sqrt((ex * ex) + (ey * ey)),
+        std::abs(radius(p) - (ra + (t * (rb - ra)))));
+      if (distance > maxDistance) {
+        maxDistance = distance;
+        furthest = i;
+      }
+    }
+
+    if (maxDistance <= tolerance) {
+      continue;
+    }
+    keep.at(furthest) = true;
+    pending.push_back({first, furthest});
+    pending.push_back({furthest, last});
+  }
+
+  std::vector<DoodleStroke::Point> simplified;
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (keep.at(i)) {
+      simplified.push_back(points.at(i));
+    }
+  }
+  points = std::move(simplified);
+}
+
+std::shared_ptr<DoodleStore> DoodleStore::Get(
+  const std::filesystem::path& rawDocument) {
+  std::error_code ec;
+  auto document = std::filesystem::weakly_canonical(rawDocument, ec);
+  if (ec) {
+    document = std::filesystem::absolute(rawDocument);
+  }
+  const auto storePath = GetStorePath(document);
+  const auto version = GetDocumentVersion(document);
+
+  static std::mutex sMutex;
+  static std::map<std::filesystem::path, std::weak_ptr<DoodleStore>> sStores;
+  std::unique_lock lock(sMutex);
+
+  auto& weak = sStores[storePath];
+  if (auto shared = weak.lock()) {
+    if (shared->mDocumentVersion == version) {
+      return shared;
+    }
+    // The document has changed, so the strokes are probably in the wrong
+    // place; stop the old instance writing to the file we're replacing
+    shared->Close();
+  }
+  std::shared_ptr<DoodleStore> shared {
+    new DoodleStore(document, version, storePath)};
+  weak = shared;
+  return shared;
+}
+
+DoodleStore::DoodleStore(
+  const std::filesystem::path& document,
+  const DocumentVersion& version,
+  const std::filesystem::path& storePath)
+  : mDocument(document), mDocumentVersion(version), mStorePath(storePath) {
+  try {
+    this->Load();
+  } catch (const std::filesystem::filesystem_error& e) {
+    dprintf("Failed to load doodles from '{}': {}", mStorePath, e.what());
+  }
+}
+
+DoodleStore::~DoodleStore() = default;
+
+void DoodleStore::Load() {
+  std::string data;
+  if (std::filesystem::exists(mStorePath)) {
+    std::ifstream f(mStorePath, std::ios::binary);
+    data = {
+      std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+  }
+
+  Reader reader {data};
+  std::string magic;
+  uint32_t version {};
+  uint32_t pathSize {};
+  std::string path;
+  DocumentVersion documentVersion {};
+  if (!(reader.Get(&magic, Magic.size()) && magic == Magic
+        && reader.Get(&version) && version == FormatVersion
+        && reader.Get(&pathSize) && reader.Get(&path, pathSize)
+        && path == to_utf8(mDocument) && reader.Get(&documentVersion.mSize)
+        && reader.Get(&documentVersion.mModified)
+        && documentVersion == mDocumentVersion)) {
+    // New, corrupt, a hash collision, or the document has changed since the
+    // strokes were drawn
+    this->Rewrite();
+    return;
+  }
+
+  bool needsRewrite = false;
+  while (!reader.IsEmpty()) {
+    RecordType type {};
+    PageIndex page {};
+    if (!(reader.Get(&type) && reader.Get(&page))) {
+      needsRewrite = true;
+      break;
+    }
+
+    if (type == RecordType::Stroke) {
+      DoodleStroke stroke;
+      if (!ReadStroke(&reader, &stroke)) {
+        // Probably a partial write
+        needsRewrite = true;
+        break;
+      }
+      mPages[page].push_back(std::move(stroke));
+      continue;
+    }
+
+    needsRewrite = true;
+    if (type == RecordType::ClearPage) {
+      mPages.erase(page);
+      continue;
+    }
+    if (type == RecordType::Clear) {
+      mPages.clear();
+      continue;
+    }
+    dprintf("Unrecognized doodle record type in '{}'", mStorePath);
+    break;
+  }
+
+  if (needsRewrite) {
+    this->Rewrite();
+    return;
+  }
+
+  mFile.open(mStorePath, std::ios::binary | std::ios::app);
+}
+
+void DoodleStore::Rewrite() {
+  mFile.close();
+
+  std::filesystem::create_directories(mStorePath.parent_path());
+  auto data = GetHeader(mDocument, mDocumentVersion);
+  for (const auto& [page, strokes]: mPages) {
+    for (const auto& stroke: strokes) {
+      data += GetStrokeRecord(page, stroke);
+    }
+  }
+
+  auto temporary = mStorePath;
+  temporary += ".tmp";
+  {
+    std::ofstream f(temporary, std::ios::binary | std::ios::trunc);
+    f.write(data.data(), data.size());
+  }
+  std::filesystem::rename(temporary, mStorePath);
+
+  mFile.open(mStorePath, std::ios::binary | std::ios::app);
+}
+
+void DoodleStore::Close() {
+  std::unique_lock lock(mMutex);
+  mFile.close();
+}
+
+void DoodleStore::Write(const std::string& record) {
+  if (!(mFile.is_open() && mFile)) {
+    return;
+  }
+  mFile.write(record.data(), record.size());
+  mFile.flush();
+}
+
+bool DoodleStore::HaveStrokes() const {
+  std::unique_lock lock(mMutex);
+  return !mPages.empty();
+}
+
+bool DoodleStore::HaveStrokes(PageIndex page) const {
+  std::unique_lock lock(mMutex);
+  return mPages.contains(page);
+}
+
+std::vector<DoodleStroke> DoodleStore::GetStrokes(PageIndex page) const {
+  std::unique_lock lock(mMutex);
+  const auto it = mPages.find(page);
+  if (it == mPages.end()) {
+    return {};
+  }
+  return it->second;
+}
+
+void DoodleStore::Append(PageIndex page, const DoodleStroke& stroke) {
+  if (stroke.mPoints.empty()) {
+    return;
+  }
+  std::unique_lock lock(mMutex);
+  mPages[page].push_back(stroke);
+  this->Write(GetStrokeRecord(page, stroke));
+}
+
+void DoodleStore::ClearPage(PageIndex page) {
+  std::unique_lock lock(mMutex);
+  if (!mPages.erase(page)) {
+    return;
+  }
+  std::string record;
+  Put(&record, RecordType::ClearPage);
+  Put(&record, page);
+  this->Write(record);
+}
+
+void DoodleStore::Clear() {
+  std::unique_lock lock(mMutex);
+  if (mPages.empty()) {
+    return;
+  }
+  mPages.clear();
+  std::string record;
+  Put(&record, RecordType::Clear);
+  Put(&record, PageIndex {});
+  this->Write(record);
+}
+
+}// namespace OpenKneeboard
@@ -0,0 +1,210 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/DoodleTileSurface.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace OpenKneeboard {
+
+namespace {
+
+constexpr uint32_t Channel(uint32_t pixel, uint32_t shift) {
+  return (pixel >> shift) & 0xff;
+}
+
+/// `pixel * (factor / 255)`, for each channel
+constexpr uint32_t Scale(uint32_t pixel, uint32_t factor) {
+  uint32_t ret = 0;
+  for (const uint32_t shift: {0, 8, 16, 24}) {
+    ret |= (((Channel(pixel, shift) * factor) + 127) / 255) << shift;
+  }
+  return ret;
+}
+
+/// Porter-Duff 'over', for premultiplied pixels
+constexpr uint32_t Over(uint32_t source, uint32_t dest) {
+  const auto inverseAlpha = 255 - Channel(source, 24);
+  uint32_t ret = 0;
+  for (const uint32_t shift: {0, 8, 16, 24}) {
+    const auto value = Channel(source, shift)
+      + (((Channel(dest, shift) * inverseAlpha) + 127) / 255);
+    ret |= std::min<uint32_t>(value, 255) << shift;
+  }
+  return ret;
+}
+
+constexpr uint32_t Premultiply(uint32_t argb) {
+  const auto alpha = Channel(argb, 24);
+  return (Scale(argb, alpha) & 0x00ffffff) | (alpha << 24);
+}
+
+}// namespace
+
+DoodleTileSurface::DoodleTileSurface(const PixelSize& size)
+  : mSize(size),
+    mColumns((size.mWidth + TileSize - 1) / TileSize),
+    mRows((size.mHeight + TileSize - 1) / TileSize) {
+  mTiles.resize(mColumns * mRows);
+  mDirty.resize(mTiles.size(), false);
+}
+
+DoodleTileSurface::~DoodleTileSurface() = default;
+
+PixelSize DoodleTileSurface::GetSize() const {
+  return mSize;
+}
+
+bool DoodleTileSurface::IsEmpty() const {
+  return std::ranges::none_of(
+    mTiles, [](const auto& tile) { return static_cast<bool>(tile); });
+}
+
+void DoodleTileSurface::DrawSegment(
+  const Vertex& from,
+  const Vertex& to,
+  uint32_t argb) {
+  this->Rasterize<false>(from, to, Premultiply(argb));
+}
+
+void DoodleTileSurface::EraseSegment(const Vertex& from, const Vertex& to) {
+  this->Rasterize<true>(from, to, 0);
+}
+
+void DoodleTileSurface::Clear() {
+  for (uint32_t i = 0; i < mTiles.size(); ++i) {
+    if (mTiles.at(i)) {
+      mTiles.at(i) = nullptr;
+      this->MarkDirty(i);
+    }
+  }
+}
+
+void DoodleTileSurface::MarkDirty(uint32_t index) {
+  if (mDirty.at(index)) {
+    return;
+  }
+  mDirty.at(index) = true;
+  mDirtyTiles.push_back({index % mColumns, index / mColumns});
+}
+
+std::vector<DoodleTileSurface::TileCoord> DoodleTileSurface::TakeDirtyTiles() {
+  for (const auto& tile: mDirtyTiles) {
+    mDirty.at((tile.mY * mColumns) + tile.mX) = false;
+  }
+  return std::exchange(mDirtyTiles, {});
+}
+
+const uint32_t* DoodleTileSurface::GetTilePixels(const TileCoord& tile) const {
+  return mTiles.at((tile.mY * mColumns) + tile.mX).get();
+}
+
+PixelRect DoodleTileSurface::GetTileRect(const TileCoord& tile) const {
+  const auto x = tile.mX * TileSize;
+  const auto y = tile.mY * TileSize;
+  return {
+    {x, y},
+    {
+      std::min(TileSize, mSize.mWidth - x),
+      std::min(TileSize, mSize.mHeight - y),
+    },
+  };
+}
+
+template <bool Erase>
+void DoodleTileSurface::Rasterize(
+  const Vertex& a,
+  const Vertex& b,
+  uint32_t premultiplied) {
+  // Bounding box, with a pixel of margin for anti-aliasing
+  const auto margin = std::max(a.mRadius, b.mRadius) + 1;
+  const auto left = std::max(0.0f, std::floor(std::min(a.mX, b.mX) - margin));
+  const auto top = std::max(0.0f, std::floor(std::min(a.mY, b.mY) - margin));
+  const auto right = std::min(
+    mSize.Width<float>(), std::ceil(std::max(a.mX, b.mX) + margin));
+  const auto bottom = std::min(
+    mSize.Height<float>(), std::ceil(std::max(a.mY, b.mY) + margin));
+  if (left >= right || top >= bottom) {
+    return;
+  }
+  const auto x0 = static_cast<uint32_t>(left);
+  const auto y0 = static_cast<uint32_t>(top);
+  const auto x1 = static_cast<uint32_t>(right);
+  const auto y1 = static_cast<uint32_t>(bottom);
+
+  const auto dx = b.mX - a.mX;
+  const auto dy = b.mY - a.mY;
+  const auto lengthSquared = (dx * dx) + (dy * dy);
+
+  for (auto ty = y0 / TileSize; ty <= (y1 - 1) / TileSize; ++ty) {
+    for (auto tx = x0 / TileSize; tx <= (x1 - 1) / TileSize; ++tx) {
+      const auto index = (ty * mColumns) + tx;
+      auto& tile = mTiles.at(index);
+      if (!tile) {
+        if constexpr (Erase) {
+          continue;
+        }
+        // Value-initialized, so transparent
+        tile = std::make_unique<uint32_t[]>(TileSize * TileSize);
+      }
+
+      bool touched = false;
+      const auto tileLeft = tx * TileSize;
+      const auto tileTop = ty * TileSize;
+      const auto yEnd = std::min(y1, tileTop + TileSize);
+      const auto xEnd = std::min(x1, tileLeft + TileSize);
+      for (auto y = std::max(y0, tileTop); y < yEnd; ++y) {
+        auto row = &tile[(y - tileTop) * TileSize];
+        for (auto x = std::max(x0, tileLeft); x < xEnd; ++x) {
+          // Distance from the pixel center to the segment
+          const auto px = (x + 0.5f) - a.mX;
+          const auto py = (y + 0.5f) - a.mY;
+          const auto t = (lengthSquared > 0)
+            ? std::clamp(((px * dx) + (py * dy)) / lengthSquared, 0.0f, 1.0f)
+            : 0.0f;
+          const auto ex = px - (t * dx);
+          const auto ey = py - (t * dy);
+          const auto radius = a.mRadius + (t * (b.mRadius - a.mRadius));
+          const auto coverage = std::clamp(
+            radius + 0.5f - std::sqrt((ex * ex) + (ey * ey)), 0.0f, 1.0f);
+          if (coverage <= 0) {
+            continue;
+          }
+
+          touched = true;
+          const auto weight
+            = static_cast<uint32_t>(std::lround(coverage * 255));
+          auto& pixel = row[x - tileLeft];
+          if constexpr (Erase) {
+            pixel = Scale(pixel, 255 - weight);
+          } else {
+            pixel = Over(Scale(premultiplied, weight), pixel);
+          }
+        }
+      }
+      if (touched) {
+        this->MarkDirty(index);
+      }
+    }
+  }
+}
+
+}// namespace OpenKneeboard
@@ -0,0 +1,408 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/FilesystemWatchMultiplexer.h>
+#include <OpenKneeboard/Win32.h>
+
+#include <OpenKneeboard/dprint.h>
+#include <OpenKneeboard/scope_guard.h>
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace OpenKneeboard {
+
+namespace {
+
+std::weak_ptr<FilesystemWatchMultiplexer> gInstance;
+
+bool PathsAreEquivalent(
+  const std::filesystem::path& a,
+  const std::filesystem::path& b) {
+  // NTFS is case-insensitive by default, and notifications use the case on
+  // disk, which may not match the case we were given
+  return CompareStringOrdinal(a.c_str(), -1, b.c_str(), -1, TRUE)
+    == CSTR_EQUAL;
+}
+
+winrt::file_handle OpenDirectory(const std::filesystem::path& directory) {
+  auto handle = Win32::CreateFileW(
+    directory.c_str(),
+    FILE_LIST_DIRECTORY,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+    NULL);
+  if (!handle) {
+    dprintf(
+      "Failed to open '{}' for watching: {:#08x}", directory, GetLastError());
+  }
+  return handle;
+}
+
+class ReadDirectoryChangesWatch final : public IFilesystemWatchBackend::Watch {
+ public:
+  ReadDirectoryChangesWatch(
+    const std::filesystem::path& directory,
+    winrt::file_handle handle,
+    bool recursive,
+    IFilesystemWatchBackend::Callback callback)
+    : mDirectory(directory),
+      mHandle(std::move(handle)),
+      mRecursive(recursive),
+      mCallback(std::move(callback)) {
+    mEvent = Win32::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    mStoppedEvent = Win32::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    mStopEvent = Win32::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    this->Run();
+  }
+
+  ~ReadDirectoryChangesWatch() override {
+    mStop.request_stop();
+    SetEvent(mStopEvent.get());
+    // Retry in case we raced with `Run()` starting a new read
+    do {
+      std::unique_lock lock(mHandleMutex);
+      CancelIoEx(mHandle.get(), nullptr);
+    } while (WaitForSingleObject(mStoppedEvent.get(), 100) == WAIT_TIMEOUT);
+  }
+
+ private:
+  static constexpr std::chrono::seconds MinRetryDelay {1};
+  static constexpr std::chrono::seconds MaxRetryDelay {30};
+
+  /// Stop watching until `Run()` re-opens the directory
+  void OnError() {
+    {
+      std::unique_lock lock(mHandleMutex);
+      mHandle.close();
+    }
+    // e.g. the directory was deleted, so we don't know what changed
+    mCallback({});
+  }
+
+  winrt::fire_and_forget Run() {
+    const scope_guard stopped(
+      [event = mStoppedEvent.get()]() { SetEvent(event); });
+    co_await winrt::resume_background();
+
+    const auto stop = mStop.get_token();
+    std::vector<std::filesystem::path> changed;
+    auto retryDelay = MinRetryDelay;
+    while (!stop.stop_requested()) {
+      if (!mHandle) {
+        // Back off, e.g. while a deleted directory is being re-created
+        if (co_await winrt::resume_on_signal(mStopEvent.get(), retryDelay)) {
+          co_return;
+        }
+        retryDelay = std::min(retryDelay * 2, MaxRetryDelay);
+        auto handle = OpenDirectory(mDirectory);
+        if (!handle) {
+          continue;
+        }
+        {
+          std::unique_lock lock(mHandleMutex);
+          mHandle = std::move(handle);
+        }
+        // Anything could have changed while we weren't watching
+        mCallback({});
+      }
+
+      OVERLAPPED overlapped {.hEvent = mEvent.get()};
+      if (!ReadDirectoryChangesW(
+            mHandle.get(),
+            mBuffer,
+            sizeof(mBuffer),
+            mRecursive,
+            FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+              | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+            nullptr,
+            &overlapped,
+            nullptr)) {
+        dprintf(
+          "ReadDirectoryChangesW() failed for '{}': {:#08x}",
+          mDirectory,
+          GetLastError());
+        this->OnError();
+        continue;
+      }
+
+      co_await winrt::resume_on_signal(mEvent.get());
+
+      DWORD bytes {};
+      if (!GetOverlappedResult(mHandle.get(), &overlapped, &bytes, TRUE)) {
+        const auto error = GetLastError();
+        if (stop.stop_requested()) {
+          co_return;
+        }
+        dprintf(
+          "Watching '{}' failed: {:#08x}",
+          mDirectory,
+          static_cast<uint32_t>(error));
+        this->OnError();
+        continue;
+      }
+      if (stop.stop_requested()) {
+        co_return;
+      }
+      retryDelay = MinRetryDelay;
+
+      // 0 bytes: the buffer overflowed, so we don't know what changed
+      changed.clear();
+      for (size_t offset = 0; bytes;) {
+        const auto& info
+          = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(mBuffer + offset);
+        changed.push_back(
+          mDirectory
+          / std::wstring_view {
+            info.FileName, info.FileNameLength / sizeof(wchar_t)});
+        if (!info.NextEntryOffset) {
+          break;
+        }
+        offset += info.NextEntryOffset;
+      }
+      mCallback(changed);
+    }
+  }
+
+  std::filesystem::path mDirectory;
+  winrt::file_handle mHandle;
+  bool mRecursive {false};
+  IFilesystemWatchBackend::Callback mCallback;
+
+  // Only needed for `CancelIoEx()` in the destructor; otherwise only used by
+  // `Run()`
+  std::mutex mHandleMutex;
+
+  winrt::handle mEvent;
+  winrt::handle mStoppedEvent;
+  winrt::handle mStopEvent;
+  std::stop_source mStop;
+
+  alignas(DWORD) std::byte mBuffer[16 * 1024];
+};
+
+class ReadDirectoryChangesBackend final : public IFilesystemWatchBackend {
+ public:
+  std::unique_ptr<Watch> CreateWatch(
+    const std::filesystem::path& directory,
+    bool recursive,
+    Callback callback) override {
+    auto handle = OpenDirectory(directory);
+    if (!handle) {
+      return nullptr;
+    }
+    return std::make_unique<ReadDirectoryChangesWatch>(
+      directory, std::move(handle), recursive, std::move(callback));
+  }
+};
+
+}// namespace
+
+double FilesystemWatchMultiplexer::Statistics::GetWakeupsPerSecond() const {
+  const std::chrono::duration<double> elapsed
+    = std::chrono::steady_clock::now() - mSince;
+  if (elapsed.count() <= 0) {
+    return 0;
+  }
+  return mWakeups / elapsed.count();
+}
+
+FilesystemWatchMultiplexer::Subscription::Subscription(
+  const std::shared_ptr<FilesystemWatchMultiplexer>& multiplexer,
+  uint64_t id)
+  : mMultiplexer(multiplexer), mID(id) {
+}
+
+FilesystemWatchMultiplexer::Subscription::~Subscription() {
+  mMultiplexer->Unsubscribe(mID);
+}
+
+std::shared_ptr<FilesystemWatchMultiplexer>
+FilesystemWatchMultiplexer::Get() {
+  static std::mutex sMutex;
+  std::unique_lock lock(sMutex);
+  auto shared = gInstance.lock();
+  if (!shared) {
+    shared = Create(std::make_unique<ReadDirectoryChangesBackend>());
+    gInstance = shared;
+  }
+  return shared;
+}
+
+std::shared_ptr<FilesystemWatchMultiplexer> FilesystemWatchMultiplexer::Create(
+  std::unique_ptr<IFilesystemWatchBackend> backend) {
+  return std::shared_ptr<FilesystemWatchMultiplexer>(
+    new FilesystemWatchMultiplexer(std::move(backend)));
+}
+
+FilesystemWatchMultiplexer::FilesystemWatchMultiplexer(
+  std::unique_ptr<IFilesystemWatchBackend> backend)
+  : mBackend(std::move(backend)) {
+  mStatistics.mSince = std::chrono::steady_clock::now();
+}
+
+// Subscriptions keep us alive, so by now there are no watches, and no
+// backend callbacks can be running
+FilesystemWatchMultiplexer::~FilesystemWatchMultiplexer() = default;
+
+std::unique_ptr<FilesystemWatchMultiplexer::Subscription>
+FilesystemWatchMultiplexer::Subscribe(
+  const std::filesystem::path& rawPath,
+  std::function<void()> callback) {
+  const auto path = rawPath.lexically_normal();
+  std::error_code ec;
+  const WatchKey key = std::filesystem::is_directory(path, ec)
+    ? WatchKey {path, /* recursive = */ true}
+    : WatchKey {path.parent_path(), /* recursive = */ false};
+
+  std::unique_lock lock(mMutex);
+  const auto id = ++mNextID;
+  mSubscribers.emplace(
+    id,
+    Subscriber {
+      .mPath = path,
+      .mWatchKey = key,
+      .mCallback = std::move(callback),
+    });
+
+  auto& watch = mWatches[key];
+  watch.mSubscribers.push_back(id);
+  if (!watch.mWatch) {
+    // Callbacks run on a background thread, so can't re-enter while we hold
+    // the lock.
+    //
+    // Raw `this` is fine, as the watch is destroyed before we are.
+    watch.mWatch = mBackend->CreateWatch(
+      std::get<0>(key), std::get<1>(key), [this, key](auto changed) {
+        this->OnChanged(key, changed);
+      });
+  }
+
+  return std::unique_ptr<Subscription>(
+    new Subscription(this->shared_from_this(), id));
+}
+
+void FilesystemWatchMultiplexer::Unsubscribe(uint64_t id) {
+  // Destroyed after we release the lock, as it waits for any in-progress
+  // callback, which may be waiting for the lock
+  std::unique_ptr<IFilesystemWatchBackend::Watch> unusedWatch;
+
+  std::unique_lock lock(mMutex);
+  const auto it = mSubscribers.find(id);
+  if (it == mSubscribers.end()) {
+    return;
+  }
+  const auto watch = mWatches.find(it->second.mWatchKey);
+  mSubscribers.erase(it);
+  if (watch == mWatches.end()) {
+    return;
+  }
+
+  std::erase(watch->second.mSubscribers, id);
+  if (watch->second.mSubscribers.empty()) {
+    unusedWatch = std::move(watch->second.mWatch);
+    mWatches.erase(watch);
+  }
+}
+
+void FilesystemWatchMultiplexer::OnChanged(
+  const WatchKey& key,
+  std::span<const std::filesystem::path> changed) {
+  std::vector<uint64_t> ready;
+  {
+    std::unique_lock lock(mMutex);
+    ++mStatistics.mWakeups;
+    const auto watch = mWatches.find(key);
+    if (watch == mWatches.end()) {
+      return;
+    }
+
+    const auto isRecursive = std::get<1>(key);
+    for (const auto id: watch->second.mSubscribers) {
+      auto& subscriber = mSubscribers.at(id);
+      const auto matches = changed.empty() || isRecursive
+        || std::ranges::any_of(changed, [&subscriber](const auto& path) {
+                             return PathsAreEquivalent(path, subscriber.mPath);
+                           });
+      if (!matches) {
+        continue;
+      }
+      if (subscriber.mPending) {
+        ++mStatistics.mCoalesced;
+        continue;
+      }
+      subscriber.mPending = true;
+      ready.push_back(id);
+    }
+  }
+
+  for (const auto id: ready) {
+    this->Deliver(id);
+  }
+}
+
+winrt::fire_and_forget FilesystemWatchMultiplexer::Deliver(uint64_t id) {
+  const auto weak = this->weak_from_this();
+  std::chrono::milliseconds settleTime {};
+  {
+    std::unique_lock lock(mMutex);
+    settleTime = mSettleTime;
+  }
+
+  co_await winrt::resume_after(settleTime);
+  const auto self = weak.lock();
+  if (!self) {
+    co_return;
+  }
+
+  std::function<void()> callback;
+  {
+    std::unique_lock lock(mMutex);
+    auto it = mSubscribers.find(id);
+    if (it == mSubscribers.end()) {
+      co_return;
+    }
+    it->second.mPending = false;
+    callback = it->second.mCallback;
+    ++mStatistics.mDeliveries;
+  }
+  callback();
+}
+
+void FilesystemWatchMultiplexer::SetSettleTime(
+  std::chrono::milliseconds settleTime) {
+  std::unique_lock lock(mMutex);
+  mSettleTime = settleTime;
+}
+
+FilesystemWatchMultiplexer::Statistics
+FilesystemWatchMultiplexer::GetStatistics() const {
+  std::unique_lock lock(mMutex);
+  auto ret = mStatistics;
+  ret.mWatches = mWatches.size();
+  ret.mSubscriptions = mSubscribers.size();
+  return ret;
+}
+
+}// namespace OpenKneeboard
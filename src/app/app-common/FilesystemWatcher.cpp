@@ -23,66 +23,41 @@
 
 #include <OpenKneeboard/scope_guard.h>
 
-using namespace winrt::Windows::Storage;
-using namespace winrt::Windows::Storage::Search;
-
 namespace OpenKneeboard {
 std::shared_ptr<FilesystemWatcher> FilesystemWatcher::Create(
   const std::filesystem::path& path) {
-  auto ret = shared_with_final_release(new FilesystemWatcher(path));
+  std::shared_ptr<FilesystemWatcher> ret {new FilesystemWatcher(path)};
   ret->Initialize();
   return ret;
 }
 
 FilesystemWatcher::FilesystemWatcher(const std::filesystem::path& path)
   : mPath(path) {
-  const auto watchedPath
-    = std::filesystem::is_directory(mPath) ? mPath : mPath.parent_path();
-  const auto handle = FindFirstChangeNotificationW(
-    watchedPath.wstring().c_str(),
-    /* watch subtree = */ true,
-    FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
-      | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE);
-  if (handle == INVALID_HANDLE_VALUE) {
-    dprintf("Invalid handle: {}", GetLastError());
-    OPENKNEEBOARD_BREAK;
-    return;
-  }
-  mHandle.reset(handle);
-  mShutdownHandle = Win32::CreateEventW(nullptr, FALSE, FALSE, nullptr);
-}
-
-winrt::fire_and_forget FilesystemWatcher::final_release(
-  std::unique_ptr<FilesystemWatcher> self) {
-  self->mStop.request_stop();
-  co_await winrt::resume_on_signal(self->mShutdownHandle.get());
 }
 
 FilesystemWatcher::~FilesystemWatcher() = default;
 
 void FilesystemWatcher::Initialize() {
   mLastWriteTime = std::filesystem::last_write_time(mPath);
-  mImpl = this->Run();
-}
-
-winrt::Windows::Foundation::IAsyncAction FilesystemWatcher::Run() {
-  auto handle = mHandle.get();
-  auto stop = mStop.get_token();
-  while (!stop.stop_requested()) {
-    winrt::check_bool(FindNextChangeNotification(handle));
-    co_await resume_on_signal(stop, handle);
-    if (stop.stop_requested()) {
-      SetEvent(mShutdownHandle.get());
-      co_return;
-    }
-    if (!mSettling) {
-      this->OnContentsChanged();
-    }
-  }
+  mSubscription = FilesystemWatchMultiplexer::Get()->Subscribe(
+    mPath, [weak = weak_from_this()]() {
+      auto self = weak.lock();
+      // Notifications can be delivered concurrently; only one of them should
+      // start waiting for the file to settle
+      if (self && !self->mSettling.exchange(true)) {
+        self->OnContentsChanged();
+      }
+    });
 }
 
 winrt::fire_and_forget FilesystemWatcher::OnContentsChanged() {
   const auto weak = weak_from_this();
+  // `mSettling` was set by the caller
+  const scope_guard settled([weak]() {
+    if (auto self = weak.lock()) {
+      self->mSettling = false;
+    }
+  });
 
   try {
     if (
@@ -107,9 +82,6 @@ winrt::fire_and_forget FilesystemWatcher::OnContentsChanged() {
   // 2023-03-26.
   static_assert(tickDelta == std::chrono::nanoseconds(100));
 
-  mSettling = true;
-  const scope_guard settled([this]() { mSettling = false; });
-
   while (true) {
     auto self = weak.lock();
     if (!self) {
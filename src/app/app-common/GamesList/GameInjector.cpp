@@ -68,7 +68,22 @@ GameInjector::~GameInjector() {
 void GameInjector::SetGameInstances(
   const std::vector<std::shared_ptr<GameInstance>>& games) {
   std::scoped_lock lock(mGamesMutex);
-  mGames = games;
+  mGamesByExecutable.clear();
+  for (const auto& game: games) {
+    const auto executable
+      = FoldExecutableName(game->mLastSeenPath.filename().wstring());
+    mGamesByExecutable[executable].push_back({
+      .mGame = game,
+      .mPathPattern = std::wstring {winrt::to_hstring(game->mPathPattern)},
+    });
+  }
+  ++mGamesGeneration;
+}
+
+std::wstring GameInjector::FoldExecutableName(std::wstring_view name) {
+  std::wstring ret {name};
+  CharLowerBuffW(ret.data(), static_cast<DWORD>(ret.size()));
+  return ret;
 }
 
 winrt::Windows::Foundation::IAsyncAction GameInjector::Run(
@@ -120,225 +135,254 @@ winrt::Windows::Foundation::IAsyncAction GameInjector::Run(
       }
     }
 
-    std::unordered_set<DWORD> seenProcesses;
+    bool gamesChanged = false;
+    {
+      std::scoped_lock lock(mGamesMutex);
+      gamesChanged = (mGamesGeneration != mSeenProcessesGeneration);
+      mSeenProcessesGeneration = mGamesGeneration;
+    }
+
+    // Only check processes that have started since the last scan, or that
+    // might be games; most processes are skipped with a hash lookup, instead
+    // of comparing them against every game.
+    const auto scan = ++mScanCount;
     for (int i = 0; i < processCount; ++i) {
       const auto& process = processes[i];
-      seenProcesses.insert(process.ProcessId);
+      const std::wstring_view name {process.pProcessName};
+      auto& seen = mSeenProcesses[process.ProcessId];
+      seen.mLastScan = scan;
+      const auto isNew = (seen.mName != name);
+      if (isNew) {
+        seen.mName = name;
+      }
+
       if (process.pUserSid == 0) {
         continue;
       }
-      CheckProcess(process.ProcessId, process.pProcessName);
+      const auto mightBeGame = mProcessCache.contains(process.ProcessId);
+      if (!(isNew || gamesChanged || mightBeGame)) {
+        continue;
+      }
+      if (!CheckProcess(process.ProcessId, name)) {
+        // Couldn't inspect the process yet; retry it on the next scan
+        seen.mName.clear();
+      }
     }
     WTSFreeMemory(processes);
     processes = nullptr;
 
-    auto it = mProcessCache.begin();
-    while (it != mProcessCache.end()) {
-      if (seenProcesses.contains(it->first)) {
-        ++it;
-        continue;
-      }
-      it = mProcessCache.erase(it);
-    }
+    std::erase_if(mSeenProcesses, [scan](const auto& it) {
+      return it.second.mLastScan != scan;
+    });
+    std::erase_if(mProcessCache, [this](const auto& it) {
+      return !mSeenProcesses.contains(it.first);
+    });
   } while (!stopToken.stop_requested());
 }
 
-void GameInjector::CheckProcess(
+bool GameInjector::CheckProcess(
   DWORD processID,
   std::wstring_view exeBaseName) {
-  HANDLE processHandle {NULL};
-  std::filesystem::path fullPath;
-
   std::scoped_lock lock(mGamesMutex);
-  for (const auto& game: mGames) {
-    if (game->mLastSeenPath.filename() != exeBaseName) {
-      continue;
-    }
-    if (!processHandle) {
-      if (mProcessCache.contains(processID)) {
-        const auto& entry = mProcessCache.at(processID);
-        processHandle = entry.mHandle.get();
-        fullPath = entry.mPath;
-      } else {
-        processHandle
-          = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, processID);
-        if (processHandle) {
-          wchar_t buf[MAX_PATH];
-          DWORD bufSize = sizeof(buf);
-          if (
-            QueryFullProcessImageNameW(processHandle, 0, buf, &bufSize)
-            && bufSize >= 0 && bufSize <= sizeof(buf)) {
-            fullPath
-              = std::filesystem::canonical(std::wstring_view {buf, bufSize});
-          }
-          mProcessCache.emplace(
-            processID,
-            ProcessCacheEntry {
-              .mHandle = winrt::handle {processHandle},
-              .mPath = fullPath,
-            });
-        }
-      }
-    }
-    if (!processHandle) {
+  const auto candidates
+    = mGamesByExecutable.find(FoldExecutableName(exeBaseName));
+  if (candidates == mGamesByExecutable.end()) {
+    return true;
+  }
+
+  if (!mProcessCache.contains(processID)) {
+    winrt::handle handle {
+      OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, processID)};
+    if (!handle) {
       dprintf(
         L"Failed to OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION) for PID {} "
         L"({}): {:#x}",
         processID,
         exeBaseName,
         std::bit_cast<uint32_t>(GetLastError()));
-      return;
+      return false;
     }
-
+    std::filesystem::path path;
+    wchar_t buf[MAX_PATH];
+    DWORD bufSize = sizeof(buf);
     if (
-      PathMatchSpecExW(
-        fullPath.wstring().c_str(),
-        winrt::to_hstring(game->mPathPattern).c_str(),
-        PMSF_NORMAL | PMSF_DONT_STRIP_SPACES)
-      != S_OK) {
-      continue;
+      QueryFullProcessImageNameW(handle.get(), 0, buf, &bufSize)
+      && bufSize >= 0 && bufSize <= sizeof(buf)) {
+      path = std::filesystem::canonical(std::wstring_view {buf, bufSize});
     }
-
-    const auto friendly = game->mGame->GetUserFriendlyName(fullPath);
-
-    InjectedDlls wantedDlls {InjectedDlls::None};
-
-    if (mWintabMode == WintabMode::EnabledInvasive) {
-      wantedDlls |= InjectedDlls::TabletProxy;
+    if (path.empty()) {
+      return false;
     }
+    mProcessCache.emplace(
+      processID,
+      ProcessCacheEntry {
+        .mHandle = std::move(handle),
+        .mPath = path,
+      });
+  }
 
-    std::filesystem::path overlayDll;
-    switch (game->mOverlayAPI) {
-      case OverlayAPI::None:
-      case OverlayAPI::SteamVR:
-      case OverlayAPI::OpenXR:
-        break;
-      case OverlayAPI::AutoDetect:
-        wantedDlls |= InjectedDlls::AutoDetection;
+  auto& process = mProcessCache.at(processID);
+  HANDLE processHandle = process.mHandle.get();
+  const auto& fullPath = process.mPath;
+
+  // Pattern matching is only repeated if the games have changed
+  if (process.mGamesGeneration != mGamesGeneration) {
+    process.mGamesGeneration = mGamesGeneration;
+    process.mGame = nullptr;
+    const auto path = fullPath.wstring();
+    for (const auto& [game, pattern]: candidates->second) {
+      if (
+        PathMatchSpecExW(
+          path.c_str(), pattern.c_str(), PMSF_NORMAL | PMSF_DONT_STRIP_SPACES)
+        == S_OK) {
+        process.mGame = game;
         break;
-      case OverlayAPI::NonVRD3D11:
-        wantedDlls |= InjectedDlls::NonVRD3D11;
-        break;
-      case OverlayAPI::OculusD3D11:
-        wantedDlls |= InjectedDlls::OculusD3D11;
-        break;
-      case OverlayAPI::OculusD3D12:
-        wantedDlls |= InjectedDlls::OculusD3D12;
-        break;
-      default:
-        dprintf(
-          "Unhandled OverlayAPI: {}", std23::to_underlying(game->mOverlayAPI));
-        OPENKNEEBOARD_BREAK;
-        return;
+      }
     }
+  }
+  if (!process.mGame) {
+    return true;
+  }
+  const auto game = process.mGame;
 
-    const auto currentGame = mKneeboardState->GetCurrentGame();
-    const DWORD currentPID = currentGame ? currentGame->mProcessID : 0;
+  const auto friendly = game->mGame->GetUserFriendlyName(fullPath);
 
-    if (currentPID != processID) {
-      // Lazy to-string approach
-      nlohmann::json overlayAPI;
-      to_json(overlayAPI, game->mOverlayAPI);
+  InjectedDlls wantedDlls {InjectedDlls::None};
 
+  if (mWintabMode == WintabMode::EnabledInvasive) {
+    wantedDlls |= InjectedDlls::TabletProxy;
+  }
+
+  std::filesystem::path overlayDll;
+  switch (game->mOverlayAPI) {
+    case OverlayAPI::None:
+    case OverlayAPI::SteamVR:
+    case OverlayAPI::OpenXR:
+      break;
+    case OverlayAPI::AutoDetect:
+      wantedDlls |= InjectedDlls::AutoDetection;
+      break;
+    case OverlayAPI::NonVRD3D11:
+      wantedDlls |= InjectedDlls::NonVRD3D11;
+      break;
+    case OverlayAPI::OculusD3D11:
+      wantedDlls |= InjectedDlls::OculusD3D11;
+      break;
+    case OverlayAPI::OculusD3D12:
+      wantedDlls |= InjectedDlls::OculusD3D12;
+      break;
+    default:
       dprintf(
-        "Current game changed to {}, PID {}, configured rendering API {}",
-        fullPath.string(),
-        processID,
-        overlayAPI.dump());
-      const auto elevated = IsElevated(processHandle);
-      if (IsElevated() != elevated) {
-        dprintf(
-          "WARNING: OpenKneeboard {} elevated, but PID {} {} elevated.",
-          IsElevated() ? "is" : "is not",
-          processID,
-          elevated ? "is" : "is not");
-      }
-      this->evGameChangedEvent.Emit(processID, fullPath, game);
-    }
+        "Unhandled OverlayAPI: {}", std23::to_underlying(game->mOverlayAPI));
+      OPENKNEEBOARD_BREAK;
+      return true;
+  }
 
-    auto& process = mProcessCache.at(processID);
+  const auto currentGame = mKneeboardState->GetCurrentGame();
+  const DWORD currentPID = currentGame ? currentGame->mProcessID : 0;
 
-    using InjectionAccessState = ProcessCacheEntry::InjectionAccessState;
-    if (process.mInjectionAccessState == InjectionAccessState::Failed) {
-      continue;
-    }
+  if (currentPID != processID) {
+    // Lazy to-string approach
+    nlohmann::json overlayAPI;
+    to_json(overlayAPI, game->mOverlayAPI);
 
-    auto& currentDlls = process.mInjectedDlls;
-    const auto missingDlls = wantedDlls & ~currentDlls;
-    if (missingDlls == InjectedDlls::None && process.mHaveLoggedDLLs) {
-      continue;
+    dprintf(
+      "Current game changed to {}, PID {}, configured rendering API {}",
+      fullPath.string(),
+      processID,
+      overlayAPI.dump());
+    const auto elevated = IsElevated(processHandle);
+    if (IsElevated() != elevated) {
+      dprintf(
+        "WARNING: OpenKneeboard {} elevated, but PID {} {} elevated.",
+        IsElevated() ? "is" : "is not",
+        processID,
+        elevated ? "is" : "is not");
     }
+    this->evGameChangedEvent.Emit(processID, fullPath, game);
+  }
 
-    if (process.mInjectionAccessState == InjectionAccessState::NotTried) {
-      dprintf("Reopening PID {} with VM and thread privileges", processID);
-      processHandle = OpenProcess(
-        PROCESS_QUERY_INFORMATION | PROCESS_VM_OPERATION | PROCESS_VM_READ
-          | PROCESS_VM_WRITE | PROCESS_CREATE_THREAD,
-        false,
-        processID);
-      if (!processHandle) {
-        const auto code = GetLastError();
-        const auto message
-          = std::system_category().default_error_condition(code).message();
-        dprintf(
-          "ERROR: Failed to OpenProcess() with VM and thread privileges for "
-          "PID {} ({}): "
-          "{:#x} ({})",
-          processID,
-          winrt::to_string(exeBaseName),
-          std::bit_cast<uint32_t>(code),
-          message);
-        process.mInjectionAccessState = InjectionAccessState::Failed;
-        continue;
-      }
-      process.mHandle = winrt::handle {processHandle};
-      process.mInjectionAccessState = InjectionAccessState::HaveInjectionAccess;
-      dprint("Reopened with VM and thread privileges");
-    }
+  using InjectionAccessState = ProcessCacheEntry::InjectionAccessState;
+  if (process.mInjectionAccessState == InjectionAccessState::Failed) {
+    return true;
+  }
 
-    const auto dlls = GetProcessCurrentDLLs(processHandle);
-    if (!process.mHaveLoggedDLLs) {
-      process.mHaveLoggedDLLs = true;
-      if (dlls.empty()) {
-        dprint("Failed to get DLL list");
-        continue;
-      }
-      std::vector<std::filesystem::path> sortedDLLs {dlls.begin(), dlls.end()};
-      std::ranges::sort(sortedDLLs);
-      for (const auto& dll: sortedDLLs) {
-        dprintf(
-          L"{} (PID {}) module: {}", exeBaseName, processID, dll.wstring());
-      }
+  auto& currentDlls = process.mInjectedDlls;
+  const auto missingDlls = wantedDlls & ~currentDlls;
+  if (missingDlls == InjectedDlls::None && process.mHaveLoggedDLLs) {
+    return true;
+  }
+
+  if (process.mInjectionAccessState == InjectionAccessState::NotTried) {
+    dprintf("Reopening PID {} with VM and thread privileges", processID);
+    processHandle = OpenProcess(
+      PROCESS_QUERY_INFORMATION | PROCESS_VM_OPERATION | PROCESS_VM_READ
+        | PROCESS_VM_WRITE | PROCESS_CREATE_THREAD,
+      false,
+      processID);
+    if (!processHandle) {
+      const auto code = GetLastError();
+      const auto message
+        = std::system_category().default_error_condition(code).message();
+      dprintf(
+        "ERROR: Failed to OpenProcess() with VM and thread privileges for "
+        "PID {} ({}): "
+        "{:#x} ({})",
+        processID,
+        winrt::to_string(exeBaseName),
+        std::bit_cast<uint32_t>(code),
+        message);
+      process.mInjectionAccessState = InjectionAccessState::Failed;
+      return true;
     }
+    process.mHandle = winrt::handle {processHandle};
+    process.mInjectionAccessState = InjectionAccessState::HaveInjectionAccess;
+    dprint("Reopened with VM and thread privileges");
+  }
 
+  const auto dlls = GetProcessCurrentDLLs(processHandle);
+  if (!process.mHaveLoggedDLLs) {
+    process.mHaveLoggedDLLs = true;
     if (dlls.empty()) {
-      continue;
+      dprint("Failed to get DLL list");
+      return true;
     }
-
-    if (missingDlls == InjectedDlls::None) {
-      continue;
+    std::vector<std::filesystem::path> sortedDLLs {dlls.begin(), dlls.end()};
+    std::ranges::sort(sortedDLLs);
+    for (const auto& dll: sortedDLLs) {
+      dprintf(
+        L"{} (PID {}) module: {}", exeBaseName, processID, dll.wstring());
     }
-    dprintf("Injecting DLLs into PID {} ({})", processID, fullPath.string());
+  }
 
-    const auto injectIfNeeded = [&](const auto dllID, const auto& dllPath) {
-      if (!static_cast<bool>(missingDlls & dllID)) {
-        return;
-      }
-      if (dlls.contains(dllPath)) {
-        currentDlls |= dllID;
-        dprintf("{} is already injected", dllPath.filename().string());
-        return;
-      }
-      InjectDll(processHandle, dllPath);
-      currentDlls |= dllID;
-    };
+  if (dlls.empty()) {
+    return true;
+  }
 
-    injectIfNeeded(InjectedDlls::TabletProxy, mTabletProxyDll);
-    injectIfNeeded(InjectedDlls::AutoDetection, mOverlayAutoDetectDll);
-    injectIfNeeded(InjectedDlls::NonVRD3D11, mOverlayNonVRD3D11Dll);
-    injectIfNeeded(InjectedDlls::OculusD3D11, mOverlayOculusD3D11Dll);
-    injectIfNeeded(InjectedDlls::OculusD3D12, mOverlayOculusD3D12Dll);
+  if (missingDlls == InjectedDlls::None) {
+    return true;
   }
+  dprintf("Injecting DLLs into PID {} ({})", processID, fullPath.string());
+
+  const auto injectIfNeeded = [&](const auto dllID, const auto& dllPath) {
+    if (!static_cast<bool>(missingDlls & dllID)) {
+      return;
+    }
+    if (dlls.contains(dllPath)) {
+      currentDlls |= dllID;
+      dprintf("{} is already injected", dllPath.filename().string());
+      return;
+    }
+    InjectDll(processHandle, dllPath);
+    currentDlls |= dllID;
+  };
+
+  injectIfNeeded(InjectedDlls::TabletProxy, mTabletProxyDll);
+  injectIfNeeded(InjectedDlls::AutoDetection, mOverlayAutoDetectDll);
+  injectIfNeeded(InjectedDlls::NonVRD3D11, mOverlayNonVRD3D11Dll);
+  injectIfNeeded(InjectedDlls::OculusD3D11, mOverlayOculusD3D11Dll);
+  injectIfNeeded(InjectedDlls::OculusD3D12, mOverlayOculusD3D12Dll);
+  return true;
 }
 
 std::unordered_set<std::filesystem::path> GameInjector::GetProcessCurrentDLLs(
@@ -76,11 +76,33 @@ class GameInjector final : public EventReceiver,
   GameInjector(KneeboardState* kneeboardState);
   static std::unordered_set<std::filesystem::path> GetProcessCurrentDLLs(
     HANDLE process);
-  void CheckProcess(DWORD processID, std::wstring_view exeBaseName);
+  // Returns false if the process couldn't be inspected, and should be retried
+  bool CheckProcess(DWORD processID, std::wstring_view exeBaseName);
+  static std::wstring FoldExecutableName(std::wstring_view);
+
   KneeboardState* mKneeboardState {nullptr};
-  std::vector<std::shared_ptr<GameInstance>> mGames;
+
+  struct GameMatcher {
+    std::shared_ptr<GameInstance> mGame;
+    std::wstring mPathPattern;
+  };
+  // Keyed by `FoldExecutableName()`, so most processes can be rejected with
+  // a single lookup
+  std::unordered_map<std::wstring, std::vector<GameMatcher>> mGamesByExecutable;
+  // Incremented whenever the games change, invalidating cached matches
+  uint64_t mGamesGeneration {1};
   std::mutex mGamesMutex;
 
+  // Processes from the previous scan; only new processes, and those that
+  // might be games, are checked again
+  struct SeenProcess {
+    std::wstring mName;
+    uint64_t mLastScan {0};
+  };
+  std::unordered_map<DWORD, SeenProcess> mSeenProcesses;
+  uint64_t mSeenProcessesGeneration {0};
+  uint64_t mScanCount {0};
+
   std::filesystem::path mTabletProxyDll;
   std::filesystem::path mOverlayAutoDetectDll;
   std::filesystem::path mOverlayNonVRD3D11Dll;
@@ -93,8 +115,11 @@ class GameInjector final : public EventReceiver,
       HaveInjectionAccess,
       Failed,
     };
+    // Also stops the PID being reused while this entry exists
     winrt::handle mHandle {};
     std::filesystem::path mPath;
+    std::shared_ptr<GameInstance> mGame;
+    uint64_t mGamesGeneration {0};
     InjectionAccessState mInjectionAccessState {InjectionAccessState::NotTried};
     InjectedDlls mInjectedDlls {InjectedDlls::None};
     bool mHaveLoggedDLLs {false};
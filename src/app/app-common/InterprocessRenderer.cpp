@@ -28,6 +28,7 @@
 #include <OpenKneeboard/InterprocessRenderer.h>
 #include <OpenKneeboard/KneeboardState.h>
 #include <OpenKneeboard/KneeboardView.h>
+#include <OpenKneeboard/Metrics.h>
 #include <OpenKneeboard/Spriting.h>
 #include <OpenKneeboard/TabView.h>
 #include <OpenKneeboard/ToolbarAction.h>
@@ -144,6 +145,9 @@ void InterprocessRenderer::SubmitFrame(
 
   {
     OPENKNEEBOARD_TraceLoggingScope("SHMSubmitFrame");
+    static auto& sHistogram
+      = Metrics::GetHistogram("InterprocessRenderer/SHMSubmitFrame");
+    const Metrics::ScopedTimer timer(sHistogram);
     mSHM.SubmitFrame(
       config,
       shmLayers,
@@ -383,6 +387,10 @@ void InterprocessRenderer::RenderNow() noexcept {
     return;
   }
 
+  static auto& sHistogram
+    = Metrics::GetHistogram("InterprocessRenderer/RenderNow");
+  const Metrics::ScopedTimer timer(sHistogram);
+
   const auto renderInfos = mKneeboard->GetViewRenderInfo();
   const auto layerCount = renderInfos.size();
 
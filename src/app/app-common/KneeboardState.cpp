@@ -601,6 +601,11 @@ void KneeboardState::SetProfileSettings(const ProfileSettings& profiles) {
   this->evProfileSettingsChangedEvent.Emit();
 
   const auto oldID = mProfiles.mActiveProfile;
+  for (const auto& [id, profile]: mProfiles.mProfiles) {
+    if (!profiles.mProfiles.contains(id)) {
+      mSettingsWriter.Forget(id);
+    }
+  }
   mProfiles = profiles;
   if (!mProfiles.mEnabled) {
     mProfiles.mActiveProfile = "default";
@@ -612,7 +617,9 @@ void KneeboardState::SetProfileSettings(const ProfileSettings& profiles) {
     return;
   }
 
-  const auto newSettings = Settings::Load(newID);
+  // Writes any pending changes first, so we don't load stale settings if we
+  // recently switched away from this profile
+  const auto newSettings = mSettingsWriter.Load(newID);
   mSettings = newSettings;
   lock.unlock();
 
@@ -632,6 +639,24 @@ void KneeboardState::SetProfileSettings(const ProfileSettings& profiles) {
   this->SetRepaintNeeded();
 }
 
+void KneeboardState::RemoveProfile(const std::string& profileID) {
+  auto profiles = mProfiles;
+  if (!profiles.mProfiles.contains(profileID)) {
+    return;
+  }
+  if (profileID == profiles.mActiveProfile) {
+    profiles.mActiveProfile = "default";
+  }
+  profiles.mProfiles.erase(profileID);
+  // Switches away if needed, and forgets any pending changes to the profile
+  this->SetProfileSettings(profiles);
+
+  // Actually erase the settings, by making them identical to the parent; this
+  // goes through the writer so that it can't overwrite or resurrect them
+  mSettingsWriter.Save(profileID, mSettingsWriter.Load("default"));
+  mSettingsWriter.Flush();
+}
+
 void KneeboardState::SaveSettings() {
   if (!mSaveSettingsEnabled) {
     return;
@@ -650,7 +675,7 @@ void KneeboardState::SaveSettings() {
     mSettings.mDirectInput = mDirectInput->GetSettings();
   }
 
-  mSettings.Save(mProfiles.mActiveProfile);
+  mSettingsWriter.Save(mProfiles.mActiveProfile, mSettings);
   evSettingsChangedEvent.Emit();
 }
 
@@ -861,6 +886,9 @@ void KneeboardState::InitializeViews() {
     AddEventListener(
       view->evNeedsRepaintEvent,
       std::bind_front(&KneeboardState::SetRepaintNeeded, this));
+    AddEventListener(
+      view->evCurrentTabChangedEvent,
+      [this](TabIndex) { this->OnCurrentTabChanged(); });
   }
 
   bool viewChanged = false;
@@ -882,6 +910,9 @@ void KneeboardState::InitializeViews() {
         AddEventListener(
           mAppWindowView->evNeedsRepaintEvent,
           std::bind_front(&KneeboardState::SetRepaintNeeded, this));
+        AddEventListener(
+          mAppWindowView->evCurrentTabChangedEvent,
+          [this](TabIndex) { this->OnCurrentTabChanged(); });
         viewChanged = true;
       }
   }
@@ -892,6 +923,21 @@ void KneeboardState::InitializeViews() {
   this->SetRepaintNeeded();
 }
 
+void KneeboardState::OnCurrentTabChanged() {
+  std::vector<std::shared_ptr<ITab>> activeTabs;
+  for (const auto& view: mViews) {
+    if (const auto tabView = view->GetCurrentTabView()) {
+      activeTabs.push_back(tabView->GetRootTab());
+    }
+  }
+  if (mAppWindowView) {
+    if (const auto tabView = mAppWindowView->GetCurrentTabView()) {
+      activeTabs.push_back(tabView->GetRootTab());
+    }
+  }
+  mTabsList->SetActiveTabs(activeTabs);
+}
+
 void KneeboardState::BeforeFrame() {
   OPENKNEEBOARD_TraceLoggingScope("KneeboardState::BeforeFrame()");
 
@@ -925,6 +971,7 @@ void KneeboardState::AfterFrame(FramePostEventKind) {
     return mSettings.m##name; \
   } \
   void KneeboardState::Reset##name##Settings() { \
+    mSettingsWriter.Flush(); \
     auto newSettings = mSettings; \
     newSettings.Reset##name##Section(mProfiles.mActiveProfile); \
     this->Set##name##Settings(newSettings.m##name); \
@@ -61,13 +61,17 @@ winrt::fire_and_forget FolderPageSource::Reload() noexcept {
 
   if (mPath.empty() || !std::filesystem::is_directory(mPath)) {
     EventDelay eventDelay;
+    mSnapshot = {};
+    mContents.clear();
+    mFilesWithoutDelegates.clear();
     this->SetDelegates({});
     evContentChangedEvent.Emit();
     co_return;
   }
 
   this->SubscribeToChanges();
-  this->OnFileModified(mPath);
+  mSnapshot = std::make_shared<DirectorySnapshot>(mPath);
+  this->QueueRescan(/* settle = */ false);
 }
 
 void FolderPageSource::SubscribeToChanges() {
@@ -84,47 +88,128 @@ void FolderPageSource::OnFileModified(const std::filesystem::path& directory) {
   if (directory != mPath) {
     return;
   }
-  if (!std::filesystem::is_directory(directory)) {
+  this->QueueRescan(/* settle = */ true);
+}
+
+void FolderPageSource::QueueRescan(bool settle) {
+  mRescanRequested = true;
+  if (mRescanRunning) {
     return;
   }
-  decltype(mContents) newContents;
-  bool modifiedOrNew = false;
-  for (const auto& entry:
-       std::filesystem::recursive_directory_iterator(directory)) {
-    if (!entry.is_regular_file()) {
-      continue;
+  mRescanRunning = true;
+  this->Rescan(settle);
+}
+
+winrt::fire_and_forget FolderPageSource::Rescan(bool settle) {
+  const auto weak = this->weak_from_this();
+  const auto uiThread = mUIThread;
+
+  while (true) {
+    if (settle) {
+      co_await winrt::resume_after(RescanSettleTime);
     }
 
-    const auto path = entry.path();
-    const auto mtime = entry.last_write_time();
+    std::shared_ptr<DirectorySnapshot> snapshot;
+    std::set<std::filesystem::path> recheck;
+    co_await uiThread;
+    {
+      const auto self = weak.lock();
+      if (!self) {
+        co_return;
+      }
+      if (!(mRescanRequested && mSnapshot)) {
+        mRescanRunning = false;
+        co_return;
+      }
+      // Any notifications from now on need another scan
+      mRescanRequested = false;
+      snapshot = mSnapshot;
+      recheck = mFilesWithoutDelegates;
+    }
+
+    co_await winrt::resume_background();
+    const auto diff = snapshot->Update(recheck);
 
-    auto it = mContents.find(path);
-    if (it != mContents.end()) {
-      // All file-sourced tabs watch their own content
-      newContents[path] = it->second;
-      newContents[path].mModified = mtime;
-      continue;
+    co_await uiThread;
+    {
+      const auto self = weak.lock();
+      if (!self) {
+        co_return;
+      }
+      // If the path changed while we were scanning, `Reload()` will have
+      // requested another scan
+      if (snapshot == mSnapshot) {
+        this->ApplyDiff(diff);
+      }
+    }
+    settle = true;
+  }
+}
+
+void FolderPageSource::ApplyDiff(const DirectorySnapshot::Diff& diff) {
+  bool changed = false;
+  const auto add = [&, this](const std::filesystem::path& path) {
+    if (mContents.contains(path)) {
+      return;
     }
     auto delegate = FilePageSource::Create(mDXR, mKneeboard, path);
-    if (delegate) {
-      modifiedOrNew = true;
-      newContents[path] = {mtime, delegate};
+    if (!delegate) {
+      mFilesWithoutDelegates.insert(path);
+      return;
+    }
+    mFilesWithoutDelegates.erase(path);
+    mContents.emplace(path, std::move(delegate));
+    changed = true;
+  };
+
+  if (diff.mIsInitialScan) {
+    mFilesWithoutDelegates.clear();
+    // Keep any delegates we already have, e.g. if we're reloading
+    decltype(mContents) previous;
+    std::swap(previous, mContents);
+    for (const auto& path: diff.mAdded) {
+      if (auto it = previous.find(path); it != previous.end()) {
+        mContents.insert(previous.extract(it));
+        continue;
+      }
+      add(path);
+    }
+    changed = changed || !previous.empty();
+  } else {
+    for (const auto& path: diff.mRemoved) {
+      mFilesWithoutDelegates.erase(path);
+      changed = mContents.erase(path) || changed;
+    }
+    for (const auto& [from, to]: diff.mRenamed) {
+      dprintf(L"Renamed '{}' to '{}'", from.wstring(), to.wstring());
+      mFilesWithoutDelegates.erase(from);
+      changed = mContents.erase(from) || changed;
+      add(to);
+    }
+    for (const auto& path: diff.mAdded) {
+      add(path);
+    }
+    // All file-sourced tabs watch their own content; however, we might not
+    // have been able to create a delegate when the file was first created,
+    // e.g. if it was empty.
+    for (const auto& path: diff.mModified) {
+      add(path);
     }
   }
 
-  if (newContents.size() == mContents.size() && !modifiedOrNew) {
+  if (!changed) {
     dprintf(L"No actual change to {}", mPath.wstring());
     return;
   }
   dprintf(L"Real change to {}", mPath.wstring());
 
   std::vector<std::shared_ptr<IPageSource>> delegates;
-  for (const auto& [path, info]: newContents) {
-    delegates.push_back(info.mDelegate);
+  delegates.reserve(mContents.size());
+  for (const auto& [path, delegate]: mContents) {
+    delegates.push_back(delegate);
   }
 
   EventDelay eventDelay;
-  mContents = newContents;
   this->SetDelegates(delegates);
 }
 
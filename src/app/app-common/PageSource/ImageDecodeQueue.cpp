@@ -0,0 +1,226 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/ImageDecodeQueue.h>
+
+#include <OpenKneeboard/dprint.h>
+#include <OpenKneeboard/tracing.h>
+
+#include <algorithm>
+#include <tuple>
+
+namespace OpenKneeboard {
+
+struct ImageDecodeQueue::Request {
+  winrt::com_ptr<IWICImagingFactory> mWIC;
+  std::filesystem::path mPath;
+  Callback mCallback;
+
+  // Protected by ImageDecodeQueue::mMutex
+  Priority mPriority {Priority::Visible};
+  Stage mStage {Stage::Preview};
+  uint64_t mSequence {0};
+
+  auto GetSortKey() const {
+    return std::tuple {mPriority, mStage, mSequence};
+  }
+};
+
+static std::weak_ptr<ImageDecodeQueue> gInstance;
+
+std::shared_ptr<ImageDecodeQueue> ImageDecodeQueue::Get() {
+  static std::mutex sMutex;
+  std::unique_lock lock(sMutex);
+  auto shared = gInstance.lock();
+  if (!shared) {
+    shared.reset(new ImageDecodeQueue());
+    gInstance = shared;
+  }
+  return shared;
+}
+
+ImageDecodeQueue::ImageDecodeQueue() = default;
+ImageDecodeQueue::~ImageDecodeQueue() = default;
+
+std::shared_ptr<ImageDecodeQueue::Request> ImageDecodeQueue::Enqueue(
+  const winrt::com_ptr<IWICImagingFactory>& wic,
+  const std::filesystem::path& path,
+  Priority priority,
+  Callback callback) {
+  auto request = std::make_shared<Request>(Request {
+    .mWIC = wic,
+    .mPath = path,
+    .mCallback = std::move(callback),
+    .mPriority = priority,
+  });
+
+  std::unique_lock lock(mMutex);
+  this->EnqueueLocked(request);
+  return request;
+}
+
+void ImageDecodeQueue::EnqueueLocked(const std::shared_ptr<Request>& request) {
+  request->mSequence = mNextSequence++;
+  mQueue.push_back(request);
+
+  if (mActiveWorkers < MaxConcurrentDecodes) {
+    ++mActiveWorkers;
+    this->RunWorker();
+  }
+}
+
+void ImageDecodeQueue::SetPriority(
+  const std::shared_ptr<Request>& request,
+  Priority priority) {
+  std::unique_lock lock(mMutex);
+  request->mPriority = priority;
+}
+
+std::shared_ptr<ImageDecodeQueue::Request> ImageDecodeQueue::TakeNext() {
+  std::unique_lock lock(mMutex);
+
+  // Drop cancelled requests
+  std::erase_if(mQueue, [](const auto& it) { return it.expired(); });
+
+  std::shared_ptr<Request> next;
+  auto nextIt = mQueue.end();
+  for (auto it = mQueue.begin(); it != mQueue.end(); ++it) {
+    auto request = it->lock();
+    if (!request) {
+      continue;
+    }
+    if ((!next) || request->GetSortKey() < next->GetSortKey()) {
+      next = std::move(request);
+      nextIt = it;
+    }
+  }
+
+  if (!next) {
+    --mActiveWorkers;
+    return nullptr;
+  }
+
+  mQueue.erase(nextIt);
+  return next;
+}
+
+winrt::fire_and_forget ImageDecodeQueue::RunWorker() {
+  // Keep alive until the queue is empty
+  auto self = shared_from_this();
+  co_await winrt::resume_background();
+
+  while (auto request = self->TakeNext()) {
+    Stage decoded {};
+    try {
+      decoded = Decode(*request);
+    } catch (const winrt::hresult_error& e) {
+      dprintf(
+        "Failed to decode image '{}': {:#010x} - {}",
+        request->mPath,
+        static_cast<uint32_t>(e.code().value),
+        winrt::to_string(e.message()));
+      NotifyFailed(*request);
+      continue;
+    } catch (const std::exception& e) {
+      dprintf("Failed to decode image '{}': {}", request->mPath, e.what());
+      NotifyFailed(*request);
+      continue;
+    } catch (...) {
+      dprintf("Failed to decode image '{}'", request->mPath);
+      NotifyFailed(*request);
+      continue;
+    }
+
+    std::unique_lock lock(self->mMutex);
+    if (decoded == Stage::Preview) {
+      request->mStage = Stage::Full;
+      self->mQueue.push_back(request);
+    }
+  }
+}
+
+void ImageDecodeQueue::NotifyFailed(const Request& request) noexcept {
+  // An exception escaping the worker would terminate the process
+  try {
+    request.mCallback(request.mStage, nullptr);
+  } catch (...) {
+    dprintf("Image decode failure callback failed for '{}'", request.mPath);
+  }
+}
+
+ImageDecodeQueue::Stage ImageDecodeQueue::Decode(const Request& request) {
+  OPENKNEEBOARD_TraceLoggingScope("ImageDecodeQueue::Decode()");
+  const auto wic = request.mWIC.get();
+
+  winrt::com_ptr<IWICBitmapDecoder> decoder;
+  winrt::check_hresult(wic->CreateDecoderFromFilename(
+    request.mPath.c_str(),
+    nullptr,
+    GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand,
+    decoder.put()));
+
+  winrt::com_ptr<IWICBitmapFrameDecode> frame;
+  winrt::check_hresult(decoder->GetFrame(0, frame.put()));
+
+  winrt::com_ptr<IWICBitmapSource> source = frame;
+
+  // Only modified by the worker that currently owns this request
+  auto stage = request.mStage;
+  if (stage == Stage::Preview) {
+    UINT width {};
+    UINT height {};
+    winrt::check_hresult(frame->GetSize(&width, &height));
+    const auto largest = std::max(width, height);
+    if (largest <= MaxPreviewDimension) {
+      // Not worth a separate preview
+      stage = Stage::Full;
+    } else {
+      // For some formats - e.g. JPEG - scaling the frame directly is
+      // much faster than decoding it at full size, then scaling
+      winrt::com_ptr<IWICBitmapScaler> scaler;
+      winrt::check_hresult(wic->CreateBitmapScaler(scaler.put()));
+      winrt::check_hresult(scaler->Initialize(
+        frame.get(),
+        std::max<UINT>(1, (width * MaxPreviewDimension) / largest),
+        std::max<UINT>(1, (height * MaxPreviewDimension) / largest),
+        WICBitmapInterpolationModeFant));
+      source = scaler;
+    }
+  }
+
+  winrt::com_ptr<IWICFormatConverter> converter;
+  winrt::check_hresult(wic->CreateFormatConverter(converter.put()));
+  winrt::check_hresult(converter->Initialize(
+    source.get(),
+    GUID_WICPixelFormat32bppPBGRA,
+    WICBitmapDitherTypeNone,
+    nullptr,
+    0.0f,
+    WICBitmapPaletteTypeMedianCut));
+
+  winrt::com_ptr<IWICBitmap> bitmap;
+  winrt::check_hresult(wic->CreateBitmapFromSource(
+    converter.get(), WICBitmapCacheOnLoad, bitmap.put()));
+
+  request.mCallback(stage, bitmap);
+  return stage;
+}
+
+}// namespace OpenKneeboard
@@ -17,14 +17,19 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
  * USA.
  */
+#include <OpenKneeboard/CachedLayer.h>
 #include <OpenKneeboard/ImageFilePageSource.h>
 
+#include <OpenKneeboard/config.h>
 #include <OpenKneeboard/dprint.h>
+#include <OpenKneeboard/tracing.h>
 
 #include <winrt/Windows.Foundation.Collections.h>
 #include <winrt/Windows.Foundation.h>
 
+#include <list>
 #include <ranges>
+#include <tuple>
 
 #include <wincodec.h>
 
@@ -40,6 +45,7 @@ std::shared_ptr<ImageFilePageSource> ImageFilePageSource::Create(
 
 ImageFilePageSource::ImageFilePageSource(const audited_ptr<DXResources>& dxr)
   : mDXR(dxr) {
+  mCache = std::make_unique<CachedLayer>(dxr);
 }
 
 void ImageFilePageSource::SetPaths(
@@ -71,11 +77,17 @@ void ImageFilePageSource::OnFileModified(const std::filesystem::path& path) {
     return;
   }
   if (std::filesystem::exists(path)) {
-    it->mBitmap = {};
-    it->mID = {};
+    // Reset everything except the path and watcher; this also cancels any
+    // pending decode
+    Page page {
+      .mPath = it->mPath,
+      .mWatcher = it->mWatcher,
+    };
+    *it = std::move(page);
   } else {
     mPages.erase(it);
   }
+  mCache->Reset();
   this->evContentChangedEvent.Emit();
 }
 
@@ -131,136 +143,289 @@ std::vector<PageID> ImageFilePageSource::GetPageIDs() const {
   return ret;
 }
 
+static std::optional<PixelSize> GetImageSize(
+  IWICImagingFactory* wic,
+  const std::filesystem::path& path) {
+  winrt::com_ptr<IWICBitmapDecoder> decoder;
+  wic->CreateDecoderFromFilename(
+    path.c_str(),
+    nullptr,
+    GENERIC_READ,
+    WICDecodeMetadataCacheOnDemand,
+    decoder.put());
+  if (!decoder) {
+    return std::nullopt;
+  }
+
+  winrt::com_ptr<IWICBitmapFrameDecode> frame;
+  decoder->GetFrame(0, frame.put());
+  if (!frame) {
+    return std::nullopt;
+  }
+
+  UINT width {};
+  UINT height {};
+  if (FAILED(frame->GetSize(&width, &height))) {
+    return std::nullopt;
+  }
+  return PixelSize {width, height};
+}
+
 PreferredSize ImageFilePageSource::GetPreferredSize(PageID pageID) {
-  auto bitmap = GetPageBitmap(pageID);
-  if (!bitmap) {
+  std::unique_lock lock(mMutex);
+  auto it = std::ranges::find_if(
+    mPages, [pageID](const auto& page) { return page.mID == pageID; });
+  if (it == mPages.end()) [[unlikely]] {
     return {};
   }
 
-  const auto size = bitmap->GetPixelSize();
+  auto& page = *it;
+  if (!page.mSize) {
+    // Only reads the header; the image is decoded in the background
+    page.mSize = GetImageSize(mDXR->mWIC.get(), page.mPath);
+    if (!page.mSize) {
+      return {};
+    }
+  }
 
-  return {{size.width, size.height}, ScalingKind::Bitmap};
+  return {*page.mSize, ScalingKind::Bitmap};
 }
 
 void ImageFilePageSource::RenderPage(
   RenderTarget* rt,
   PageID pageID,
   const PixelRect& rect) {
-  auto bitmap = GetPageBitmap(pageID);
+  OPENKNEEBOARD_TraceLoggingScope("ImageFilePageSource::RenderPage()");
+  const auto pageSize = this->GetPreferredSize(pageID).mPixelSize;
+  if (pageSize == PixelSize {}) {
+    return;
+  }
+
+  winrt::com_ptr<ID2D1Bitmap> bitmap;
+  // 0: nothing yet, 1: preview, 2: full image
+  size_t quality {0};
+  size_t residentBytes {0};
+  {
+    auto ctx = rt->d2d();
+    std::unique_lock lock(mMutex);
+    auto it = std::ranges::find_if(
+      mPages, [pageID](const auto& page) { return page.mID == pageID; });
+    if (it == mPages.end()) [[unlikely]] {
+      return;
+    }
+
+    // Upload anything that's been decoded since the last render. The WIC
+    // bitmaps are in memory, so the D2D bitmaps don't keep the file open.
+    auto& page = *it;
+    if (page.mDecodedPreview) {
+      ctx->CreateBitmapFromWicBitmap(
+        page.mDecodedPreview.get(), page.mPreview.put());
+      page.mDecodedPreview = nullptr;
+    }
+    if (page.mDecodedBitmap) {
+      ctx->CreateBitmapFromWicBitmap(
+        page.mDecodedBitmap.get(), page.mBitmap.put());
+      page.mDecodedBitmap = nullptr;
+      page.mDecodeRequest = nullptr;
+    }
+
+    if (page.mBitmap) {
+      bitmap = page.mBitmap;
+      quality = 2;
+      const auto size = bitmap->GetPixelSize();
+      residentBytes = static_cast<size_t>(size.width) * size.height * 4;
+    } else {
+      bitmap = page.mPreview;
+      quality = bitmap ? 1 : 0;
+      this->RequestDecode(page, ImageDecodeQueue::Priority::Visible);
+    }
+
+    const auto index = static_cast<size_t>(it - mPages.begin());
+    if (index > 0) {
+      this->RequestDecode(
+        mPages.at(index - 1), ImageDecodeQueue::Priority::Adjacent);
+    }
+    if (index + 1 < mPages.size()) {
+      this->RequestDecode(
+        mPages.at(index + 1), ImageDecodeQueue::Priority::Adjacent);
+    }
+  }
+
+  if (residentBytes) {
+    UpdateResidency(weak_from_this(), pageID, residentBytes);
+  }
+
   if (!bitmap) {
     return;
   }
-  const auto pageSize = bitmap->GetPixelSize();
 
-  const auto renderSize
-    = PixelSize(pageSize.width, pageSize.height).ScaledToFit(rect.mSize);
+  const auto renderSize = pageSize.ScaledToFit(rect.mSize);
 
   const auto renderLeft
     = rect.Left() + ((rect.Width() - renderSize.Width()) / 2);
   const auto renderTop
     = rect.Top() + ((rect.Height() - renderSize.Height()) / 2);
 
-  auto ctx = rt->d2d();
-  ctx->DrawBitmap(
-    bitmap.get(),
+  // Scaling a full-resolution bitmap is expensive, so only do it when the page
+  // or quality changes, not on every repaint
+  mCache->Render(
     PixelRect {{renderLeft, renderTop}, renderSize},
-    1.0f,
-    D2D1_INTERPOLATION_MODE_ANISOTROPIC);
+    (pageID.GetTemporaryValue() << 2) | quality,
+    rt,
+    [bitmap](RenderTarget* rt, const PixelSize& size) {
+      rt->d2d()->DrawBitmap(
+        bitmap.get(),
+        PixelRect {{0, 0}, size},
+        1.0f,
+        D2D1_INTERPOLATION_MODE_ANISOTROPIC);
+    },
+    pageSize.IntegerScaledToFit(MaxViewRenderSize));
 }
 
-winrt::com_ptr<ID2D1Bitmap> ImageFilePageSource::GetPageBitmap(PageID pageID) {
-  std::unique_lock lock(mMutex);
-  auto it = std::ranges::find_if(
-    mPages, [pageID](const auto& page) { return page.mID == pageID; });
-  if (it == mPages.end()) [[unlikely]] {
-    return {};
+void ImageFilePageSource::RequestDecode(
+  Page& page,
+  ImageDecodeQueue::Priority priority) {
+  if (page.mBitmap || page.mDecodedBitmap) {
+    return;
   }
 
-  auto& page = *it;
-  if (page.mBitmap) [[likely]] {
-    return page.mBitmap;
+  if (page.mDecodeRequest) {
+    if (priority == ImageDecodeQueue::Priority::Visible) {
+      ImageDecodeQueue::Get()->SetPriority(page.mDecodeRequest, priority);
+    }
+    return;
   }
 
-  winrt::com_ptr<IWICBitmapDecoder> decoder;
+  page.mDecodeRequest = ImageDecodeQueue::Get()->Enqueue(
+    mDXR->mWIC,
+    page.mPath,
+    priority,
+    [weak = weak_from_this(), id = page.mID, uiThread = mUIThread](
+      auto stage, const auto& bitmap) {
+      // Hop to the UI thread before taking a strong reference, so we're never
+      // destroyed on a background thread
+      [](auto weak, auto id, auto uiThread, auto stage, auto bitmap)
+        -> winrt::fire_and_forget {
+        co_await uiThread;
+        if (auto self = weak.lock()) {
+          self->OnDecoded(id, stage, bitmap);
+        }
+      }(weak, id, uiThread, stage, bitmap);
+    });
+}
 
-  const auto wic = mDXR->mWIC.get();
+void ImageFilePageSource::OnDecoded(
+  PageID pageID,
+  ImageDecodeQueue::Stage stage,
+  const winrt::com_ptr<IWICBitmap>& bitmap) {
+  {
+    std::unique_lock lock(mMutex);
+    auto it = std::ranges::find_if(
+      mPages, [pageID](const auto& page) { return page.mID == pageID; });
+    if (it == mPages.end()) {
+      // Removed or modified while we were decoding
+      return;
+    }
 
-  auto path = page.mPath.wstring();
-  wic->CreateDecoderFromFilename(
-    path.c_str(),
-    nullptr,
-    GENERIC_READ,
-    WICDecodeMetadataCacheOnLoad,
-    decoder.put());
-  if (!decoder) {
-    return {};
-  }
+    if (!bitmap) {
+      // Failed; request it again the next time the page is rendered
+      it->mDecodeRequest = nullptr;
+      return;
+    }
 
-  winrt::com_ptr<IWICBitmapFrameDecode> frame;
-  decoder->GetFrame(0, frame.put());
-  if (!frame) {
-    return {};
+    switch (stage) {
+      case ImageDecodeQueue::Stage::Preview:
+        if (!(it->mPreview || it->mBitmap)) {
+          it->mDecodedPreview = bitmap;
+        }
+        break;
+      case ImageDecodeQueue::Stage::Full:
+        it->mDecodedBitmap = bitmap;
+        break;
+    }
   }
 
-  winrt::com_ptr<IWICFormatConverter> converter;
-  wic->CreateFormatConverter(converter.put());
-  if (!converter) {
-    return {};
+  if (stage == ImageDecodeQueue::Stage::Full) {
+    // Count it now, not when it's first rendered; otherwise prefetched pages
+    // aren't limited by `MaxResidentBytes`
+    UINT width {};
+    UINT height {};
+    if (SUCCEEDED(bitmap->GetSize(&width, &height))) {
+      UpdateResidency(
+        weak_from_this(), pageID, static_cast<size_t>(width) * height * 4);
+    }
   }
-  converter->Initialize(
-    frame.get(),
-    GUID_WICPixelFormat32bppPBGRA,
-    WICBitmapDitherTypeNone,
-    nullptr,
-    0.0f,
-    WICBitmapPaletteTypeMedianCut);
-
-  /* `CreateBitmapFromWicBitmap` creates a Direct2D bitmap that refers to
-   * - and retains a reference to - the existing WIC bitmap.
-   *
-   * This means that Direct2D/Direct3D indirectly keep a reference to an
-   * object that keeps an open file alive; releasing the internal references
-   * is not enough to close the file - we need to also wait for Direct2D/3D to
-   * finish.
-   *
-   * This is problematic if this `FolderTab` is pointing at a temporary folder
-   * if we later want to delete the temporary folder: even after calling
-   * `SetPath({})`, DirectX may still hold references to the Direct2D bitmap,
-   * and in turn the WIC bitmap and open file.
-   *
-   * The simplest way to deal with this problem is to do an immediate on-GPU
-   * copy of the pixel data from the WIC-referencing bitmap to an independent
-   * bitmap - then the WIC bitmap can immediately be freed, and is never
-   * referenced (or kept alive) by the D3D11 render pipeline.
-   */
-  winrt::com_ptr<ID2D1Bitmap> sharedBitmap;
-  winrt::com_ptr<ID2D1DeviceContext> ctx;
-  winrt::check_hresult(mDXR->mD2DDevice->CreateDeviceContext(
-    D2D1_DEVICE_CONTEXT_OPTIONS_NONE, ctx.put()));
-
-  ctx->CreateBitmapFromWicBitmap(converter.get(), sharedBitmap.put());
-  if (!sharedBitmap) {
-    return {};
+  evNeedsRepaintEvent.Emit();
+}
+
+void ImageFilePageSource::EvictBitmap(PageID pageID) {
+  std::unique_lock lock(mMutex);
+  auto it = std::ranges::find_if(
+    mPages, [pageID](const auto& page) { return page.mID == pageID; });
+  if (it == mPages.end()) {
+    return;
   }
+  it->mBitmap = nullptr;
+  it->mDecodedBitmap = nullptr;
+  it->mDecodeRequest = nullptr;
+}
 
-  // For WIC, this MUST be B8G8R8A8_UNORM, not _UNORM_SRGB, or the copy silently
-  // fails.
-  winrt::check_hresult(ctx->CreateBitmap(
-    sharedBitmap->GetPixelSize(),
-    D2D1_BITMAP_PROPERTIES {
-      .pixelFormat = {
-        .format = DXGI_FORMAT_B8G8R8A8_UNORM,
-        .alphaMode = D2D1_ALPHA_MODE_PREMULTIPLIED,
-      },
-    },
-    page.mBitmap.put()));
+namespace {
 
-  if (!page.mBitmap) {
-    return {};
+struct ResidentBitmap {
+  std::weak_ptr<ImageFilePageSource> mSource;
+  PageID mPageID;
+  size_t mBytes {0};
+};
+
+std::mutex gResidentMutex;
+// Most-recently-used first
+std::list<ResidentBitmap> gResident;
+size_t gResidentBytes {0};
+
+}// namespace
+
+void ImageFilePageSource::UpdateResidency(
+  const std::weak_ptr<ImageFilePageSource>& source,
+  PageID pageID,
+  size_t bytes) {
+  std::vector<std::tuple<std::shared_ptr<ImageFilePageSource>, PageID>> evict;
+  {
+    std::unique_lock lock(gResidentMutex);
+
+    std::erase_if(gResident, [](const ResidentBitmap& entry) {
+      if (entry.mSource.expired()) {
+        gResidentBytes -= entry.mBytes;
+        return true;
+      }
+      return false;
+    });
+
+    auto it = std::ranges::find_if(gResident, [&](const ResidentBitmap& entry) {
+      return entry.mPageID == pageID && !entry.mSource.owner_before(source)
+        && !source.owner_before(entry.mSource);
+    });
+    if (it == gResident.end()) {
+      gResident.push_front({source, pageID, bytes});
+      gResidentBytes += bytes;
+    } else if (it != gResident.begin()) {
+      gResident.splice(gResident.begin(), gResident, it);
+    }
+
+    while (gResidentBytes > MaxResidentBytes && gResident.size() > 1) {
+      const auto& lru = gResident.back();
+      gResidentBytes -= lru.mBytes;
+      if (auto lruSource = lru.mSource.lock()) {
+        evict.push_back({lruSource, lru.mPageID});
+      }
+      gResident.pop_back();
+    }
   }
-  page.mBitmap->CopyFromBitmap(nullptr, sharedBitmap.get(), nullptr);
 
-  return page.mBitmap;
+  // Don't hold gResidentMutex while acquiring the per-instance mutex
+  for (const auto& [lruSource, lruPageID]: evict) {
+    lruSource->EvictBitmap(lruPageID);
+  }
 }
 
 bool ImageFilePageSource::IsNavigationAvailable() const {
@@ -28,6 +28,7 @@
 #include <OpenKneeboard/NavigationTab.h>
 #include <OpenKneeboard/PDFFilePageSource.h>
 #include <OpenKneeboard/PDFNavigation.h>
+#include <OpenKneeboard/PageIDIndex.h>
 #include <OpenKneeboard/RuntimeFiles.h>
 
 #include <OpenKneeboard/config.h>
@@ -53,6 +54,7 @@
 #include <fstream>
 #include <iterator>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <shared_mutex>
 #include <thread>
@@ -71,7 +73,7 @@ struct PDFFilePageSource::Impl final {
 
   audited_ptr<DXResources> mDXR;
   std::filesystem::path mPath;
-  std::shared_ptr<Filesystem::TemporaryCopy> mCopy;
+  std::shared_ptr<Filesystem::TemporarySnapshot> mCopy;
 
   PdfDocument mPDFDocument {nullptr};
   winrt::com_ptr<IPdfRendererNative> mPDFRenderer;
@@ -83,11 +85,12 @@ struct PDFFilePageSource::Impl final {
 
   bool mNavigationLoaded = false;
 
-  std::unordered_map<RenderTargetID, std::unique_ptr<CachedLayer>> mCache;
+  std::unique_ptr<CachedLayer> mCache;
+  std::optional<PageIndex> mLastRenderedPageIndex;
   std::unique_ptr<DoodleRenderer> mDoodles;
   std::shared_ptr<FilesystemWatcher> mWatcher;
 
-  std::vector<PageID> mPageIDs;
+  PageIDIndex mPageIDs;
 
   std::shared_mutex mMutex;
 };
@@ -100,6 +103,7 @@ PDFFilePageSource::PDFFilePageSource(
   p->mPDFRenderer = dxr->mPDFRenderer;
   p->mBackgroundBrush = dxr->mWhiteBrush;
   p->mHighlightBrush = dxr->mHighlightBrush;
+  p->mCache = std::make_unique<CachedLayer>(dxr);
   p->mDoodles = std::make_unique<DoodleRenderer>(dxr, kbs);
   AddEventListener(
     p->mDoodles->evAddedPageEvent, this->evAvailableFeaturesChangedEvent);
@@ -190,7 +194,7 @@ winrt::fire_and_forget PDFFilePageSource::ReloadRenderer() {
     {
       std::unique_lock lock(p->mMutex);
       p->mPDFDocument = std::move(document);
-      p->mPageIDs.resize(p->mPDFDocument.PageCount());
+      p->mPageIDs.Resize(p->mPDFDocument.PageCount());
     }
   }
 
@@ -279,52 +283,70 @@ PageID PDFFilePageSource::GetPageIDForIndex(PageIndex index) const {
   }
   {
     std::shared_lock lock(p->mMutex);
-    if (index < p->mPageIDs.size()) {
-      return p->mPageIDs.at(index);
+    if (index < p->mPageIDs.GetPageCount()) {
+      return p->mPageIDs.GetPageID(index);
     }
   }
   std::unique_lock lock(p->mMutex);
-  p->mPageIDs.resize(index + 1);
-  return p->mPageIDs.back();
+  p->mPageIDs.Resize(index + 1);
+  return p->mPageIDs.GetPageID(index);
 }
 
 winrt::fire_and_forget PDFFilePageSource::Reload() {
-  static uint64_t sCount = 0;
   auto uiThread = mUIThread;
   auto weak = weak_from_this();
 
+  // Keep the previous snapshot alive until we've created the new one, so that
+  // it can be reused if the file hasn't actually changed
+  std::shared_ptr<Filesystem::TemporarySnapshot> previousCopy;
+
   {
     auto self = weak.lock();
     if (!self) {
       co_return;
     }
 
+    // Page IDs are about to change; saved strokes are reloaded by page index.
+    // Get the store again so that it can discard strokes if the document has
+    // changed
+    p->mDoodles->ClearExcept({});
+    if (std::filesystem::is_regular_file(p->mPath)) {
+      p->mDoodles->SetPersistentStore(
+        DoodleStore::Get(p->mPath),
+        [weak](PageID id) -> std::optional<PageIndex> {
+          auto self = weak.lock();
+          if (!self) {
+            return std::nullopt;
+          }
+          std::shared_lock lock(self->p->mMutex);
+          return self->p->mPageIDs.GetIndex(id);
+        });
+    } else {
+      p->mDoodles->SetPersistentStore({}, {});
+    }
+
     std::unique_lock lock(p->mMutex);
-    p->mCopy = {};
+    previousCopy = std::exchange(p->mCopy, {});
     p->mBookmarks.clear();
     p->mLinks.clear();
     p->mNavigationLoaded = false;
-    p->mCache.clear();
-    p->mPageIDs.clear();
+    p->mCache->Reset();
+    p->mLastRenderedPageIndex = {};
+    p->mPageIDs.Clear();
 
     if (!std::filesystem::is_regular_file(p->mPath)) {
       co_return;
     }
   }
 
-  // Do copy in a background thread so we're not hung up on antivirus
+  // Snapshot in a background thread so we're not hung up on antivirus
   co_await winrt::resume_background();
 
   auto self = weak.lock();
   if (!self) {
     co_return;
   }
-  auto tempPath = Filesystem::GetTemporaryDirectory()
-    / std::format(L"{:08x}-{}{}",
-                  ++sCount,
-                  p->mPath.stem().wstring().substr(0, 16),
-                  p->mPath.extension());
-  p->mCopy = std::make_shared<Filesystem::TemporaryCopy>(p->mPath, tempPath);
+  p->mCopy = Filesystem::TemporarySnapshot::Create(p->mPath);
 
   this->ReloadRenderer();
   this->ReloadNavigation();
@@ -351,14 +373,16 @@ std::vector<PageID> PDFFilePageSource::GetPageIDs() const {
   }
   {
     std::shared_lock lock(p->mMutex);
-    if (pageCount == p->mPageIDs.size()) {
-      return p->mPageIDs;
+    if (pageCount == p->mPageIDs.GetPageCount()) {
+      const auto ids = p->mPageIDs.GetPageIDs();
+      return {ids.begin(), ids.end()};
     }
   }
 
   std::unique_lock lock(p->mMutex);
-  p->mPageIDs.resize(pageCount);
-  return p->mPageIDs;
+  p->mPageIDs.Resize(pageCount);
+  const auto ids = p->mPageIDs.GetPageIDs();
+  return {ids.begin(), ids.end()};
 }
 
 PreferredSize PDFFilePageSource::GetPreferredSize(PageID id) {
@@ -366,12 +390,12 @@ PreferredSize PDFFilePageSource::GetPreferredSize(PageID id) {
     return {};
   }
 
-  auto it = std::ranges::find(p->mPageIDs, id);
-  if (it == p->mPageIDs.end()) {
+  std::shared_lock lock(p->mMutex);
+  const auto index = p->mPageIDs.GetIndex(id);
+  if (!index) {
     return {};
   }
-  const auto index = it - p->mPageIDs.begin();
-  auto size = p->mPDFDocument.GetPage(index).Size();
+  auto size = p->mPDFDocument.GetPage(*index).Size();
 
   return {
     {static_cast<UINT32>(size.Width), static_cast<UINT32>(size.Height)},
@@ -392,13 +416,12 @@ void PDFFilePageSource::RenderPageContent(
 
   std::shared_lock lock(p->mMutex);
 
-  const auto pageIt = std::ranges::find(p->mPageIDs, id);
-  if (pageIt == p->mPageIDs.end()) {
+  const auto index = p->mPageIDs.GetIndex(id);
+  if (!index) {
     return;
   }
-  const auto index = pageIt - p->mPageIDs.begin();
 
-  auto page = p->mPDFDocument.GetPage(index);
+  auto page = p->mPDFDocument.GetPage(*index);
 
   auto ctx = rt->d2d();
   ctx->FillRectangle(rect, p->mBackgroundBrush.get());
@@ -537,15 +560,11 @@ void PDFFilePageSource::RenderPage(
   RenderTarget* rt,
   PageID pageID,
   const PixelRect& rect) {
-  const auto rtid = rt->GetID();
   OPENKNEEBOARD_TraceLoggingScope("PDFFilePageSource::RenderPage()");
-  if (!p->mCache.contains(rtid)) {
-    p->mCache[rtid] = std::make_unique<CachedLayer>(p->mDXR);
-  }
   const auto cacheDimensions
     = this->GetPreferredSize(pageID).mPixelSize.IntegerScaledToFit(
       MaxViewRenderSize);
-  p->mCache[rtid]->Render(
+  p->mCache->Render(
     rect,
     pageID.GetTemporaryValue(),
     rt,
@@ -557,6 +576,65 @@ void PDFFilePageSource::RenderPage(
   const auto d2d = rt->d2d();
   p->mDoodles->Render(d2d, pageID, rect);
   this->RenderOverDoodles(d2d, pageID, rect);
+
+  this->PrefetchAdjacentPage(pageID);
+}
+
+void PDFFilePageSource::PrefetchAdjacentPage(PageID currentPage) {
+  std::optional<PageID> prefetchPage;
+  {
+    std::unique_lock lock(p->mMutex);
+    const auto maybeIndex = p->mPageIDs.GetIndex(currentPage);
+    if (!maybeIndex) {
+      return;
+    }
+    const auto index = *maybeIndex;
+    const auto previous = std::exchange(p->mLastRenderedPageIndex, index);
+    if (previous == index) {
+      // Already prefetched when we first rendered this page
+      return;
+    }
+
+    const bool forwards = (!previous) || index > *previous;
+    if (forwards && index + 1 < p->mPageIDs.GetPageCount()) {
+      prefetchPage = p->mPageIDs.GetPageID(index + 1);
+    } else if ((!forwards) && index > 0) {
+      prefetchPage = p->mPageIDs.GetPageID(index - 1);
+    } else {
+      return;
+    }
+  }
+
+  auto dq = winrt::Microsoft::UI::Dispatching::DispatcherQueue::
+    GetForCurrentThread();
+  if (!dq) {
+    return;
+  }
+
+  dq.TryEnqueue(
+    winrt::Microsoft::UI::Dispatching::DispatcherQueuePriority::Low,
+    [weak = weak_from_this(), prefetchPage = *prefetchPage]() {
+      auto self = weak.lock();
+      if (!self) {
+        return;
+      }
+      OPENKNEEBOARD_TraceLoggingScope(
+        "PDFFilePageSource::PrefetchAdjacentPage()");
+      const auto cacheDimensions
+        = self->GetPreferredSize(prefetchPage)
+            .mPixelSize.IntegerScaledToFit(MaxViewRenderSize);
+      if (cacheDimensions.mWidth == 0 || cacheDimensions.mHeight == 0) {
+        return;
+      }
+
+      const std::unique_lock dxlock(*(self->p->mDXR));
+      self->p->mCache->Prefetch(
+        prefetchPage.GetTemporaryValue(),
+        [self = self.get(), prefetchPage](auto rt, const auto& size) {
+          self->RenderPageContent(rt, prefetchPage, {{0, 0}, size});
+        },
+        cacheDimensions);
+    });
 }
 
 void PDFFilePageSource::OnFileModified(const std::filesystem::path& path) {
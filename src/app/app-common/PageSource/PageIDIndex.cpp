@@ -0,0 +1,114 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/PageIDIndex.h>
+
+#include <algorithm>
+
+namespace OpenKneeboard {
+
+void PageIDIndex::Clear() {
+  mPageIDs.clear();
+  mPositions.clear();
+}
+
+void PageIDIndex::Assign(std::span<const PageID> ids, size_t delegateIndex) {
+  const auto knownCount = mPageIDs.size();
+  const bool isAppend = knownCount > 0 && ids.size() >= knownCount
+    && std::ranges::equal(ids.first(knownCount), mPageIDs);
+  if (!isAppend) {
+    this->Clear();
+    this->Append(ids, delegateIndex);
+    return;
+  }
+  this->Append(ids.subspan(knownCount), delegateIndex);
+}
+
+void PageIDIndex::Append(PageID id, size_t delegateIndex) {
+  mPositions.insert_or_assign(
+    id,
+    Position {
+      .mPageIndex = static_cast<PageIndex>(mPageIDs.size()),
+      .mDelegateIndex = delegateIndex,
+    });
+  mPageIDs.push_back(id);
+}
+
+void PageIDIndex::Append(std::span<const PageID> ids, size_t delegateIndex) {
+  mPageIDs.reserve(mPageIDs.size() + ids.size());
+  mPositions.reserve(mPositions.size() + ids.size());
+  for (const auto& id: ids) {
+    this->Append(id, delegateIndex);
+  }
+}
+
+void PageIDIndex::Resize(PageIndex pageCount) {
+  if (pageCount < mPageIDs.size()) {
+    for (auto i = pageCount; i < mPageIDs.size(); ++i) {
+      mPositions.erase(mPageIDs.at(i));
+    }
+    mPageIDs.resize(pageCount);
+    return;
+  }
+
+  const auto delegateIndex
+    = mPageIDs.empty() ? 0 : mPositions.at(mPageIDs.back()).mDelegateIndex;
+  mPageIDs.reserve(pageCount);
+  mPositions.reserve(pageCount);
+  while (mPageIDs.size() < pageCount) {
+    this->Append(PageID {}, delegateIndex);
+  }
+}
+
+std::optional<PageIDIndex::Position> PageIDIndex::Find(PageID id) const {
+  if (!id) {
+    return std::nullopt;
+  }
+  const auto it = mPositions.find(id);
+  if (it == mPositions.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::optional<PageIndex> PageIDIndex::GetIndex(PageID id) const {
+  const auto position = this->Find(id);
+  if (!position) {
+    return std::nullopt;
+  }
+  return position->mPageIndex;
+}
+
+bool PageIDIndex::Contains(PageID id) const {
+  return id && mPositions.contains(id);
+}
+
+PageID PageIDIndex::GetPageID(PageIndex index) const {
+  return mPageIDs.at(index);
+}
+
+std::span<const PageID> PageIDIndex::GetPageIDs() const noexcept {
+  return mPageIDs;
+}
+
+PageIndex PageIDIndex::GetPageCount() const noexcept {
+  return static_cast<PageIndex>(mPageIDs.size());
+}
+
+}// namespace OpenKneeboard
@@ -23,9 +23,11 @@
 
 #include <OpenKneeboard/config.h>
 #include <OpenKneeboard/scope_guard.h>
+#include <OpenKneeboard/tracing.h>
 
 #include <algorithm>
 #include <numeric>
+#include <span>
 
 namespace OpenKneeboard {
 
@@ -33,6 +35,11 @@ PageSourceWithDelegates::PageSourceWithDelegates(
   const audited_ptr<DXResources>& dxr,
   KneeboardState* kbs)
   : mDXResources(dxr) {
+  mWakeDelegates = [this]() {
+    mHibernating = false;
+    this->AttachDelegates(mDelegatesLoader());
+  };
+  mContentLayerCache = std::make_unique<CachedLayer>(dxr);
   mDoodles = std::make_unique<DoodleRenderer>(dxr, kbs);
   mFixedEvents = {
     AddEventListener(mDoodles->evNeedsRepaintEvent, this->evNeedsRepaintEvent),
@@ -41,12 +48,10 @@ PageSourceWithDelegates::PageSourceWithDelegates(
     AddEventListener(
       this->evContentChangedEvent,
       [this]() {
-        this->mContentLayerCache.clear();
-        std::unordered_set<PageID> keep;
-        for (const auto pageID: this->GetPageIDs()) {
-          keep.insert(pageID);
-        }
-        this->mDoodles->ClearExcept(keep);
+        this->mContentLayerCache->Reset();
+        this->RebuildPageIndex();
+        const auto pageIDs = mPageIndex.GetPageIDs();
+        this->mDoodles->ClearExcept({pageIDs.begin(), pageIDs.end()});
       }),
   };
 }
@@ -62,23 +67,42 @@ PageSourceWithDelegates::~PageSourceWithDelegates() {
 
 void PageSourceWithDelegates::SetDelegates(
   const std::vector<std::shared_ptr<IPageSource>>& delegates) {
-  mPageDelegates.clear();
+  mDelegatesLoader = {};
+  mHibernating = false;
+  this->AttachDelegates(delegates);
+  this->evContentChangedEvent.Emit();
+}
 
+void PageSourceWithDelegates::SetDelegatesLoader(
+  const DelegatesLoader& loader) {
+  mDelegatesLoader = loader;
+  this->AttachDelegates({});
+  mHibernating = true;
+  this->evContentChangedEvent.Emit();
+}
+
+void PageSourceWithDelegates::AttachDelegates(
+  const std::vector<std::shared_ptr<IPageSource>>& delegates) {
   for (auto& event: mDelegateEvents) {
     this->RemoveEventListener(event);
   }
   mDelegateEvents.clear();
 
   mDelegates = delegates;
+  this->RebuildPageIndex();
 
-  for (auto& delegate: delegates) {
-    std::weak_ptr<IPageSource> weakDelegate {delegate};
+  for (size_t i = 0; i < delegates.size(); ++i) {
+    const auto& delegate = delegates.at(i);
     std::ranges::copy(
       std::vector<EventHandlerToken> {
         AddEventListener(
           delegate->evNeedsRepaintEvent, this->evNeedsRepaintEvent),
         AddEventListener(
-          delegate->evPageAppendedEvent, this->evPageAppendedEvent),
+          delegate->evPageAppendedEvent,
+          [this, i](SuggestedPageAppendAction action) {
+            this->OnDelegatePageAppended(i);
+            this->evPageAppendedEvent.Emit(action);
+          }),
         AddEventListener(
           delegate->evContentChangedEvent, this->evContentChangedEvent),
         AddEventListener(
@@ -90,11 +114,39 @@ void PageSourceWithDelegates::SetDelegates(
       },
       std::back_inserter(mDelegateEvents));
   }
+}
+
+void PageSourceWithDelegates::LoadDelegates() const {
+  if (!mHibernating) {
+    return;
+  }
+  OPENKNEEBOARD_TraceLoggingScope("PageSourceWithDelegates::LoadDelegates()");
 
+  // Nothing can have seen the content while we were hibernating, so loading
+  // it isn't an observable change, and doesn't need to emit events.
+  mWakeDelegates();
+}
+
+bool PageSourceWithDelegates::IsHibernating() const {
+  return mHibernating;
+}
+
+bool PageSourceWithDelegates::CanHibernate() const {
+  return mDelegatesLoader && !mHibernating && !this->CanClearUserInput();
+}
+
+void PageSourceWithDelegates::Hibernate() {
+  if (!this->CanHibernate()) {
+    return;
+  }
+  OPENKNEEBOARD_TraceLoggingScope("PageSourceWithDelegates::Hibernate()");
+  this->AttachDelegates({});
+  mHibernating = true;
   this->evContentChangedEvent.Emit();
 }
 
 PageIndex PageSourceWithDelegates::GetPageCount() const {
+  this->LoadDelegates();
   PageIndex count = 0;
   for (const auto& delegate: mDelegates) {
     count += delegate->GetPageCount();
@@ -103,6 +155,7 @@ PageIndex PageSourceWithDelegates::GetPageCount() const {
 }
 
 std::vector<PageID> PageSourceWithDelegates::GetPageIDs() const {
+  this->LoadDelegates();
   std::vector<PageID> ret;
   for (const auto& delegate: mDelegates) {
     auto ids = delegate->GetPageIDs();
@@ -111,15 +164,56 @@ std::vector<PageID> PageSourceWithDelegates::GetPageIDs() const {
   return ret;
 }
 
+void PageSourceWithDelegates::RebuildPageIndex() const {
+  mPageIndex.Clear();
+  for (size_t i = 0; i < mDelegates.size(); ++i) {
+    mPageIndex.Append(mDelegates.at(i)->GetPageIDs(), i);
+  }
+}
+
+void PageSourceWithDelegates::OnDelegatePageAppended(size_t delegateIndex) {
+  if (delegateIndex + 1 != mDelegates.size()) {
+    // Pages were inserted in the middle, so the indices of later pages changed
+    this->RebuildPageIndex();
+    return;
+  }
+
+  const auto delegatePages = mDelegates.at(delegateIndex)->GetPageIDs();
+  const auto first = delegatePages.empty()
+    ? std::nullopt
+    : mPageIndex.Find(delegatePages.front());
+  if (!(first && first->mDelegateIndex == delegateIndex)) {
+    this->RebuildPageIndex();
+    return;
+  }
+
+  // The last delegate's pages are at the end of the index; we can just add the
+  // new ones, as long as it's actually an append
+  const auto knownCount = mPageIndex.GetPageCount() - first->mPageIndex;
+  if (
+    knownCount > delegatePages.size()
+    || !std::ranges::equal(
+      mPageIndex.GetPageIDs().subspan(first->mPageIndex),
+      std::span {delegatePages}.first(knownCount))) {
+    this->RebuildPageIndex();
+    return;
+  }
+
+  mPageIndex.Append(
+    std::span {delegatePages}.subspan(knownCount), delegateIndex);
+}
+
 std::shared_ptr<IPageSource> PageSourceWithDelegates::FindDelegate(
   PageID pageID) const {
   if (!pageID) {
     return {nullptr};
   }
-  if (mPageDelegates.contains(pageID)) {
-    return mPageDelegates.at(pageID).lock();
+  if (const auto position = mPageIndex.Find(pageID)) {
+    return mDelegates.at(position->mDelegateIndex);
   }
 
+  // We should have been notified of any changes via events, but a delegate
+  // may have added pages without notifying us yet
   auto delegate
     = std::ranges::find_if(mDelegates, [pageID](const auto& delegate) {
         auto pageIDs = delegate->GetPageIDs();
@@ -129,7 +223,7 @@ std::shared_ptr<IPageSource> PageSourceWithDelegates::FindDelegate(
   if (delegate == mDelegates.end()) {
     return {nullptr};
   }
-  mPageDelegates[pageID] = *delegate;
+  this->RebuildPageIndex();
   return *delegate;
 }
 
@@ -172,12 +266,7 @@ void PageSourceWithDelegates::RenderPageWithCache(
   RenderTarget* rt,
   PageID pageID,
   const PixelRect& rect) {
-  const auto rtid = rt->GetID();
-  if (!mContentLayerCache.contains(rtid)) {
-    mContentLayerCache[rtid] = std::make_unique<CachedLayer>(mDXResources);
-  }
-
-  mContentLayerCache[rtid]->Render(
+  mContentLayerCache->Render(
     rect,
     pageID.GetTemporaryValue(),
     rt,
@@ -250,6 +339,8 @@ void PageSourceWithDelegates::ClearUserInput(PageID pageID) {
 }
 
 void PageSourceWithDelegates::ClearUserInput() {
+  // Delegates may have persisted user input, e.g. PDF doodles
+  this->LoadDelegates();
   const scope_guard updateState(
     [this]() { this->evAvailableFeaturesChangedEvent.Emit(); });
 
@@ -269,6 +360,7 @@ bool PageSourceWithDelegates::IsNavigationAvailable() const {
 
 std::vector<NavigationEntry> PageSourceWithDelegates::GetNavigationEntries()
   const {
+  this->LoadDelegates();
   std::vector<NavigationEntry> entries;
   for (const auto& delegate: mDelegates) {
     const auto withNavigation
@@ -20,6 +20,7 @@
 #pragma once
 
 #include <OpenKneeboard/DXResources.h>
+#include <OpenKneeboard/DirectorySnapshot.h>
 #include <OpenKneeboard/FilesystemWatcher.h>
 #include <OpenKneeboard/PageSourceWithDelegates.h>
 
@@ -28,7 +29,9 @@
 #include <shims/filesystem>
 #include <shims/winrt/base.h>
 
+#include <chrono>
 #include <memory>
+#include <set>
 
 namespace OpenKneeboard {
 
@@ -54,8 +57,18 @@ class FolderPageSource final
   winrt::fire_and_forget Reload() noexcept;
 
  private:
+  /** How long to wait for further changes before rescanning.
+   *
+   * Copying or extracting several files produces a burst of notifications;
+   * this lets us handle them in one pass.
+   */
+  static constexpr auto RescanSettleTime = std::chrono::milliseconds(250);
+
   void SubscribeToChanges();
   void OnFileModified(const std::filesystem::path&);
+  void QueueRescan(bool settle);
+  winrt::fire_and_forget Rescan(bool settle);
+  void ApplyDiff(const DirectorySnapshot::Diff&);
 
   winrt::apartment_context mUIThread;
   std::shared_ptr<FilesystemWatcher> mWatcher;
@@ -64,11 +77,16 @@ class FolderPageSource final
   KneeboardState* mKneeboard = nullptr;
 
   std::filesystem::path mPath;
-  struct DelegateInfo {
-    std::filesystem::file_time_type mModified;
-    std::shared_ptr<IPageSource> mDelegate;
-  };
-  std::map<std::filesystem::path, DelegateInfo> mContents;
+  std::map<std::filesystem::path, std::shared_ptr<IPageSource>> mContents;
+  // Files we couldn't create a delegate for; rechecked on every rescan
+  std::set<std::filesystem::path> mFilesWithoutDelegates;
+
+  // Replaced on the UI thread, but only updated by `Rescan()`, which may be
+  // on a background thread
+  std::shared_ptr<DirectorySnapshot> mSnapshot;
+  // UI thread only
+  bool mRescanRunning {false};
+  bool mRescanRequested {false};
 };
 
 }// namespace OpenKneeboard
@@ -0,0 +1,40 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <OpenKneeboard/IPageSource.h>
+
+namespace OpenKneeboard {
+
+/** A page source that can release its content while it's not in use.
+ *
+ * A hibernating page source reloads its content the next time it's queried;
+ * as this creates new `PageID`s, callers should avoid querying it unless
+ * they need to, and should track their position by page index.
+ */
+class IPageSourceWithHibernation : public virtual IPageSource {
+ public:
+  virtual bool IsHibernating() const = 0;
+  /// False if there's state that would be lost, e.g. doodles
+  virtual bool CanHibernate() const = 0;
+  virtual void Hibernate() = 0;
+};
+
+}// namespace OpenKneeboard
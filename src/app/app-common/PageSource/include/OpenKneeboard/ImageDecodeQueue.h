@@ -0,0 +1,101 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <shims/filesystem>
+#include <shims/winrt/base.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <wincodec.h>
+
+namespace OpenKneeboard {
+
+/** Decodes images on background threads.
+ *
+ * Each request is decoded twice: first a fast, reduced-resolution preview,
+ * then the full-resolution image. Requests are processed in order of
+ * priority, then stage, then age, with a limited number of concurrent
+ * decodes shared by the whole process.
+ *
+ * The decoded bitmaps are in memory, so they don't keep the file open.
+ */
+class ImageDecodeQueue final
+  : public std::enable_shared_from_this<ImageDecodeQueue> {
+ public:
+  static constexpr size_t MaxConcurrentDecodes = 2;
+  static constexpr uint32_t MaxPreviewDimension = 512;
+
+  enum class Priority {
+    Visible = 0,
+    Adjacent = 1,
+  };
+
+  enum class Stage {
+    Preview = 0,
+    Full = 1,
+  };
+
+  /** Called from a background thread.
+   *
+   * Small images skip the preview stage, so this may only be called once,
+   * with `Stage::Full`.
+   *
+   * If decoding fails, this is called with a null bitmap, and the request is
+   * finished; enqueue a new request to retry.
+   */
+  using Callback
+    = std::function<void(Stage, const winrt::com_ptr<IWICBitmap>&)>;
+
+  struct Request;
+
+  static std::shared_ptr<ImageDecodeQueue> Get();
+  ~ImageDecodeQueue();
+
+  /// The request is cancelled if the returned pointer is destroyed
+  std::shared_ptr<Request> Enqueue(
+    const winrt::com_ptr<IWICImagingFactory>&,
+    const std::filesystem::path&,
+    Priority,
+    Callback);
+  void SetPriority(const std::shared_ptr<Request>&, Priority);
+
+  ImageDecodeQueue(const ImageDecodeQueue&) = delete;
+  ImageDecodeQueue& operator=(const ImageDecodeQueue&) = delete;
+
+ private:
+  ImageDecodeQueue();
+
+  std::mutex mMutex;
+  std::vector<std::weak_ptr<Request>> mQueue;
+  size_t mActiveWorkers {0};
+  uint64_t mNextSequence {0};
+
+  void EnqueueLocked(const std::shared_ptr<Request>&);
+  std::shared_ptr<Request> TakeNext();
+  winrt::fire_and_forget RunWorker();
+  static Stage Decode(const Request&);
+  static void NotifyFailed(const Request&) noexcept;
+};
+
+}// namespace OpenKneeboard
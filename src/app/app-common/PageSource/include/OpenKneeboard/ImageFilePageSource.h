@@ -23,17 +23,25 @@
 #include <OpenKneeboard/Events.h>
 #include <OpenKneeboard/FilesystemWatcher.h>
 #include <OpenKneeboard/IPageSource.h>
+#include <OpenKneeboard/IPageSourceWithInternalCaching.h>
 #include <OpenKneeboard/IPageSourceWithNavigation.h>
+#include <OpenKneeboard/ImageDecodeQueue.h>
 
 #include <OpenKneeboard/audited_ptr.h>
 
 #include <shims/filesystem>
 #include <shims/winrt/base.h>
 
+#include <memory>
+#include <optional>
+
 namespace OpenKneeboard {
 
+class CachedLayer;
+
 class ImageFilePageSource final
   : public virtual IPageSource,
+    public virtual IPageSourceWithInternalCaching,
     public virtual IPageSourceWithNavigation,
     public virtual EventReceiver,
     public std::enable_shared_from_this<ImageFilePageSource> {
@@ -63,24 +71,51 @@ class ImageFilePageSource final
 
   ImageFilePageSource() = delete;
 
+  /// Limit for full-resolution images across all instances
+  static constexpr size_t MaxResidentBytes = 512 * 1024 * 1024;
+
  private:
   ImageFilePageSource(const audited_ptr<DXResources>&);
 
   struct Page {
     PageID mID;
     std::filesystem::path mPath;
+    std::optional<PixelSize> mSize;
+
+    // Decoded in the background, but not yet uploaded to the GPU
+    winrt::com_ptr<IWICBitmap> mDecodedPreview;
+    winrt::com_ptr<IWICBitmap> mDecodedBitmap;
+
+    winrt::com_ptr<ID2D1Bitmap> mPreview;
     winrt::com_ptr<ID2D1Bitmap> mBitmap;
+    std::shared_ptr<ImageDecodeQueue::Request> mDecodeRequest;
+
     std::shared_ptr<FilesystemWatcher> mWatcher;
   };
 
   void OnFileModified(const std::filesystem::path&);
 
   audited_ptr<DXResources> mDXR;
+  winrt::apartment_context mUIThread;
+  // Keyed by page and quality, so the full image replaces the preview
+  std::unique_ptr<CachedLayer> mCache;
 
   std::mutex mMutex;
   std::vector<Page> mPages = {};
 
-  winrt::com_ptr<ID2D1Bitmap> GetPageBitmap(PageID);
+  void RequestDecode(Page&, ImageDecodeQueue::Priority);
+  void OnDecoded(
+    PageID,
+    ImageDecodeQueue::Stage,
+    const winrt::com_ptr<IWICBitmap>&);
+
+  /// Release the full-resolution bitmap for a page, keeping the preview
+  void EvictBitmap(PageID);
+  /// Track GPU memory usage, and evict least-recently-used bitmaps if needed
+  static void UpdateResidency(
+    const std::weak_ptr<ImageFilePageSource>&,
+    PageID,
+    size_t bytes);
 };
 
 }// namespace OpenKneeboard
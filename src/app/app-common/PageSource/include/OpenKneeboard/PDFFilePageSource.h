@@ -90,6 +90,8 @@ class PDFFilePageSource final
     RenderTarget* rt,
     PageID pageIndex,
     const PixelRect& rect) noexcept;
+  /// Render the next page in the direction of travel into the cache, when idle
+  void PrefetchAdjacentPage(PageID currentPage);
   void
   RenderOverDoodles(ID2D1DeviceContext*, PageID pageIndex, const D2D1_RECT_F&);
 
@@ -0,0 +1,73 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <OpenKneeboard/UniqueID.h>
+
+#include <OpenKneeboard/inttypes.h>
+
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/** Constant-time lookups between PageIDs and page indices.
+ *
+ * Page sources that combine other page sources can also record which
+ * delegate each page belongs to.
+ *
+ * This is not thread-safe; callers are expected to use their own locks.
+ */
+class PageIDIndex final {
+ public:
+  struct Position {
+    PageIndex mPageIndex {0};
+    size_t mDelegateIndex {0};
+  };
+
+  void Clear();
+  /** Replace the contents of the index.
+   *
+   * If the new IDs are the existing IDs with more appended, only the new IDs
+   * are indexed.
+   */
+  void Assign(std::span<const PageID>, size_t delegateIndex = 0);
+  void Append(PageID, size_t delegateIndex = 0);
+  void Append(std::span<const PageID>, size_t delegateIndex = 0);
+  /// Truncate, or extend with new PageIDs
+  void Resize(PageIndex pageCount);
+
+  std::optional<Position> Find(PageID) const;
+  std::optional<PageIndex> GetIndex(PageID) const;
+  bool Contains(PageID) const;
+
+  PageID GetPageID(PageIndex) const;
+  /// View of the PageIDs in order; invalidated by any modification
+  std::span<const PageID> GetPageIDs() const noexcept;
+  PageIndex GetPageCount() const noexcept;
+
+ private:
+  std::vector<PageID> mPageIDs;
+  std::unordered_map<PageID, Position> mPositions;
+};
+
+}// namespace OpenKneeboard
@@ -23,11 +23,14 @@
 #include <OpenKneeboard/Events.h>
 #include <OpenKneeboard/IPageSource.h>
 #include <OpenKneeboard/IPageSourceWithCursorEvents.h>
+#include <OpenKneeboard/IPageSourceWithHibernation.h>
 #include <OpenKneeboard/IPageSourceWithNavigation.h>
 #include <OpenKneeboard/KneeboardState.h>
+#include <OpenKneeboard/PageIDIndex.h>
 
 #include <OpenKneeboard/audited_ptr.h>
 
+#include <functional>
 #include <memory>
 #include <tuple>
 #include <unordered_map>
@@ -42,6 +45,7 @@ class DoodleRenderer;
 class PageSourceWithDelegates : public virtual IPageSource,
                                 public virtual IPageSourceWithCursorEvents,
                                 public virtual IPageSourceWithNavigation,
+                                public virtual IPageSourceWithHibernation,
                                 public virtual EventReceiver {
  public:
   PageSourceWithDelegates() = delete;
@@ -64,20 +68,40 @@ class PageSourceWithDelegates : public virtual IPageSource,
   virtual bool IsNavigationAvailable() const override;
   virtual std::vector<NavigationEntry> GetNavigationEntries() const override;
 
+  virtual bool IsHibernating() const override;
+  virtual bool CanHibernate() const override;
+  virtual void Hibernate() override;
+
  protected:
+  using DelegatesLoader
+    = std::function<std::vector<std::shared_ptr<IPageSource>>()>;
+
   void SetDelegates(const std::vector<std::shared_ptr<IPageSource>>&);
+  /** Like `SetDelegates()`, but don't create them until they're needed.
+   *
+   * The loader is called again if the delegates are needed after
+   * `Hibernate()`.
+   */
+  void SetDelegatesLoader(const DelegatesLoader&);
 
  private:
   audited_ptr<DXResources> mDXResources;
   std::vector<std::shared_ptr<IPageSource>> mDelegates;
+  DelegatesLoader mDelegatesLoader;
+  // Bound in the constructor, so that const accessors can load the delegates
+  std::function<void()> mWakeDelegates;
+  bool mHibernating = false;
   std::vector<EventHandlerToken> mDelegateEvents;
   std::vector<EventHandlerToken> mFixedEvents;
 
+  void AttachDelegates(const std::vector<std::shared_ptr<IPageSource>>&);
+  void LoadDelegates() const;
   std::shared_ptr<IPageSource> FindDelegate(PageID) const;
-  mutable std::unordered_map<PageID, std::weak_ptr<IPageSource>> mPageDelegates;
+  mutable PageIDIndex mPageIndex;
+  void RebuildPageIndex() const;
+  void OnDelegatePageAppended(size_t delegateIndex);
 
-  std::unordered_map<RenderTargetID, std::unique_ptr<CachedLayer>>
-    mContentLayerCache;
+  std::unique_ptr<CachedLayer> mContentLayerCache;
   std::unique_ptr<DoodleRenderer> mDoodles;
 
   void RenderPageWithCache(
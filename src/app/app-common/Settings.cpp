@@ -20,6 +20,7 @@
 #include <OpenKneeboard/Filesystem.h>
 #include <OpenKneeboard/Settings.h>
 
+#include <OpenKneeboard/Win32.h>
 #include <OpenKneeboard/dprint.h>
 #include <OpenKneeboard/json.h>
 #include <OpenKneeboard/utf8.h>
@@ -27,9 +28,12 @@
 #include <shims/filesystem>
 #include <shims/winrt/base.h>
 
+#include <algorithm>
 #include <chrono>
 #include <format>
 #include <fstream>
+#include <functional>
+#include <optional>
 
 namespace OpenKneeboard {
 
@@ -57,66 +61,150 @@ static void MaybeSetFromJSON(T& out, const std::filesystem::path& path) {
   }
 }
 
-template <class T>
-static void MaybeSaveJSON(
-  const T& parentValue,
-  const T& value,
-  const std::filesystem::path& path) {
-  const auto fullPath
-    = path.is_absolute() ? path : Filesystem::GetSettingsDirectory() / path;
+static nlohmann::json ReadJSONFile(const std::filesystem::path& fullPath) {
+  std::error_code ec;
+  if (!std::filesystem::exists(fullPath, ec)) {
+    return {};
+  }
 
-  nlohmann::json j;
-  // If a profile already modified a setting, keep that setting even if it
-  // matches the parent now
-  if (std::filesystem::exists(fullPath)) {
-    std::ifstream f(fullPath);
-    try {
-      f >> j;
-    } catch (const nlohmann::json::exception& e) {
+  std::ifstream f(fullPath);
+  try {
+    nlohmann::json j;
+    f >> j;
+    return j;
+  } catch (const nlohmann::json::exception& e) {
+    dprintf(
+      "Error reading JSON from file '{}': {}", fullPath.string(), e.what());
+    return {};
+  }
+}
+
+static std::filesystem::path GetTemporaryPath(
+  const std::filesystem::path& fullPath) {
+  auto ret = fullPath;
+  ret += ".tmp";
+  return ret;
+}
+
+/** Replace the file as a whole, returning false on failure.
+ *
+ * If we crash or lose power, we'll be left with either the old file or the
+ * new file, along with a partial temporary file that `Settings::Load()`
+ * cleans up.
+ */
+static bool WriteJSONFile(
+  const std::filesystem::path& fullPath,
+  const nlohmann::json& j) {
+  const auto parentPath = fullPath.parent_path();
+  std::error_code ec;
+  std::filesystem::create_directories(parentPath, ec);
+  if (ec) {
+    dprintf("Failed to create '{}': {}", parentPath.string(), ec.message());
+    return false;
+  }
+
+  const auto data = j.dump(2) + "\n";
+  const auto temporary = GetTemporaryPath(fullPath);
+  {
+    const auto file = Win32::CreateFileW(
+      temporary.c_str(),
+      GENERIC_WRITE,
+      0,
+      nullptr,
+      CREATE_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL,
+      NULL);
+    if (!file) {
       dprintf(
-        "Error reading JSON from file '{}': {}", fullPath.string(), e.what());
+        "Failed to create '{}': {}", temporary.string(), GetLastError());
+      return false;
+    }
+    DWORD written {};
+    // Flush so that the data is on disk before the rename is
+    if (
+      (!WriteFile(
+        file.get(),
+        data.data(),
+        static_cast<DWORD>(data.size()),
+        &written,
+        nullptr))
+      || written != data.size() || !FlushFileBuffers(file.get())) {
+      dprintf("Failed to write '{}': {}", temporary.string(), GetLastError());
+      return false;
     }
   }
 
-  const auto parentPath = fullPath.parent_path();
-  if (!std::filesystem::exists(parentPath)) {
-    std::filesystem::create_directories(parentPath);
+  if (!MoveFileExW(
+        temporary.c_str(),
+        fullPath.c_str(),
+        MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    dprintf("Failed to replace '{}': {}", fullPath.string(), GetLastError());
+    return false;
+  }
+  return true;
+}
+
+static bool RemoveJSONFile(const std::filesystem::path& fullPath) {
+  std::error_code ec;
+  std::filesystem::remove(fullPath, ec);
+  if (ec) {
+    dprintf("Failed to remove '{}': {}", fullPath.string(), ec.message());
+    return false;
   }
+  return true;
+}
 
+/** Returns the new file contents, or null if the file was removed.
+ *
+ * `existing` is the current contents of the file, if any; returns
+ * `std::nullopt` if the file couldn't be updated.
+ */
+template <class T>
+static std::optional<nlohmann::json> MaybeSaveJSON(
+  const T& parentValue,
+  const T& value,
+  const std::filesystem::path& fullPath,
+  nlohmann::json existing) {
+  // If a profile already modified a setting, keep that setting even if it
+  // matches the parent now
+  auto& j = existing;
   to_json_with_default(j, parentValue, value);
   if (j.is_object() && j.size() > 0) {
-    std::ofstream f(fullPath);
-    f << std::setw(2) << j << std::endl;
-    return;
+    if (!WriteJSONFile(fullPath, j)) {
+      return std::nullopt;
+    }
+    return j;
   }
 
-  if (std::filesystem::exists(fullPath)) {
-    std::filesystem::remove(fullPath);
+  if (!RemoveJSONFile(fullPath)) {
+    return std::nullopt;
   }
+  return nlohmann::json {};
 }
 
 /** Used for GamesList and TabsList, where we don't want to merge configs -
  * either inherit, or overwrite */
 template <>
-void MaybeSaveJSON<nlohmann::json>(
+std::optional<nlohmann::json> MaybeSaveJSON<nlohmann::json>(
   const nlohmann::json& parentValue,
   const nlohmann::json& value,
-  const std::filesystem::path& path) {
-  const auto fullPath
-    = path.is_absolute() ? path : Filesystem::GetSettingsDirectory() / path;
-
-  if (value == parentValue && std::filesystem::exists(fullPath)) {
-    std::filesystem::remove(fullPath);
-    return;
+  const std::filesystem::path& fullPath,
+  nlohmann::json) {
+  if (value == parentValue) {
+    if (!RemoveJSONFile(fullPath)) {
+      return std::nullopt;
+    }
+    return nlohmann::json {};
   }
 
-  const auto parentPath = fullPath.parent_path();
-  if (!std::filesystem::exists(parentPath)) {
-    std::filesystem::create_directories(parentPath);
+  if (!WriteJSONFile(fullPath, value)) {
+    return std::nullopt;
   }
+  return value;
+}
 
-  std::ofstream f(fullPath);
-  f << std::setw(2) << value << std::endl;
+static std::filesystem::path GetProfileDirectory(std::string_view profile) {
+  return Filesystem::GetSettingsDirectory() / "profiles" / profile;
 }
 
 void Settings::Save(std::string_view profile) const {
@@ -133,7 +221,7 @@ void Settings::Save(std::string_view profile) const {
     parentSettings = Settings::Load("default");
   }
 
-  const auto profileDir = std::filesystem::path {"profiles"} / profile;
+  const auto profileDir = GetProfileDirectory(profile);
   if (parentSettings == *this && std::filesystem::is_directory(profileDir)) {
     // Ignore, e.g. if a file is open
     std::error_code ec;
@@ -142,11 +230,226 @@ void Settings::Save(std::string_view profile) const {
   }
 
 #define IT(cpptype, x) \
-  MaybeSaveJSON(parentSettings.m##x, this->m##x, profileDir / #x ".json");
+  { \
+    const auto path = profileDir / #x ".json"; \
+    MaybeSaveJSON(parentSettings.m##x, this->m##x, path, ReadJSONFile(path)); \
+  }
   OPENKNEEBOARD_SETTINGS_SECTIONS
 #undef IT
 }
 
+SettingsWriter::SettingsWriter() {
+  mThread = std::jthread {std::bind_front(&SettingsWriter::Run, this)};
+}
+
+SettingsWriter::~SettingsWriter() {
+  mThread.request_stop();
+  mThread.join();
+  this->Flush();
+}
+
+void SettingsWriter::Save(std::string_view profileID, const Settings& value) {
+  if (profileID.empty()) {
+    profileID = "default";
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock lock(mMutex);
+  if (mPending.empty()) {
+    mFirstPendingAt = now;
+  }
+  mLastPendingAt = now;
+
+  auto it = mPending.find(profileID);
+  if (it == mPending.end()) {
+    mPending.emplace(std::string {profileID}, value);
+  } else {
+    it->second = value;
+  }
+  lock.unlock();
+  mWakeup.notify_all();
+}
+
+void SettingsWriter::Flush() {
+  const std::unique_lock writeLock(mWriteMutex);
+  this->Write(this->TakePending());
+  mBaselines.clear();
+  mFiles.clear();
+}
+
+Settings SettingsWriter::Load(std::string_view profileID) {
+  if (profileID.empty()) {
+    profileID = "default";
+  }
+
+  const std::unique_lock writeLock(mWriteMutex);
+  this->Write(this->TakePending());
+  return this->GetBaseline(std::string {profileID});
+}
+
+void SettingsWriter::Forget(std::string_view profileID) {
+  // Wait for any in-progress write, so it can't cache this profile again after
+  // it's forgotten
+  const std::unique_lock writeLock(mWriteMutex);
+  {
+    const std::unique_lock lock(mMutex);
+    if (const auto it = mPending.find(profileID); it != mPending.end()) {
+      mPending.erase(it);
+    }
+  }
+  mBaselines.erase(std::string {profileID});
+  const auto profileDir = GetProfileDirectory(profileID);
+  std::erase_if(mFiles, [&profileDir](const auto& it) {
+    return it.first.parent_path() == profileDir;
+  });
+}
+
+void SettingsWriter::Run(std::stop_token stopToken) {
+  SetThreadDescription(GetCurrentThread(), L"Settings Writer Thread");
+
+  std::unique_lock lock(mMutex);
+  while (!stopToken.stop_requested()) {
+    if (mPending.empty()) {
+      mWakeup.wait(lock, stopToken, [this]() { return !mPending.empty(); });
+      continue;
+    }
+
+    // Wait for changes to settle, but don't wait forever if something keeps
+    // changing
+    const auto writeAt
+      = std::min(mLastPendingAt + SettleTime, mFirstPendingAt + MaxDelay);
+    if (std::chrono::steady_clock::now() < writeAt) {
+      mWakeup.wait_until(lock, stopToken, writeAt, []() { return false; });
+      continue;
+    }
+
+    // Lock order is mWriteMutex, then mMutex
+    lock.unlock();
+    {
+      const std::unique_lock writeLock(mWriteMutex);
+      this->Write(this->TakePending());
+    }
+    lock.lock();
+  }
+}
+
+SettingsWriter::PendingSettings SettingsWriter::TakePending() {
+  const std::unique_lock lock(mMutex);
+  return std::exchange(mPending, {});
+}
+
+void SettingsWriter::Write(const PendingSettings& pending) {
+  // Write the default profile first, as it's the parent of the others
+  if (pending.contains("default")) {
+    this->Write("default", pending.at("default"));
+  }
+  for (const auto& [profileID, value]: pending) {
+    if (profileID != "default") {
+      this->Write(profileID, value);
+    }
+  }
+}
+
+void SettingsWriter::Write(
+  const std::string& profileID,
+  const Settings& value) try {
+  const auto& baseline = this->GetBaseline(profileID);
+  if (baseline == value) {
+    return;
+  }
+
+  Settings parent;
+  if (profileID != "default") {
+    parent = this->GetBaseline("default");
+  }
+
+  const auto profileDir = GetProfileDirectory(profileID);
+  std::error_code ec;
+  if (parent == value && std::filesystem::is_directory(profileDir, ec)) {
+    // Ignore, e.g. if a file is open
+    std::filesystem::remove_all(profileDir, ec);
+    std::erase_if(mFiles, [&profileDir](const auto& it) {
+      return it.first.parent_path() == profileDir;
+    });
+    if (ec) {
+      // Re-read whatever is left next time
+      mBaselines.erase(profileID);
+    } else {
+      mBaselines.insert_or_assign(profileID, value);
+    }
+    return;
+  }
+
+  bool saved = true;
+#define IT(cpptype, x) \
+  if (value.m##x != baseline.m##x) { \
+    const auto path = profileDir / #x ".json"; \
+    const auto contents = MaybeSaveJSON( \
+      parent.m##x, value.m##x, path, this->GetFileContents(path)); \
+    if (contents) { \
+      this->SetFileContents(path, *contents); \
+    } else { \
+      mFiles.erase(path); \
+      saved = false; \
+    } \
+  }
+  OPENKNEEBOARD_SETTINGS_SECTIONS
+#undef IT
+
+  if (profileID == "default") {
+    // Other profiles inherit from the default profile, so their cached
+    // settings are now stale
+    std::erase_if(
+      mBaselines, [](const auto& it) { return it.first != "default"; });
+  }
+  if (saved) {
+    mBaselines.insert_or_assign(profileID, value);
+  } else {
+    // Some sections weren't written; compare against what's on disk next time
+    mBaselines.erase(profileID);
+  }
+} catch (const std::filesystem::filesystem_error& e) {
+  dprintf("Failed to save profile '{}': {}", profileID, e.what());
+  mBaselines.erase(profileID);
+}
+
+const Settings& SettingsWriter::GetBaseline(const std::string& profileID) {
+  auto it = mBaselines.find(profileID);
+  if (it == mBaselines.end()) {
+    it = mBaselines.emplace(profileID, Settings::Load(profileID)).first;
+  }
+  return it->second;
+}
+
+nlohmann::json SettingsWriter::GetFileContents(
+  const std::filesystem::path& path) {
+  std::error_code ec;
+  const auto lastWriteTime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    mFiles.erase(path);
+    return {};
+  }
+
+  // If something else modified the file, we need to re-read it
+  const auto it = mFiles.find(path);
+  if (it != mFiles.end() && it->second.mLastWriteTime == lastWriteTime) {
+    return it->second.mJSON;
+  }
+  return ReadJSONFile(path);
+}
+
+void SettingsWriter::SetFileContents(
+  const std::filesystem::path& path,
+  const nlohmann::json& contents) {
+  std::error_code ec;
+  const auto lastWriteTime = std::filesystem::last_write_time(path, ec);
+  if (contents.is_null() || ec) {
+    mFiles.erase(path);
+    return;
+  }
+  mFiles.insert_or_assign(path, FileState {contents, lastWriteTime});
+}
+
 template <>
 void from_json_postprocess<Settings>(const nlohmann::json& j, Settings& s) {
   // Backwards-compatibility
@@ -178,8 +481,7 @@ OPENKNEEBOARD_DEFINE_SPARSE_JSON(
     } else { \
       m##name = Settings::Load("default").m##name; \
     } \
-    const auto path = Filesystem::GetSettingsDirectory() / "profiles" \
-      / profileID / #name ".json"; \
+    const auto path = GetProfileDirectory(profileID) / #name ".json"; \
     if (std::filesystem::exists(path)) { \
       std::filesystem::remove(path); \
     } \
@@ -257,8 +559,18 @@ Settings Settings::Load(std::string_view profile) {
     parentSettings = settings;
   }
 
-  const auto profileDir
-    = Filesystem::GetSettingsDirectory() / "profiles" / profile;
+  const auto profileDir = GetProfileDirectory(profile);
+
+  // Left behind if we crashed while saving; the real file is intact
+#define IT(cpptype, x) \
+  if (const auto path = GetTemporaryPath(profileDir / #x ".json"); \
+      std::filesystem::exists(path)) { \
+    dprintf("Removing incomplete settings file '{}'", path.string()); \
+    std::error_code ec; \
+    std::filesystem::remove(path, ec); \
+  }
+  OPENKNEEBOARD_SETTINGS_SECTIONS
+#undef IT
 
 #define IT(cpptype, x) MaybeSetFromJSON(settings.m##x, profileDir / #x ".json");
   OPENKNEEBOARD_SETTINGS_SECTIONS
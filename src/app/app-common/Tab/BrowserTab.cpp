@@ -51,10 +51,15 @@ std::string BrowserTab::GetStaticGlyph() {
 }
 
 void BrowserTab::Reload() {
-  mDelegate = {};
-  this->SetDelegates({});
-  mDelegate = WebView2PageSource::Create(mDXR, mKneeboard, mSettings);
-  this->SetDelegates({mDelegate});
+  // Don't start a browser until the tab is actually used
+  this->SetDelegatesLoader(
+    [this]() -> std::vector<std::shared_ptr<IPageSource>> {
+      return {WebView2PageSource::Create(mDXR, mKneeboard, mSettings)};
+    });
+}
+
+bool BrowserTab::CanHibernate() const {
+  return false;
 }
 
 nlohmann::json BrowserTab::GetSettings() const {
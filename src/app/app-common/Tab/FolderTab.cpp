@@ -34,9 +34,16 @@ FolderTab::FolderTab(
   const std::filesystem::path& path)
   : TabBase(persistentID, title),
     PageSourceWithDelegates(dxr, kbs),
-    mPageSource(FolderPageSource::Create(dxr, kbs, path)),
+    mDXR(dxr),
+    mKneeboard(kbs),
     mPath {path} {
-  this->SetDelegates({mPageSource});
+  // Don't scan the folder until the tab is actually used
+  this->SetDelegatesLoader(
+    [this]() -> std::vector<std::shared_ptr<IPageSource>> {
+      auto source = FolderPageSource::Create(mDXR, mKneeboard, mPath);
+      mPageSource = source;
+      return {source};
+    });
 }
 
 FolderTab::FolderTab(
@@ -76,7 +83,10 @@ std::string FolderTab::GetStaticGlyph() {
 }
 
 void FolderTab::Reload() {
-  mPageSource->Reload();
+  // If we're hibernating, we'll scan the folder when we're next used
+  if (auto source = mPageSource.lock()) {
+    source->Reload();
+  }
 }
 
 std::filesystem::path FolderTab::GetPath() const {
@@ -87,8 +97,10 @@ void FolderTab::SetPath(const std::filesystem::path& path) {
   if (path == mPath) {
     return;
   }
-  mPageSource->SetPath(path);
   mPath = path;
+  if (auto source = mPageSource.lock()) {
+    source->SetPath(path);
+  }
 }
 
 }// namespace OpenKneeboard
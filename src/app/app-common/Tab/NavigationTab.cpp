@@ -238,7 +238,8 @@ void NavigationTab::RenderPage(
   ctx.Release();
 
   if (!mPreviewCache.contains(rt->GetID())) {
-    mPreviewCache.emplace(rt->GetID(), std::make_unique<CachedLayer>(mDXR));
+    mPreviewCache.emplace(
+      rt->GetID(), std::make_unique<CachedLayer>(mDXR, PreviewCacheMaxBytes));
   }
 
   mPreviewCache.at(rt->GetID())
@@ -24,6 +24,7 @@
 #include <OpenKneeboard/SingleFileTab.h>
 
 #include <OpenKneeboard/scope_guard.h>
+#include <OpenKneeboard/utf8.h>
 
 #include <shims/nlohmann/json.hpp>
 
@@ -104,23 +105,45 @@ void SingleFileTab::SetPath(const std::filesystem::path& rawPath) {
   this->Reload();
 }
 
-void SingleFileTab::Reload() {
-  mKind = Kind::Unknown;
-  auto delegate = FilePageSource::Create(mDXR, mKneeboard, mPath);
-  if (!delegate) {
-    this->SetDelegates({});
-    return;
+static SingleFileTab::Kind GuessKind(const std::filesystem::path& path) {
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    return SingleFileTab::Kind::Unknown;
   }
 
-  if (std::dynamic_pointer_cast<PDFFilePageSource>(delegate)) {
-    mKind = Kind::PDFFile;
-  } else if (std::dynamic_pointer_cast<PlainTextFilePageSource>(delegate)) {
-    mKind = Kind::PlainTextFile;
-  } else if (std::dynamic_pointer_cast<ImageFilePageSource>(delegate)) {
-    mKind = Kind::ImageFile;
+  const auto extension = fold_utf8(to_utf8(path.extension()));
+  if (extension == ".pdf") {
+    return SingleFileTab::Kind::PDFFile;
+  }
+  if (extension == ".txt") {
+    return SingleFileTab::Kind::PlainTextFile;
   }
+  return SingleFileTab::Kind::ImageFile;
+}
 
-  this->SetDelegates({delegate});
+void SingleFileTab::Reload() {
+  // Opening the file can be expensive (e.g. parsing a PDF's navigation), so
+  // wait until someone actually looks at the tab. Until then, guess the kind
+  // so that we can show the correct glyph.
+  mKind = GuessKind(mPath);
+  this->SetDelegatesLoader(
+    [this]() -> std::vector<std::shared_ptr<IPageSource>> {
+      mKind = Kind::Unknown;
+      auto delegate = FilePageSource::Create(mDXR, mKneeboard, mPath);
+      if (!delegate) {
+        return {};
+      }
+
+      if (std::dynamic_pointer_cast<PDFFilePageSource>(delegate)) {
+        mKind = Kind::PDFFile;
+      } else if (std::dynamic_pointer_cast<PlainTextFilePageSource>(
+                   delegate)) {
+        mKind = Kind::PlainTextFile;
+      } else if (std::dynamic_pointer_cast<ImageFilePageSource>(delegate)) {
+        mKind = Kind::ImageFile;
+      }
+      return {delegate};
+    });
 }
 
 }// namespace OpenKneeboard
@@ -86,6 +86,12 @@ void TabBase::SetBookmarks(const std::vector<Bookmark>& bookmarks) {
 }
 
 void TabBase::OnContentChanged() {
+  // Avoid fetching the page IDs if we don't need them; this would wake up
+  // hibernating tabs
+  if (mBookmarks.empty()) {
+    return;
+  }
+
   decltype(mBookmarks) bookmarks;
   const auto pageIDs = this->GetPageIDs();
   for (const auto& bookmark: mBookmarks) {
@@ -23,6 +23,9 @@
 #include <OpenKneeboard/final_release_deleter.h>
 #include <OpenKneeboard/json.h>
 
+#include <mutex>
+#include <unordered_map>
+
 #include <Psapi.h>
 #include <Shlwapi.h>
 #include <dwmapi.h>
@@ -34,8 +37,9 @@ using MatchSpecification = WindowCaptureTab::MatchSpecification;
 using TitleMatchKind = MatchSpecification::TitleMatchKind;
 
 std::mutex WindowCaptureTab::gHookMutex;
-std::map<HWINEVENTHOOK, std::weak_ptr<WindowCaptureTab>>
-  WindowCaptureTab::gHooks;
+unique_hwineventhook WindowCaptureTab::gHook;
+std::map<WindowCaptureTab*, std::weak_ptr<WindowCaptureTab>>
+  WindowCaptureTab::gWaitingTabs;
 
 OPENKNEEBOARD_DECLARE_JSON(MatchSpecification);
 
@@ -91,6 +95,15 @@ WindowCaptureTab::WindowCaptureTab(
     mSpec(settings.mSpec),
     mSendInput(settings.mSendInput),
     mCaptureOptions(settings.mCaptureOptions) {
+  this->CompileMatchSpecification();
+}
+
+void WindowCaptureTab::CompileMatchSpecification() {
+  mCompiledSpec = {
+    .mTitlePattern = std::wstring {winrt::to_hstring(mSpec.mTitle)},
+    .mExecutablePathPattern
+    = std::wstring {winrt::to_hstring(mSpec.mExecutablePathPattern)},
+  };
 }
 
 bool WindowCaptureTab::WindowMatches(HWND hwnd) {
@@ -98,9 +111,13 @@ bool WindowCaptureTab::WindowMatches(HWND hwnd) {
   if (!window) {
     return false;
   }
+  return this->WindowMatches(*window);
+}
 
+bool WindowCaptureTab::WindowMatches(const WindowSpecification& window) {
+  // Cheapest checks first
   if (mSpec.mMatchWindowClass) {
-    if (mSpec.mWindowClass != window->mWindowClass) {
+    if (mSpec.mWindowClass != window.mWindowClass) {
       return false;
     }
   }
@@ -109,14 +126,13 @@ bool WindowCaptureTab::WindowMatches(HWND hwnd) {
     case TitleMatchKind::Ignore:
       break;
     case TitleMatchKind::Exact:
-      if (mSpec.mTitle != window->mTitle) {
+      if (mSpec.mTitle != window.mTitle) {
         return false;
       }
       break;
     case TitleMatchKind::Glob: {
-      const auto title = winrt::to_hstring(window->mTitle);
-      const auto pattern = winrt::to_hstring(mSpec.mTitle);
-      if (!PathMatchSpecW(title.c_str(), pattern.c_str())) {
+      const auto title = winrt::to_hstring(window.mTitle);
+      if (!PathMatchSpecW(title.c_str(), mCompiledSpec.mTitlePattern.c_str())) {
         return false;
       }
       break;
@@ -125,25 +141,22 @@ bool WindowCaptureTab::WindowMatches(HWND hwnd) {
 
   if (mSpec.mMatchExecutable) {
     if (mSpec.mExecutableLastSeenPath == mSpec.mExecutablePathPattern) {
-      // Pattern has no wildcards
-      if (window->mExecutableLastSeenPath != mSpec.mExecutableLastSeenPath) {
+      // Pattern has no wildcards, so a direct comparison is sufficient
+      if (window.mExecutableLastSeenPath != mSpec.mExecutableLastSeenPath) {
         return false;
       }
-    }
-
-    const auto spec = winrt::to_hstring(mSpec.mExecutablePathPattern);
-    if (
+    } else if (
       PathMatchSpecExW(
-        window->mExecutableLastSeenPath.wstring().c_str(),
-        spec.c_str(),
+        window.mExecutableLastSeenPath.c_str(),
+        mCompiledSpec.mExecutablePathPattern.c_str(),
         PMSF_NORMAL | PMSF_DONT_STRIP_SPACES)
       != S_OK) {
       return false;
     }
   }
 
-  if (mSpec.mExecutableLastSeenPath != window->mExecutableLastSeenPath) {
-    mSpec.mExecutableLastSeenPath = window->mExecutableLastSeenPath;
+  if (mSpec.mExecutableLastSeenPath != window.mExecutableLastSeenPath) {
+    mSpec.mExecutableLastSeenPath = window.mExecutableLastSeenPath;
     this->evSettingsChangedEvent.Emit();
   }
 
@@ -202,10 +215,18 @@ winrt::fire_and_forget WindowCaptureTab::TryToStartCapture() {
     }
   }
 
-  // No window :( let's set a hook
+  // No window :( let's wait for one
   co_await mUIThread;
+  this->StartWaitingForWindow();
+}
+
+void WindowCaptureTab::StartWaitingForWindow() {
   const std::unique_lock lock(gHookMutex);
-  mEventHook.reset(SetWinEventHook(
+  gWaitingTabs[this] = weak_from_this();
+  if (gHook) {
+    return;
+  }
+  gHook.reset(SetWinEventHook(
     EVENT_OBJECT_CREATE,
     EVENT_OBJECT_SHOW,
     NULL,
@@ -213,15 +234,19 @@ winrt::fire_and_forget WindowCaptureTab::TryToStartCapture() {
     0,
     0,
     WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS));
-  gHooks[mEventHook.get()] = weak_from_this();
+}
+
+void WindowCaptureTab::StopWaitingForWindow() {
+  const std::unique_lock lock(gHookMutex);
+  gWaitingTabs.erase(this);
+  if (gWaitingTabs.empty()) {
+    gHook.reset();
+  }
 }
 
 WindowCaptureTab::~WindowCaptureTab() {
   this->RemoveAllEventListeners();
-  std::unique_lock lock(gHookMutex);
-  if (mEventHook) {
-    gHooks.erase(mEventHook.get());
-  }
+  this->StopWaitingForWindow();
 }
 
 winrt::fire_and_forget WindowCaptureTab::OnWindowClosed() {
@@ -278,6 +303,50 @@ WindowCaptureTab::GetTopLevelWindows() {
   return ret;
 }
 
+/* Opening the process is the most expensive part of inspecting a window, and
+ * the result can't change for the lifetime of the window; titles can, so
+ * they are always re-read.
+ *
+ * The process ID is also checked in case the HWND has been reused.
+ */
+static std::filesystem::path GetExecutablePath(HWND hwnd, DWORD processID) {
+  struct CacheEntry {
+    DWORD mProcessID {};
+    std::filesystem::path mPath;
+  };
+  static std::mutex sMutex;
+  static std::unordered_map<HWND, CacheEntry> sCache;
+
+  {
+    std::unique_lock lock(sMutex);
+    auto it = sCache.find(hwnd);
+    if (it != sCache.end() && it->second.mProcessID == processID) {
+      return it->second.mPath;
+    }
+  }
+
+  winrt::handle process {
+    OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, processID)};
+  if (!process) {
+    return {};
+  }
+
+  wchar_t pathBuf[MAX_PATH];
+  DWORD pathLen = MAX_PATH;
+  if (!QueryFullProcessImageNameW(process.get(), 0, pathBuf, &pathLen)) {
+    return {};
+  }
+  const std::filesystem::path path {std::wstring_view {pathBuf, pathLen}};
+
+  std::unique_lock lock(sMutex);
+  constexpr size_t MaxCacheEntries = 1024;
+  if (sCache.size() >= MaxCacheEntries) {
+    std::erase_if(sCache, [](const auto& it) { return !IsWindow(it.first); });
+  }
+  sCache.insert_or_assign(hwnd, CacheEntry {processID, path});
+  return path;
+}
+
 std::optional<WindowSpecification> WindowCaptureTab::GetWindowSpecification(
   HWND hwnd) {
   // Ignore the system tray etc
@@ -338,15 +407,8 @@ std::optional<WindowSpecification> WindowCaptureTab::GetWindowSpecification(
     return {};
   }
 
-  winrt::handle process {
-    OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, processID)};
-  if (!process) {
-    return {};
-  }
-
-  wchar_t pathBuf[MAX_PATH];
-  DWORD pathLen = MAX_PATH;
-  if (!QueryFullProcessImageNameW(process.get(), 0, pathBuf, &pathLen)) {
+  const auto path = GetExecutablePath(hwnd, processID);
+  if (path.empty()) {
     return {};
   }
 
@@ -355,7 +417,6 @@ std::optional<WindowSpecification> WindowCaptureTab::GetWindowSpecification(
   const auto titleLen = GetWindowTextW(hwnd, titleBuf.data(), titleBufSize);
   titleBuf.resize(std::min(titleLen, titleBufSize));
 
-  const std::filesystem::path path {std::wstring_view {pathBuf, pathLen}};
   return WindowSpecification {
     .mExecutablePathPattern = path.string(),
     .mExecutableLastSeenPath = path,
@@ -372,6 +433,7 @@ WindowCaptureTab::MatchSpecification WindowCaptureTab::GetMatchSpecification()
 
 void WindowCaptureTab::SetMatchSpecification(const MatchSpecification& spec) {
   mSpec = spec;
+  this->CompileMatchSpecification();
   this->evSettingsChangedEvent.Emit();
   if (!this->WindowMatches(mHwnd)) {
     this->Reload();
@@ -413,45 +475,59 @@ void WindowCaptureTab::SetCursorCaptureEnabled(bool value) {
   this->Reload();
 }
 
-concurrency::task<void> WindowCaptureTab::OnNewWindow(HWND hwnd) {
-  auto weak = weak_from_this();
-  if (mHwnd) {
+winrt::fire_and_forget WindowCaptureTab::OnNewWindow(
+  HWND hwnd,
+  std::vector<std::weak_ptr<WindowCaptureTab>> waitingTabs) {
+  // Inspect the window once, no matter how many tabs are waiting
+  auto window = GetWindowSpecification(hwnd);
+  std::erase_if(waitingTabs, [hwnd, &window](const auto& weak) {
+    auto tab = weak.lock();
+    if (!tab) {
+      return true;
+    }
+    if (window && tab->WindowMatches(*window)) {
+      tab->OnMatchingWindow(hwnd);
+      return true;
+    }
+    return false;
+  });
+  if (waitingTabs.empty()) {
     co_return;
   }
 
-  {
-    const auto desktop = GetDesktopWindow();
-    HWND parent {};
-    while ((parent = GetParent(hwnd)) && parent != desktop) {
-      hwnd = parent;
-    }
+  // Give new windows (especially UWP) a chance to settle before checking
+  // again if they match
+  co_await winrt::resume_after(std::chrono::seconds(1));
+  window = GetWindowSpecification(hwnd);
+  if (!window) {
+    co_return;
   }
-
-  if (!this->WindowMatches(hwnd)) {
-    // Give new windows (especially UWP) a chance to settle before checking
-    // if they match
-    co_await winrt::resume_after(std::chrono::seconds(1));
-    auto self = weak.lock();
-    if (!self) {
-      co_return;
-    }
-    if (!this->WindowMatches(hwnd)) {
-      co_return;
+  for (const auto& weak: waitingTabs) {
+    auto tab = weak.lock();
+    if (tab && tab->WindowMatches(*window)) {
+      tab->OnMatchingWindow(hwnd);
     }
   }
+}
 
-  if (!co_await this->TryToStartCapture(hwnd)) {
+winrt::fire_and_forget WindowCaptureTab::OnMatchingWindow(HWND hwnd) {
+  auto weak = weak_from_this();
+  co_await mUIThread;
+  auto self = weak.lock();
+  if (!self) {
+    co_return;
+  }
+  if (mHwnd) {
     co_return;
   }
 
-  auto self = weak.lock();
-  if (!self) {
+  if (!co_await this->TryToStartCapture(hwnd)) {
     co_return;
   }
 
-  const std::unique_lock lock(gHookMutex);
-  gHooks.erase(mEventHook.get());
-  mEventHook.reset();
+  // The hook must be removed from the thread that installed it
+  co_await mUIThread;
+  this->StopWaitingForWindow();
 }
 
 void WindowCaptureTab::WinEventProc_NewWindowHook(
@@ -472,24 +548,29 @@ void WindowCaptureTab::WinEventProc_NewWindowHook(
     return;
   }
 
-  std::shared_ptr<WindowCaptureTab> instance;
+  std::vector<std::weak_ptr<WindowCaptureTab>> tabs;
   {
     std::unique_lock lock(gHookMutex);
-    auto it = gHooks.find(hook);
-    if (it == gHooks.end()) {
+    if (hook != gHook.get()) {
       return;
     }
-    instance = it->second.lock();
-    if (!instance) {
-      return;
+    for (const auto& [_, weak]: gWaitingTabs) {
+      tabs.push_back(weak);
     }
   }
+  if (tabs.empty()) {
+    return;
+  }
 
-  [](auto hwnd, auto weak) -> winrt::fire_and_forget {
-    if (auto instance = weak.lock()) {
-      co_await instance->OnNewWindow(hwnd);
+  {
+    const auto desktop = GetDesktopWindow();
+    HWND parent {};
+    while ((parent = GetParent(hwnd)) && parent != desktop) {
+      hwnd = parent;
     }
-  }(hwnd, std::weak_ptr(instance));
+  }
+
+  OnNewWindow(hwnd, std::move(tabs));
 }
 
 NLOHMANN_JSON_SERIALIZE_ENUM(
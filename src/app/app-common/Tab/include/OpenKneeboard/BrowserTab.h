@@ -50,6 +50,8 @@ class BrowserTab final : public TabBase,
   static std::string GetStaticGlyph();
 
   virtual void Reload() final override;
+  /// Hibernating would lose the page's state, e.g. history and logins
+  virtual bool CanHibernate() const override;
 
   struct Settings : WebView2PageSource::Settings {
     constexpr bool operator==(const Settings&) const noexcept = default;
@@ -71,8 +73,6 @@ class BrowserTab final : public TabBase,
   audited_ptr<DXResources> mDXR;
   KneeboardState* mKneeboard {nullptr};
   Settings mSettings;
-
-  std::shared_ptr<WebView2PageSource> mDelegate;
 };
 
 OPENKNEEBOARD_DECLARE_SPARSE_JSON(BrowserTab::Settings);
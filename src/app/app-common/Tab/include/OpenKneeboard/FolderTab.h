@@ -64,7 +64,9 @@ class FolderTab final : public TabBase,
     std::string_view title,
     const std::filesystem::path& path);
 
-  std::shared_ptr<FolderPageSource> mPageSource;
+  audited_ptr<DXResources> mDXR;
+  KneeboardState* mKneeboard {nullptr};
+  std::weak_ptr<FolderPageSource> mPageSource;
   std::filesystem::path mPath;
 };
 
@@ -71,6 +71,9 @@ class NavigationTab final : public TabBase,
   PixelSize mPreferredSize;
   std::unordered_map<RenderTargetID, std::unique_ptr<CachedLayer>>
     mPreviewCache;
+  /// Each render target has its own cache, which only needs the current page
+  static constexpr size_t PreviewCacheMaxBytes = MaxViewRenderSize.mWidth
+    * MaxViewRenderSize.mHeight * sizeof(uint32_t);
 
   uint16_t mRenderColumns;
 
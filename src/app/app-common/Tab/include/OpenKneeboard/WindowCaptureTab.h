@@ -115,6 +115,14 @@ class WindowCaptureTab final
   winrt::fire_and_forget TryToStartCapture();
   concurrency::task<bool> TryToStartCapture(HWND hwnd);
   bool WindowMatches(HWND hwnd);
+  bool WindowMatches(const WindowSpecification&);
+
+  // `mSpec`'s patterns, pre-converted for `PathMatchSpec*W()`
+  struct CompiledMatchSpecification {
+    std::wstring mTitlePattern;
+    std::wstring mExecutablePathPattern;
+  };
+  void CompileMatchSpecification();
 
   winrt::fire_and_forget OnWindowClosed();
 
@@ -126,20 +134,31 @@ class WindowCaptureTab final
     LONG idChild,
     DWORD idEventThread,
     DWORD dwmsEventTime);
-  concurrency::task<void> OnNewWindow(HWND hwnd);
+  static winrt::fire_and_forget OnNewWindow(
+    HWND hwnd,
+    std::vector<std::weak_ptr<WindowCaptureTab>> waitingTabs);
+  winrt::fire_and_forget OnMatchingWindow(HWND hwnd);
+
+  // Must be called from the UI thread
+  void StartWaitingForWindow();
+  void StopWaitingForWindow();
 
   winrt::apartment_context mUIThread;
   audited_ptr<DXResources> mDXR;
   KneeboardState* mKneeboard {nullptr};
   MatchSpecification mSpec;
+  CompiledMatchSpecification mCompiledSpec;
   bool mSendInput = false;
   HWND mHwnd {};
   HWNDPageSource::Options mCaptureOptions {};
   std::shared_ptr<HWNDPageSource> mDelegate;
 
-  unique_hwineventhook mEventHook;
+  // A single hook is shared by all tabs that are waiting for a window, so
+  // each new window is only inspected once, instead of once per tab
   static std::mutex gHookMutex;
-  static std::map<HWINEVENTHOOK, std::weak_ptr<WindowCaptureTab>> gHooks;
+  static unique_hwineventhook gHook;
+  static std::map<WindowCaptureTab*, std::weak_ptr<WindowCaptureTab>>
+    gWaitingTabs;
 };
 
 }// namespace OpenKneeboard
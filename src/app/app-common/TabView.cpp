@@ -19,6 +19,7 @@
  */
 #include <OpenKneeboard/CursorEvent.h>
 #include <OpenKneeboard/IPageSourceWithCursorEvents.h>
+#include <OpenKneeboard/IPageSourceWithHibernation.h>
 #include <OpenKneeboard/IPageSourceWithNavigation.h>
 #include <OpenKneeboard/ITab.h>
 #include <OpenKneeboard/KneeboardState.h>
@@ -29,6 +30,8 @@
 #include <OpenKneeboard/dprint.h>
 #include <OpenKneeboard/scope_guard.h>
 
+#include <algorithm>
+
 namespace OpenKneeboard {
 
 TabView::TabView(
@@ -36,11 +39,6 @@ TabView::TabView(
   KneeboardState* kneeboard,
   const std::shared_ptr<ITab>& tab)
   : mDXR(dxr), mKneeboard(kneeboard), mRootTab(tab) {
-  const auto rootPageIDs = mRootTab->GetPageIDs();
-  if (!rootPageIDs.empty()) {
-    mRootTabPage = {rootPageIDs.front(), 0};
-  }
-
   AddEventListener(tab->evNeedsRepaintEvent, this->evNeedsRepaintEvent);
   AddEventListener(
     tab->evContentChangedEvent,
@@ -76,6 +74,7 @@ std::shared_ptr<ITab> TabView::GetTab() const {
 }
 
 PageID TabView::GetPageID() const {
+  this->RestoreRootTabPage();
   const auto mode = this->GetTabMode();
   if (mode != TabMode::Normal && mActiveSubTabPageID) {
     return *mActiveSubTabPageID;
@@ -113,17 +112,19 @@ void TabView::PostCursorEvent(const CursorEvent& ev) {
 }
 
 void TabView::SetPageID(PageID page) {
-  const auto tab = this->GetTab();
-  const auto pages = tab->GetPageIDs();
-  const auto it = std::ranges::find(pages, page);
-  if (it == pages.end()) {
-    return;
-  }
-
   if (mActiveSubTab) {
+    const auto pages = mActiveSubTab->GetPageIDs();
+    if (std::ranges::find(pages, page) == pages.end()) {
+      return;
+    }
     mActiveSubTabPageID = page;
   } else {
-    mRootTabPage = {page, static_cast<PageIndex>(it - pages.begin())};
+    this->RestoreRootTabPage();
+    const auto index = mRootTabPageIDs.GetIndex(page);
+    if (!index) {
+      return;
+    }
+    mRootTabPage = {page, *index};
   }
 
   this->PostCursorEvent({});
@@ -140,19 +141,29 @@ void TabView::OnTabContentChanged() {
     }
   });
 
-  const auto pages = mRootTab->GetPageIDs();
-  if (pages.empty()) {
-    mRootTabPage = {};
-    evPageChangedEvent.Emit();
+  mRootTabPageIDsStale = true;
+  if (this->IsRootTabHibernating()) {
+    // The page IDs will change when the tab wakes up, so remember the index
+    if (mRootTabPage) {
+      mRootTabPage->mID = PageID(nullptr);
+    }
     return;
   }
 
-  if (mRootTabPage) {
-    const auto it = std::ranges::find(pages, mRootTabPage->mID);
-    if (it == pages.end()) {
-      // Fixed below
+  this->RestoreRootTabPage();
+  const auto pages = mRootTabPageIDs.GetPageIDs();
+  if (pages.empty()) {
+    // Keep any page we're waiting to restore; the tab might still be loading
+    if (mRootTabPage && mRootTabPage->mID) {
       mRootTabPage = {};
     }
+    evPageChangedEvent.Emit();
+    return;
+  }
+
+  if (mRootTabPage && !mRootTabPageIDs.Contains(mRootTabPage->mID)) {
+    // Fixed below
+    mRootTabPage = {};
   }
 
   if (!mRootTabPage) {
@@ -161,22 +172,50 @@ void TabView::OnTabContentChanged() {
     return;
   }
 
-  const auto it = std::ranges::find(pages, mRootTabPage->mID);
-  if (it == pages.end()) {
-    mRootTabPage = {pages.back(), static_cast<PageIndex>(pages.size() - 1)};
+  const auto index = mRootTabPageIDs.GetIndex(mRootTabPage->mID);
+  if (mRootTabPage->mIndex == 0 && index != 0) {
+    mRootTabPage->mID = pages.front();
     evPageChangedEvent.Emit();
     return;
   }
+}
 
-  if (mRootTabPage->mIndex == 0 && it != pages.begin()) {
-    mRootTabPage->mID = pages.front();
-    evPageChangedEvent.Emit();
+void TabView::UpdateRootTabPageIDs() const {
+  if (!mRootTabPageIDsStale) {
+    return;
+  }
+  mRootTabPageIDsStale = false;
+  mRootTabPageIDs.Assign(mRootTab->GetPageIDs());
+}
+
+void TabView::RestoreRootTabPage() const {
+  this->UpdateRootTabPageIDs();
+  if (!(mRootTabPage && !mRootTabPage->mID)) {
+    return;
+  }
+
+  const auto pages = mRootTabPageIDs.GetPageIDs();
+  if (pages.empty()) {
+    // Probably still loading after waking up; keep the index until the pages
+    // arrive via `OnTabContentChanged()` or `OnTabPageAppended()`
     return;
   }
+
+  const auto index = std::min<PageIndex>(
+    mRootTabPage->mIndex, static_cast<PageIndex>(pages.size() - 1));
+  mRootTabPage = {pages[index], index};
+}
+
+bool TabView::IsRootTabHibernating() const {
+  const auto hibernatable
+    = std::dynamic_pointer_cast<IPageSourceWithHibernation>(mRootTab);
+  return hibernatable && hibernatable->IsHibernating();
 }
 
 void TabView::OnTabPageAppended(SuggestedPageAppendAction suggestedAction) {
-  auto pages = mRootTab->GetPageIDs();
+  mRootTabPageIDsStale = true;
+  this->RestoreRootTabPage();
+  const auto pages = mRootTabPageIDs.GetPageIDs();
   if (pages.size() < 2 || !mRootTabPage) {
     mRootTabPage = {pages.front(), 0};
     evPageChangedEvent.Emit();
@@ -259,12 +298,12 @@ bool TabView::SetTabMode(TabMode mode) {
           if (ctx != mEventContext) {
             return;
           }
-          const auto ids = mRootTab->GetPageIDs();
-          const auto it = std::ranges::find(ids, newPage);
-          if (it == ids.end()) {
+          this->UpdateRootTabPageIDs();
+          const auto index = mRootTabPageIDs.GetIndex(newPage);
+          if (!index) {
             return;
           }
-          mRootTabPage = {newPage, static_cast<PageIndex>(it - ids.begin())};
+          mRootTabPage = {newPage, *index};
           SetTabMode(TabMode::Normal);
         });
       AddEventListener(
@@ -22,6 +22,7 @@
 #include <OpenKneeboard/DCSRadioLogTab.h>
 #include <OpenKneeboard/DCSTerrainTab.h>
 #include <OpenKneeboard/Filesystem.h>
+#include <OpenKneeboard/IPageSourceWithHibernation.h>
 #include <OpenKneeboard/KneeboardState.h>
 #include <OpenKneeboard/RuntimeFiles.h>
 #include <OpenKneeboard/TabTypes.h>
@@ -33,6 +34,8 @@
 #include <shims/nlohmann/json.hpp>
 
 #include <algorithm>
+#include <optional>
+#include <tuple>
 
 namespace OpenKneeboard {
 
@@ -58,6 +61,36 @@ static std::tuple<std::string, nlohmann::json> MigrateTab(
   return {type, settings};
 }
 
+static std::optional<nlohmann::json> GetTabSettings(
+  const std::shared_ptr<ITab>& tab) {
+  std::string type;
+#define IT(_, it) \
+  if (type.empty() && std::dynamic_pointer_cast<it##Tab>(tab)) { \
+    type = #it; \
+  }
+  OPENKNEEBOARD_TAB_TYPES
+#undef IT
+  if (type.empty()) {
+    dprintf("Unknown type for tab {}", tab->GetTitle());
+    return std::nullopt;
+  }
+
+  nlohmann::json savedTab {
+    {"Type", type},
+    {"Title", tab->GetTitle()},
+    {"ID", winrt::to_string(winrt::to_hstring(tab->GetPersistentID()))},
+  };
+
+  auto withSettings = std::dynamic_pointer_cast<ITabWithSettings>(tab);
+  if (withSettings) {
+    auto settings = withSettings->GetSettings();
+    if (!settings.is_null()) {
+      savedTab.emplace("Settings", settings);
+    }
+  }
+  return savedTab;
+}
+
 void TabsList::LoadSettings(const nlohmann::json& config) {
   if (config.is_null()) {
     LoadDefaultSettings();
@@ -65,6 +98,15 @@ void TabsList::LoadSettings(const nlohmann::json& config) {
   }
   std::vector<nlohmann::json> jsonTabs = config;
 
+  // Keep tabs that are unchanged, e.g. when switching between profiles with
+  // the same tabs; this keeps their state, and avoids reloading them
+  std::vector<std::tuple<nlohmann::json, std::shared_ptr<ITab>>> reusable;
+  for (const auto& tab: mTabs) {
+    if (auto settings = GetTabSettings(tab)) {
+      reusable.push_back({std::move(*settings), tab});
+    }
+  }
+
   decltype(mTabs) tabs;
   for (const auto& tab: jsonTabs) {
     if (!(tab.contains("Type") && tab.contains("Title"))) {
@@ -87,6 +129,26 @@ void TabsList::LoadSettings(const nlohmann::json& config) {
       // else handled by TabBase
     }
 
+    if (persistentID != winrt::guid {} && !reusable.empty()) {
+      nlohmann::json normalized {
+        {"Type", type},
+        {"Title", title},
+        {"ID", winrt::to_string(winrt::to_hstring(persistentID))},
+      };
+      if (!settings.is_null()) {
+        normalized.emplace("Settings", settings);
+      }
+      const auto it
+        = std::ranges::find_if(reusable, [&normalized](const auto& candidate) {
+            return std::get<0>(candidate) == normalized;
+          });
+      if (it != reusable.end()) {
+        tabs.push_back(std::get<1>(*it));
+        reusable.erase(it);
+        continue;
+      }
+    }
+
 #define IT(_, it) \
   if (type == #it) { \
     auto instance \
@@ -122,33 +184,9 @@ nlohmann::json TabsList::GetSettings() const {
   std::vector<nlohmann::json> ret;
 
   for (const auto& tab: mTabs) {
-    std::string type;
-#define IT(_, it) \
-  if (type.empty() && std::dynamic_pointer_cast<it##Tab>(tab)) { \
-    type = #it; \
-  }
-    OPENKNEEBOARD_TAB_TYPES
-#undef IT
-    if (type.empty()) {
-      dprintf("Unknown type for tab {}", tab->GetTitle());
-      continue;
-    }
-
-    nlohmann::json savedTab {
-      {"Type", type},
-      {"Title", tab->GetTitle()},
-      {"ID", winrt::to_string(winrt::to_hstring(tab->GetPersistentID()))},
-    };
-
-    auto withSettings = std::dynamic_pointer_cast<ITabWithSettings>(tab);
-    if (withSettings) {
-      auto settings = withSettings->GetSettings();
-      if (!settings.is_null()) {
-        savedTab.emplace("Settings", settings);
-      }
+    if (auto savedTab = GetTabSettings(tab)) {
+      ret.push_back(std::move(*savedTab));
     }
-    ret.push_back(savedTab);
-    continue;
   }
 
   return ret;
@@ -177,6 +215,50 @@ void TabsList::SetTabs(const std::vector<std::shared_ptr<ITab>>& tabs) {
   evSettingsChangedEvent.Emit();
 }
 
+void TabsList::SetActiveTabs(
+  const std::vector<std::shared_ptr<ITab>>& activeTabs) {
+  for (const auto& tab: activeTabs) {
+    if (!tab) {
+      continue;
+    }
+    const auto id = tab->GetRuntimeID();
+    std::erase(mRecentlyActiveTabs, id);
+    mRecentlyActiveTabs.insert(mRecentlyActiveTabs.begin(), id);
+  }
+  std::erase_if(mRecentlyActiveTabs, [this](const auto& id) {
+    return std::ranges::find(mTabs, id, &ITab::GetRuntimeID) == mTabs.end();
+  });
+
+  // Tabs that have never been active are treated as the least recently used;
+  // they might have been loaded to e.g. look up a page by number
+  auto tabs = mTabs;
+  std::ranges::stable_sort(tabs, {}, [this](const auto& tab) {
+    return std::ranges::find(mRecentlyActiveTabs, tab->GetRuntimeID())
+      - mRecentlyActiveTabs.begin();
+  });
+
+  size_t awake = 0;
+  for (const auto& tab: tabs) {
+    const auto hibernatable
+      = std::dynamic_pointer_cast<IPageSourceWithHibernation>(tab);
+    if (!hibernatable || hibernatable->IsHibernating()) {
+      continue;
+    }
+    if (
+      ++awake <= MaxAwakeTabs
+      || std::ranges::find(activeTabs, tab) != activeTabs.end()) {
+      continue;
+    }
+    // Bookmarks refer to page IDs, which change when the tab wakes up
+    if (!(tab->GetBookmarks().empty() && hibernatable->CanHibernate())) {
+      continue;
+    }
+
+    dprintf("Hibernating tab '{}'", tab->GetTitle());
+    hibernatable->Hibernate();
+  }
+}
+
 void TabsList::InsertTab(TabIndex index, const std::shared_ptr<ITab>& tab) {
   auto tabs = mTabs;
   tabs.insert(tabs.begin() + index, tab);
@@ -47,6 +47,20 @@ class TabsList final : private EventReceiver {
   nlohmann::json GetSettings() const;
   void LoadSettings(const nlohmann::json&);
 
+  /** Hibernate tabs that haven't been shown recently.
+   *
+   * `activeTabs` are the tabs that are currently shown in any view; they're
+   * never hibernated.
+   */
+  void SetActiveTabs(const std::vector<std::shared_ptr<ITab>>& activeTabs);
+
+  /** How many hibernatable tabs to keep loaded.
+   *
+   * This is a count rather than a memory budget, as most of the memory is
+   * owned by D3D, WebView2, or PDFium, and can't be measured per-tab.
+   */
+  static constexpr size_t MaxAwakeTabs = 8;
+
   Event<> evSettingsChangedEvent;
   Event<std::vector<std::shared_ptr<ITab>>> evTabsChangedEvent;
 
@@ -55,6 +69,8 @@ class TabsList final : private EventReceiver {
   KneeboardState* mKneeboard;
   std::vector<std::shared_ptr<ITab>> mTabs;
   std::vector<EventHandlerToken> mTabEvents;
+  // Most recent first
+  std::vector<ITab::RuntimeID> mRecentlyActiveTabs;
 
   void LoadDefaultSettings();
 };
@@ -26,7 +26,11 @@
 #include <OpenKneeboard/dprint.h>
 #include <OpenKneeboard/version.h>
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
+
+#include <zlib.h>
 
 namespace OpenKneeboard {
 
@@ -60,7 +64,12 @@ class TroubleshootingStore::DPrintReceiver final
   void OnMessage(const DPrintMessage& message) override;
 
  private:
-  std::vector<DPrintEntry> mMessages;
+  // Bounded: once there are `MaxChunks`, the oldest chunk is discarded
+  static constexpr size_t ChunkSize = 1024;
+  static constexpr size_t MaxChunks = 64;
+
+  using Chunk = std::vector<DPrintEntry>;
+  std::deque<Chunk> mChunks;
   std::recursive_mutex mMutex;
 };
 
@@ -79,27 +88,59 @@ TroubleshootingStore::TroubleshootingStore() {
   dprintf("{}()", __FUNCTION__);
 }
 
-void TroubleshootingStore::InitializeLogFile() {
-  DWORD maxLogFiles = 0;
+static DWORD GetRegistryDWORD(const wchar_t* name, DWORD defaultValue) {
   for (auto hkey: {HKEY_CURRENT_USER, HKEY_LOCAL_MACHINE}) {
-    DWORD size = sizeof(maxLogFiles);
+    DWORD value = 0;
+    DWORD size = sizeof(value);
     if (
       RegGetValueW(
-        hkey,
-        RegistrySubKey,
-        L"MaxLogFiles",
-        RRF_RT_REG_DWORD,
-        nullptr,
-        &maxLogFiles,
-        &size)
+        hkey, RegistrySubKey, name, RRF_RT_REG_DWORD, nullptr, &value, &size)
       == ERROR_SUCCESS) {
-      break;
+      return value;
     }
   }
+  return defaultValue;
+}
+
+static bool CompressLogFile(
+  const std::filesystem::path& source,
+  const std::filesystem::path& destination) {
+  std::ifstream in(source, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  auto out = gzopen_w(destination.c_str(), "wb");
+  if (!out) {
+    return false;
+  }
 
+  std::vector<char> buffer(64 * 1024);
+  bool ok = true;
+  while (ok && in) {
+    in.read(buffer.data(), buffer.size());
+    const auto count = static_cast<unsigned int>(in.gcount());
+    if (count > 0 && gzwrite(out, buffer.data(), count) != count) {
+      ok = false;
+    }
+  }
+  if (gzclose(out) != Z_OK) {
+    ok = false;
+  }
+
+  if (!ok) {
+    std::error_code ec;
+    std::filesystem::remove(destination, ec);
+  }
+  return ok;
+}
+
+void TroubleshootingStore::InitializeLogFile() {
+  const auto maxLogFiles = GetRegistryDWORD(L"MaxLogFiles", 0);
   if (maxLogFiles == 0) {
     return;
   }
+  const uint64_t maxLogBytes
+    = GetRegistryDWORD(L"MaxLogBytes", 64 * 1024 * 1024);
 
   const auto directory = Filesystem::GetSettingsDirectory() / "logs";
   std::filesystem::create_directories(directory);
@@ -127,15 +168,57 @@ void TroubleshootingStore::InitializeLogFile() {
     this->evDPrintMessageReceived,
     std::bind_front(&TroubleshootingStore::WriteDPrintMessageToLogFile, this));
 
-  if (existingFiles.size() < maxLogFiles) {
+  if (existingFiles.empty()) {
     return;
   }
-  const auto toDelete = std::vector<std::filesystem::path> {
-    existingFiles.begin(),
-    existingFiles.begin() + (existingFiles.size() + 1 - maxLogFiles)};
-  for (const auto& it: toDelete) {
-    dprintf("Deleting stale log file {}", it.string());
-    std::filesystem::remove(it);
+  mLogRotationThread = std::jthread {
+    [=, files = std::move(existingFiles)](std::stop_token stopToken) {
+      SetThreadDescription(
+        GetCurrentThread(), L"TroubleshootingStore RotateLogFiles");
+      RotateLogFiles(stopToken, files, maxLogFiles, maxLogBytes);
+    }};
+}
+
+void TroubleshootingStore::RotateLogFiles(
+  std::stop_token stopToken,
+  std::vector<std::filesystem::path> existingFiles,
+  size_t maxLogFiles,
+  uint64_t maxLogBytes) {
+  // Logs from previous sessions are never written to again, so compress
+  // them; they're mostly repeated text, so this usually saves ~90%.
+  for (auto& path: existingFiles) {
+    if (stopToken.stop_requested()) {
+      return;
+    }
+    if (path.extension() != ".log") {
+      continue;
+    }
+    auto compressed = path;
+    compressed += ".gz";
+    if (!CompressLogFile(path, compressed)) {
+      dprintf("Failed to compress log file {}", path.string());
+      continue;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    path = compressed;
+  }
+
+  // Keep the newest files that fit in the budget, leaving room for the
+  // current log file
+  size_t keptFiles = 1;
+  uint64_t keptBytes = 0;
+  for (auto it = existingFiles.rbegin(); it != existingFiles.rend(); ++it) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(*it, ec);
+    if (
+      (!ec) && keptFiles < maxLogFiles && keptBytes + size <= maxLogBytes) {
+      ++keptFiles;
+      keptBytes += size;
+      continue;
+    }
+    dprintf("Deleting stale log file {}", it->string());
+    std::filesystem::remove(*it, ec);
   }
 }
 
@@ -197,7 +280,12 @@ TroubleshootingStore::DPrintReceiver::~DPrintReceiver() {
 std::vector<TroubleshootingStore::DPrintEntry>
 TroubleshootingStore::DPrintReceiver::GetMessages() {
   std::unique_lock lock(mMutex);
-  return mMessages;
+  std::vector<DPrintEntry> ret;
+  ret.reserve(mChunks.size() * ChunkSize);
+  for (const auto& chunk: mChunks) {
+    ret.insert(ret.end(), chunk.begin(), chunk.end());
+  }
+  return ret;
 }
 
 std::vector<TroubleshootingStore::DPrintEntry>
@@ -216,7 +304,13 @@ void TroubleshootingStore::DPrintReceiver::OnMessage(
   };
   {
     std::unique_lock lock(mMutex);
-    mMessages.push_back(entry);
+    if (mChunks.empty() || mChunks.back().size() >= ChunkSize) {
+      if (mChunks.size() >= MaxChunks) {
+        mChunks.pop_front();
+      }
+      mChunks.emplace_back().reserve(ChunkSize);
+    }
+    mChunks.back().push_back(entry);
   }
   evMessageReceived.Emit(entry);
 }
@@ -23,6 +23,13 @@
 
 #include <OpenKneeboard/scope_guard.h>
 
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <utility>
+
+#include <emmintrin.h>
+
 namespace OpenKneeboard {
 
 DirectInputJoystickListener::DirectInputJoystickListener(
@@ -34,29 +41,159 @@ DirectInputJoystickListener::DirectInputJoystickListener(
 
 DirectInputJoystickListener::~DirectInputJoystickListener() = default;
 
+namespace {
+
+// Equivalent to c_dfDIJoystick2, but only the hats and buttons
+DIDATAFORMAT* GetButtonsAndHatsDataFormat() {
+  constexpr size_t hatCount = 4;
+  constexpr size_t buttonCount = 128;
+  constexpr auto buttonsOffset = hatCount * sizeof(DWORD);
+
+  static auto sObjects = []() {
+    std::array<DIOBJECTDATAFORMAT, hatCount + buttonCount> ret {};
+    for (size_t i = 0; i < hatCount; ++i) {
+      ret[i] = {
+        &GUID_POV,
+        static_cast<DWORD>(i * sizeof(DWORD)),
+        DIDFT_POV | DIDFT_ANYINSTANCE | DIDFT_OPTIONAL,
+        0,
+      };
+    }
+    for (size_t i = 0; i < buttonCount; ++i) {
+      ret[hatCount + i] = {
+        nullptr,
+        static_cast<DWORD>(buttonsOffset + i),
+        DIDFT_BUTTON | DIDFT_ANYINSTANCE | DIDFT_OPTIONAL,
+        0,
+      };
+    }
+    return ret;
+  }();
+
+  static DIDATAFORMAT sFormat {
+    .dwSize = sizeof(DIDATAFORMAT),
+    .dwObjSize = sizeof(DIOBJECTDATAFORMAT),
+    .dwFlags = DIDF_ABSAXIS,
+    .dwDataSize = static_cast<DWORD>(buttonsOffset + buttonCount),
+    .dwNumObjs = static_cast<DWORD>(sObjects.size()),
+    .rgodf = sObjects.data(),
+  };
+  return &sFormat;
+}
+
+}// namespace
+
 void DirectInputJoystickListener::Poll() {
+  if (mIsBuffered && this->PollBuffered()) {
+    return;
+  }
+  this->PollState();
+}
+
+bool DirectInputJoystickListener::PollBuffered() {
+  const auto di = this->GetDIDevice();
+  std::array<DIDEVICEOBJECTDATA, BufferSize> data;
+  while (true) {
+    DWORD count = static_cast<DWORD>(data.size());
+    const auto result
+      = di->GetDeviceData(sizeof(data[0]), data.data(), &count, 0);
+    if (result == DI_BUFFEROVERFLOW) {
+      return false;
+    }
+    winrt::check_hresult(result);
+
+    // Already in sequence order
+    for (DWORD i = 0; i < count; ++i) {
+      this->OnObjectData(data[i]);
+    }
+
+    if (count < data.size()) {
+      return true;
+    }
+  }
+}
+
+void DirectInputJoystickListener::OnObjectData(
+  const DIDEVICEOBJECTDATA& data) {
+  auto device = this->GetDevice();
+  constexpr auto buttonsOffset = offsetof(State, mButtons);
+
+  if (data.dwOfs >= buttonsOffset) {
+    const auto i = data.dwOfs - buttonsOffset;
+    if (i >= std::size(mState.mButtons)) {
+      return;
+    }
+    const auto value = static_cast<BYTE>(data.dwData);
+    if (mState.mButtons[i] == value) {
+      return;
+    }
+    mState.mButtons[i] = value;
+    device->PostButtonStateChange(
+      static_cast<uint8_t>(i), static_cast<bool>(value & (1 << 7)));
+    return;
+  }
+
+  const auto i = data.dwOfs / sizeof(DWORD);
+  if (i >= std::size(mState.mHats)) {
+    return;
+  }
+  const auto previous = std::exchange(mState.mHats[i], data.dwData);
+  if (previous != data.dwData) {
+    device->PostHatStateChange(static_cast<uint8_t>(i), previous, data.dwData);
+  }
+}
+
+void DirectInputJoystickListener::PollState() {
   decltype(mState) newState {};
   this->GetState(sizeof(mState), &newState);
   scope_guard updateState([&]() { mState = newState; });
 
   auto device = this->GetDevice();
-  for (uint8_t i = 0; i < sizeof(mState.rgbButtons); ++i) {
-    if (mState.rgbButtons[i] != newState.rgbButtons[i]) {
+
+  // Compare 16 buttons at a time, then only look at the ones that changed
+  static_assert(sizeof(mState.mButtons) % sizeof(__m128i) == 0);
+  for (size_t chunk = 0; chunk < sizeof(mState.mButtons);
+       chunk += sizeof(__m128i)) {
+    const auto before = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(&mState.mButtons[chunk]));
+    const auto after = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(&newState.mButtons[chunk]));
+    auto changed = static_cast<uint32_t>(
+      ~_mm_movemask_epi8(_mm_cmpeq_epi8(before, after)) & 0xffff);
+    while (changed) {
+      const auto i = chunk + std::countr_zero(changed);
+      changed &= changed - 1;
       device->PostButtonStateChange(
-        i, static_cast<bool>(newState.rgbButtons[i] & (1 << 7)));
+        static_cast<uint8_t>(i),
+        static_cast<bool>(newState.mButtons[i] & (1 << 7)));
     }
   }
 
-  constexpr auto maxHats = sizeof(mState.rgdwPOV) / sizeof(mState.rgdwPOV[0]);
+  constexpr auto maxHats = std::size(mState.mHats);
   for (uint8_t i = 0; i < maxHats; ++i) {
-    if (mState.rgdwPOV[i] != newState.rgdwPOV[i]) {
-      device->PostHatStateChange(i, mState.rgdwPOV[i], newState.rgdwPOV[i]);
+    if (mState.mHats[i] != newState.mHats[i]) {
+      device->PostHatStateChange(i, mState.mHats[i], newState.mHats[i]);
     }
   }
 }
 
 void DirectInputJoystickListener::SetDataFormat() noexcept {
-  this->GetDIDevice()->SetDataFormat(&c_dfDIJoystick2);
+  static_assert(offsetof(State, mButtons) == sizeof(State::mHats));
+  static_assert(sizeof(State) == sizeof(DWORD[4]) + 128);
+
+  auto di = this->GetDIDevice();
+  di->SetDataFormat(GetButtonsAndHatsDataFormat());
+
+  DIPROPDWORD bufferSize {
+    .diph = {
+      .dwSize = sizeof(DIPROPDWORD),
+      .dwHeaderSize = sizeof(DIPROPHEADER),
+      .dwObj = 0,
+      .dwHow = DIPH_DEVICE,
+    },
+    .dwData = BufferSize,
+  };
+  mIsBuffered = SUCCEEDED(di->SetProperty(DIPROP_BUFFERSIZE, &bufferSize.diph));
 }
 
 void DirectInputJoystickListener::OnAcquired() noexcept {
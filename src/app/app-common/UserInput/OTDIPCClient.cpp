@@ -27,6 +27,7 @@
 #include <wil/cppwinrt.h>
 #include <wil/cppwinrt_helpers.h>
 
+#include <algorithm>
 #include <ranges>
 
 #include <OTD-IPC/DeviceInfo.h>
@@ -38,6 +39,11 @@ using namespace OTDIPC::Messages;
 
 namespace OpenKneeboard {
 
+static std::string MakeDeviceID(const Header* const header) {
+  return std::format(
+    "otdipc-vidpid:///{:04x}/{:04x}", header->vid, header->pid);
+}
+
 std::shared_ptr<OTDIPCClient> OTDIPCClient::Create() {
   auto ret = shared_with_final_release(new OTDIPCClient());
   ret->mRunner = ret->Run();
@@ -88,8 +94,6 @@ winrt::Windows::Foundation::IAsyncAction OTDIPCClient::Run() {
 }
 
 void OTDIPCClient::TimeoutTablet(const std::string& id) {
-  mTabletsToTimeout.erase(id);
-
   auto it = mTablets.find(id);
   if (it == mTablets.end()) {
     return;
@@ -127,10 +131,14 @@ winrt::Windows::Foundation::IAsyncAction OTDIPCClient::RunSingle() {
   OVERLAPPED overlapped {.hEvent = event.get()};
 
   char buffer[1024];
+  // May contain several messages, and/or a partial message
+  std::string received;
   using namespace OTDIPC::Messages;
-  auto header = reinterpret_cast<const Header* const>(buffer);
-  static_assert(sizeof(buffer) >= sizeof(DeviceInfo));
-  static_assert(sizeof(buffer) >= sizeof(State));
+  static_assert(sizeof(buffer) >= sizeof(Header));
+  // Larger than any message we understand; anything bigger is a corrupt or
+  // hostile stream, and shouldn't make us buffer an arbitrary amount
+  constexpr size_t MaxMessageSize = 4096;
+  static_assert(MaxMessageSize >= std::max(sizeof(DeviceInfo), sizeof(State)));
 
   while (true) {
     if (mStopper.stop_requested()) {
@@ -143,39 +151,42 @@ winrt::Windows::Foundation::IAsyncAction OTDIPCClient::RunSingle() {
     const auto readFileSuccess = ReadFile(
       connection.get(), buffer, sizeof(buffer), &bytesRead, &overlapped);
     const auto readFileError = GetLastError();
-    if ((!readFileSuccess) && readFileError != ERROR_IO_PENDING) {
+    if (
+      (!readFileSuccess) && readFileError != ERROR_IO_PENDING
+      && readFileError != ERROR_MORE_DATA) {
       dprintf("OTD-IPC ReadFile failed: {}", readFileError);
       co_return;
     }
     if (readFileError == ERROR_IO_PENDING) {
       bool haveEvent = false;
-      while (!mTabletsToTimeout.empty()) {
-        const auto first = mTabletsToTimeout.begin();
-        auto firstID = first->first;
-        auto firstTimeout = first->second;
-
-        for (const auto& [id, timeout]: mTabletsToTimeout) {
-          if (timeout < firstTimeout) {
-            firstID = id;
-            firstTimeout = timeout;
-          }
+      while (!mTimeoutQueue.empty()) {
+        const auto [deadline, id] = mTimeoutQueue.top();
+        const auto it = mTabletsToTimeout.find(id);
+        if (it == mTabletsToTimeout.end()) {
+          mTimeoutQueue.pop();
+          continue;
+        }
+        if (it->second > deadline) {
+          // Received more packets since this was queued
+          mTimeoutQueue.pop();
+          mTimeoutQueue.push({it->second, id});
+          continue;
         }
 
         const auto now = TimeoutClock::now();
-        if (firstTimeout < now) {
-          TimeoutTablet(firstID);
+        if (deadline <= now) {
+          mTimeoutQueue.pop();
+          mTabletsToTimeout.erase(it);
+          this->Enqueue({TabletTimeout {id}});
           continue;
         }
 
         if (co_await winrt::resume_on_signal(
               event.get(),
-              std::chrono::duration_cast<std::chrono::milliseconds>(
-                firstTimeout - now))) {
+              std::chrono::ceil<std::chrono::milliseconds>(deadline - now))) {
           haveEvent = true;
           break;
         }
-
-        TimeoutTablet(firstID);
       }
 
       if (!haveEvent) {
@@ -187,36 +198,127 @@ winrt::Windows::Foundation::IAsyncAction OTDIPCClient::RunSingle() {
       }
       if (!GetOverlappedResult(
             connection.get(), &overlapped, &bytesRead, TRUE)) {
-        dprintf("OTD-IPC GetOverlappedResult() failed: {}", GetLastError());
+        const auto error = GetLastError();
+        if (error != ERROR_MORE_DATA) {
+          dprintf("OTD-IPC GetOverlappedResult() failed: {}", error);
+        }
       }
     }
 
-    if (bytesRead < sizeof(Header)) {
-      dprintf("OTD-IPC packet smaller than header: {}", bytesRead);
-      co_return;
+    received.append(buffer, bytesRead);
+
+    std::vector<PendingItem> messages;
+    size_t offset = 0;
+    while (received.size() - offset >= sizeof(Header)) {
+      const auto header
+        = reinterpret_cast<const Header*>(received.data() + offset);
+      if (header->size < sizeof(Header)) {
+        dprintf("OTD-IPC packet smaller than header: {}", header->size);
+        co_return;
+      }
+      if (header->size > MaxMessageSize) {
+        dprintf("OTD-IPC packet too large: {}", header->size);
+        co_return;
+      }
+      if (received.size() - offset < header->size) {
+        break;
+      }
+      this->UpdateTimeout(header);
+      messages.push_back(received.substr(offset, header->size));
+      offset += header->size;
     }
+    received.erase(0, offset);
 
-    if (bytesRead < header->size) {
-      dprintf(
-        "OTD-IPC packet smaller than expected packet size: {} < {}",
-        bytesRead,
-        header->size);
-      co_return;
+    if (!messages.empty()) {
+      this->Enqueue(std::move(messages));
     }
+  }
+}
+
+void OTDIPCClient::UpdateTimeout(const OTDIPC::Messages::Header* const header) {
+  if (header->messageType != MessageType::State) {
+    return;
+  }
+  if (header->size < sizeof(State)) {
+    return;
+  }
+  const auto msg = reinterpret_cast<const State*>(header);
+  // e.g. Huion does not have proximity
+  if (msg->proximityValid || !msg->positionValid) {
+    return;
+  }
 
-    this->EnqueueMessage({buffer, header->size});
+  const auto deadline = TimeoutClock::now() + std::chrono::milliseconds(100);
+  const auto deviceID = MakeDeviceID(header);
+  const auto [it, inserted] = mTabletsToTimeout.insert_or_assign(
+    deviceID, deadline);
+  if (inserted) {
+    mTimeoutQueue.push({deadline, deviceID});
   }
 }
 
-winrt::fire_and_forget OTDIPCClient::EnqueueMessage(std::string message) {
+void OTDIPCClient::Enqueue(std::vector<PendingItem> items) {
+  std::unique_lock lock(mPendingMutex);
+  std::ranges::move(items, std::back_inserter(mPending));
+  if (mDrainScheduled) {
+    return;
+  }
+  mDrainScheduled = true;
+  lock.unlock();
+  this->DrainPending();
+}
+
+winrt::fire_and_forget OTDIPCClient::DrainPending() {
   auto weakThis = weak_from_this();
   co_await mUIThread;
   auto self = weakThis.lock();
   if (!self) {
     co_return;
   }
-  this->ProcessMessage(
-    reinterpret_cast<const OTDIPC::Messages::Header*>(message.data()));
+
+  std::vector<PendingItem> items;
+  {
+    std::unique_lock lock(mPendingMutex);
+    items = std::exchange(mPending, {});
+    mDrainScheduled = false;
+  }
+
+  const auto getDevice = [](const Header* header) {
+    return std::pair {header->vid, header->pid};
+  };
+  std::vector<decltype(getDevice(nullptr))> seenDevices;
+  std::vector<bool> isSuperseded(items.size(), false);
+  for (size_t i = items.size(); i-- > 0;) {
+    const auto message = std::get_if<std::string>(&items.at(i));
+    if (!message) {
+      continue;
+    }
+    const auto header = reinterpret_cast<const Header*>(message->data());
+    if (header->messageType != MessageType::State) {
+      continue;
+    }
+    const auto device = getDevice(header);
+    if (std::ranges::find(seenDevices, device) != seenDevices.end()) {
+      isSuperseded[i] = true;
+    } else {
+      seenDevices.push_back(device);
+    }
+  }
+
+  for (size_t i = 0; i < items.size(); ++i) {
+    if (const auto timeout = std::get_if<TabletTimeout>(&items.at(i))) {
+      this->TimeoutTablet(timeout->mDeviceID);
+      continue;
+    }
+    const auto& message = std::get<std::string>(items.at(i));
+    const auto header = reinterpret_cast<const Header*>(message.data());
+    if (header->messageType == MessageType::State) {
+      this->ProcessMessage(
+        reinterpret_cast<const State* const>(header), isSuperseded[i]);
+      continue;
+    }
+    this->ProcessMessage(header);
+  }
 }
 
 std::optional<TabletState> OTDIPCClient::GetState(const std::string& id) const {
@@ -250,7 +352,9 @@ void OTDIPCClient::ProcessMessage(
       this->ProcessMessage(reinterpret_cast<const DeviceInfo* const>(header));
       return;
     case MessageType::State:
-      this->ProcessMessage(reinterpret_cast<const State* const>(header));
+      this->ProcessMessage(
+        reinterpret_cast<const State* const>(header),
+        /* isSuperseded = */ false);
       return;
     case MessageType::Ping:
       // nothing to do
@@ -258,11 +362,6 @@ void OTDIPCClient::ProcessMessage(
   }
 }
 
-static std::string MakeDeviceID(const Header* const header) {
-  return std::format(
-    "otdipc-vidpid:///{:04x}/{:04x}", header->vid, header->pid);
-}
-
 void OTDIPCClient::ProcessMessage(
   const OTDIPC::Messages::DeviceInfo* const msg) {
   if (msg->size < sizeof(DeviceInfo)) {
@@ -284,7 +383,9 @@ void OTDIPCClient::ProcessMessage(
   evDeviceInfoReceivedEvent.Emit(info);
 }
 
-void OTDIPCClient::ProcessMessage(const OTDIPC::Messages::State* const msg) {
+void OTDIPCClient::ProcessMessage(
+  const OTDIPC::Messages::State* const msg,
+  bool isSuperseded) {
   if (msg->size < sizeof(State)) {
     return;
   }
@@ -298,8 +399,10 @@ void OTDIPCClient::ProcessMessage(const OTDIPC::Messages::State* const msg) {
   if (!tablet.mState) {
     dprintf("Received first packet for OTD-IPC device {}", deviceID);
     tablet.mState = TabletState {};
+    isSuperseded = false;
   }
   auto& state = tablet.mState.value();
+  const auto previous = state;
 
   if (msg->positionValid) {
     state.mX = msg->x;
@@ -329,10 +432,20 @@ void OTDIPCClient::ProcessMessage(const OTDIPC::Messages::State* const msg) {
     // e.g. Wacom
     state.mIsActive = msg->nearProximity;
   } else if (msg->positionValid) {
-    // e.g. Huion does not have proximity
+    // e.g. Huion does not have proximity; timeouts are tracked by the IPC
+    // task in UpdateTimeout()
     state.mIsActive = true;
-    mTabletsToTimeout[deviceID]
-      = TimeoutClock::now() + std::chrono::milliseconds(100);
+  }
+
+  // Intermediate hover positions are only useful for drawing the cursor,
+  // which will be redrawn at the latest position anyway. Every sample is
+  // kept while the tip is down, as they're part of a stroke.
+  if (
+    isSuperseded && !(state.mPenButtons & 1) && !(previous.mPenButtons & 1)
+    && state.mPenButtons == previous.mPenButtons
+    && state.mAuxButtons == previous.mAuxButtons
+    && state.mIsActive == previous.mIsActive) {
+    return;
   }
 
   OPENKNEEBOARD_TraceLoggingScope("OTDIPCClient::evTabletInputEvent");
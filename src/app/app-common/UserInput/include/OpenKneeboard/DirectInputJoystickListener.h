@@ -37,7 +37,25 @@ class DirectInputJoystickListener final : public DirectInputListener {
   virtual void OnAcquired() noexcept override;
 
  private:
-  DIJOYSTATE2 mState;
+  /* Only the buttons and hats from DIJOYSTATE2.
+   *
+   * Axes aren't part of our data format, so axis movement isn't copied, and
+   * doesn't need to wake us up. */
+  struct State {
+    DWORD mHats[4];
+    BYTE mButtons[128];
+  };
+  static_assert(sizeof(State) % sizeof(DWORD) == 0);
+
+  static constexpr DWORD BufferSize = 64;
+
+  State mState {};
+  bool mIsBuffered {false};
+
+  /// Returns false if the buffer overflowed, so events were lost
+  bool PollBuffered();
+  void PollState();
+  void OnObjectData(const DIDEVICEOBJECTDATA&);
 };
 
 }// namespace OpenKneeboard
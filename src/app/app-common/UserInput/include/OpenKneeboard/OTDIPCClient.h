@@ -32,7 +32,11 @@
 
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <unordered_map>
+#include <variant>
+#include <vector>
 
 namespace OTDIPC::Messages {
 struct Header;
@@ -70,10 +74,23 @@ class OTDIPCClient final : public std::enable_shared_from_this<OTDIPCClient> {
   winrt::Windows::Foundation::IAsyncAction Run();
   winrt::Windows::Foundation::IAsyncAction RunSingle();
 
-  winrt::fire_and_forget EnqueueMessage(std::string message);
+  struct TabletTimeout {
+    std::string mDeviceID;
+  };
+  // Either a complete raw message, or a timeout
+  using PendingItem = std::variant<std::string, TabletTimeout>;
+
+  void Enqueue(std::vector<PendingItem>);
+  winrt::fire_and_forget DrainPending();
   void ProcessMessage(const OTDIPC::Messages::Header* const);
   void ProcessMessage(const OTDIPC::Messages::DeviceInfo* const);
-  void ProcessMessage(const OTDIPC::Messages::State* const);
+  /** If `isSuperseded`, a later state for the same device is already
+   * pending, so the event is skipped unless it's needed for a button or
+   * proximity change, or a pen stroke. */
+  void ProcessMessage(
+    const OTDIPC::Messages::State* const,
+    bool isSuperseded);
+  void UpdateTimeout(const OTDIPC::Messages::Header* const);
   void TimeoutTablet(const std::string& id);
 
   winrt::Windows::Foundation::IAsyncAction mRunner;
@@ -87,13 +104,32 @@ class OTDIPCClient final : public std::enable_shared_from_this<OTDIPCClient> {
   };
   std::unordered_map<std::string, Tablet> mTablets;
 
+  // Messages read by the IPC task, waiting to be processed on the UI thread
+  std::mutex mPendingMutex;
+  std::vector<PendingItem> mPending;
+  bool mDrainScheduled {false};
+
   using TimeoutClock = std::chrono::steady_clock;
   /* Tablets that do not support proximity data.
    *
    * We just consider them inactive once we stop receiving packets
    * for a while.
+   *
+   * Only accessed by the IPC task.
    */
   std::unordered_map<std::string, TimeoutClock::time_point> mTabletsToTimeout;
+  /* Min-heap of the deadlines in `mTabletsToTimeout`, with one entry per
+   * tablet.
+   *
+   * Entries aren't updated for every packet; if the deadline has been
+   * extended by the time an entry reaches the top, it's requeued instead.
+   */
+  using TimeoutQueueEntry = std::pair<TimeoutClock::time_point, std::string>;
+  std::priority_queue<
+    TimeoutQueueEntry,
+    std::vector<TimeoutQueueEntry>,
+    std::greater<>>
+    mTimeoutQueue;
 };
 
 }// namespace OpenKneeboard
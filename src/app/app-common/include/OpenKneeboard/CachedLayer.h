@@ -24,11 +24,15 @@
 #include <OpenKneeboard/RenderTarget.h>
 
 #include <OpenKneeboard/audited_ptr.h>
+#include <OpenKneeboard/config.h>
 
 #include <shims/winrt/base.h>
 
+#include <chrono>
 #include <functional>
+#include <list>
 #include <mutex>
+#include <unordered_map>
 
 #include <d2d1_2.h>
 
@@ -36,11 +40,42 @@ namespace OpenKneeboard {
 
 struct DXResources;
 
+/** A least-recently-used cache of rendered layers.
+ *
+ * Multiple entries are kept, keyed by both the cache key and the cache
+ * dimensions; the total size of the cached textures is limited to the byte
+ * budget passed to the constructor.
+ *
+ * A single instance can be shared between render targets; the entry that was
+ * most recently rendered to each render target is not evicted unless that
+ * render target hasn't been rendered to for `DisplayPinTime`, so the budget
+ * only limits what's kept in addition to what's currently shown.
+ */
 class CachedLayer final {
  public:
   using Key = size_t;
+
+  /// Enough for the pages either side of the current page
+  static constexpr size_t DefaultMaxBytes = 3 * MaxViewRenderSize.mWidth
+    * MaxViewRenderSize.mHeight * sizeof(uint32_t);
+  /// Long enough for a view that isn't being repainted, but that's still
+  /// showing the same page; short enough to release render targets that
+  /// have been replaced
+  static constexpr auto DisplayPinTime = std::chrono::seconds(10);
+
+  struct Statistics {
+    uint64_t mHits {0};
+    uint64_t mMisses {0};
+    uint64_t mEvictions {0};
+    uint64_t mPrefetches {0};
+    size_t mEntryCount {0};
+    size_t mBytes {0};
+  };
+
   CachedLayer() = delete;
-  CachedLayer(const audited_ptr<DXResources>&);
+  CachedLayer(
+    const audited_ptr<DXResources>&,
+    size_t maxBytes = DefaultMaxBytes);
   ~CachedLayer();
 
   void Render(
@@ -49,17 +84,48 @@ class CachedLayer final {
     RenderTarget*,
     std::function<void(RenderTarget*, const PixelSize&)> impl,
     const std::optional<PixelSize>& cacheDimensions = {});
+  /// Populate the cache without drawing anything, if not already cached.
+  void Prefetch(
+    Key cacheKey,
+    std::function<void(RenderTarget*, const PixelSize&)> impl,
+    const PixelSize& cacheDimensions);
   void Reset();
 
+  Statistics GetStatistics() const;
+
  private:
-  Key mKey = ~Key {0};
+  struct Entry {
+    Key mKey = ~Key {0};
+    PixelSize mDimensions;
+    size_t mBytes {0};
+    std::shared_ptr<RenderTarget> mRenderTarget;
+    winrt::com_ptr<ID3D11Texture2D> mTexture;
+    winrt::com_ptr<ID3D11ShaderResourceView> mSRV;
+  };
+
+  struct Display {
+    Key mKey = ~Key {0};
+    PixelSize mDimensions;
+    std::chrono::steady_clock::time_point mLastRenderedAt;
+  };
+
   audited_ptr<DXResources> mDXR;
+  size_t mMaxBytes;
 
-  PixelSize mCacheDimensions;
-  std::mutex mCacheMutex;
-  std::shared_ptr<RenderTarget> mCacheRenderTarget;
-  winrt::com_ptr<ID3D11Texture2D> mCache;
-  winrt::com_ptr<ID3D11ShaderResourceView> mCacheSRV;
+  mutable std::mutex mCacheMutex;
+  // Most-recently-used first
+  std::list<Entry> mEntries;
+  Statistics mStatistics;
+  /// What each render target most recently showed
+  std::unordered_map<RenderTargetID, Display> mDisplays;
+
+  bool IsDisplayed(const Entry&) const;
+
+  /// Find or populate a cache entry, and move it to the front.
+  Entry& GetEntry(
+    Key cacheKey,
+    const std::function<void(RenderTarget*, const PixelSize&)>& impl,
+    const PixelSize& cacheDimensions);
 };
 
 }// namespace OpenKneeboard
@@ -0,0 +1,96 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <shims/filesystem>
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/** A recursive listing of the regular files in a directory.
+ *
+ * Rescans are incremental where possible: on NTFS and ReFS, a directory's
+ * last write time changes whenever an entry is added, removed, or renamed, so
+ * directories that haven't changed since the previous scan are not listed
+ * again. On other filesystems, every scan is a full scan.
+ *
+ * As unchanged directories are not re-listed, modifications to the content
+ * of existing files are not reliably detected; the owner is expected to watch
+ * individual files if it cares about their content.
+ *
+ * This class is not thread-safe.
+ */
+class DirectorySnapshot final {
+ public:
+  struct FileInfo {
+    uint64_t mSize {0};
+    std::filesystem::file_time_type mLastWriteTime {};
+    /// 0 if unknown
+    uint64_t mFileID {0};
+  };
+
+  struct Diff {
+    std::vector<std::filesystem::path> mAdded;
+    std::vector<std::filesystem::path> mRemoved;
+    std::vector<std::filesystem::path> mModified;
+    /// (from, to)
+    std::vector<std::tuple<std::filesystem::path, std::filesystem::path>>
+      mRenamed;
+    /// If true, `mAdded` contains every file, and all other fields are empty
+    bool mIsInitialScan {false};
+
+    bool IsEmpty() const noexcept;
+  };
+
+  DirectorySnapshot() = delete;
+  explicit DirectorySnapshot(const std::filesystem::path& root);
+
+  /** Rescan, and return the changes since the previous scan.
+   *
+   * Files in `recheck` are checked for modifications even if their directory
+   * hasn't changed; this is for files the owner couldn't use yet, e.g. because
+   * they were empty.
+   */
+  Diff Update(const std::set<std::filesystem::path>& recheck = {});
+
+  std::filesystem::path GetRoot() const;
+  const std::map<std::filesystem::path, FileInfo>& GetFiles() const;
+
+ private:
+  struct DirectoryInfo {
+    std::filesystem::file_time_type mLastWriteTime {};
+    std::vector<std::filesystem::path> mFiles;
+    std::vector<std::filesystem::path> mSubdirectories;
+  };
+
+  std::filesystem::path mRoot;
+  bool mTrustDirectoryTimes {false};
+  bool mScanned {false};
+
+  std::map<std::filesystem::path, FileInfo> mFiles;
+  std::map<std::filesystem::path, DirectoryInfo> mDirectories;
+};
+
+}// namespace OpenKneeboard
@@ -21,23 +21,44 @@
 
 #include <OpenKneeboard/CursorEvent.h>
 #include <OpenKneeboard/DXResources.h>
+#include <OpenKneeboard/DoodleStore.h>
+#include <OpenKneeboard/DoodleTileSurface.h>
 #include <OpenKneeboard/Events.h>
 #include <OpenKneeboard/ThreadGuard.h>
 
 #include <OpenKneeboard/audited_ptr.h>
 #include <OpenKneeboard/inttypes.h>
 
+#include <functional>
+#include <list>
+#include <optional>
 #include <unordered_set>
 
 namespace OpenKneeboard {
 
 class KneeboardState;
 
+/** Records and renders pen/eraser input.
+ *
+ * Strokes are kept as vectors, and rasterized on demand; textures are only
+ * kept for the most recently used pages.
+ */
 class DoodleRenderer final {
  public:
+  /// Pages with a rasterized texture; other pages only keep their strokes
+  static constexpr size_t MaxCachedPages = 4;
+
+  using PageIndexLookup = std::function<std::optional<PageIndex>(PageID)>;
+
   DoodleRenderer(const audited_ptr<DXResources>&, KneeboardState*);
   ~DoodleRenderer();
 
+  /** Save finished strokes to the store, and load strokes from it.
+   *
+   * Pages that the lookup returns `std::nullopt` for are not persisted.
+   */
+  void SetPersistentStore(const std::shared_ptr<DoodleStore>&, PageIndexLookup);
+
   void Render(ID2D1DeviceContext*, PageID, const PixelRect& destRect);
   void PostCursorEvent(
     EventContext,
@@ -49,6 +70,7 @@ class DoodleRenderer final {
   bool HaveDoodles(PageID) const;
   void Clear();
   void ClearPage(PageID);
+  /// Drop in-memory strokes, without modifying the persistent store
   void ClearExcept(const std::unordered_set<PageID>&);
 
   Event<> evNeedsRepaintEvent;
@@ -59,24 +81,41 @@ class DoodleRenderer final {
   KneeboardState* mKneeboard;
 
   winrt::com_ptr<ID2D1SolidColorBrush> mBrush;
-  winrt::com_ptr<ID2D1SolidColorBrush> mEraser;
+
+  std::shared_ptr<DoodleStore> mStore;
+  PageIndexLookup mPageIndexLookup;
 
   struct Drawing {
-    winrt::com_ptr<IDXGISurface> mSurface;
+    std::vector<DoodleStroke> mStrokes;
+    std::optional<DoodleStroke> mCurrentStroke;
+    bool mLoaded {false};
+
+    // Texture cache: strokes are rasterized into `mTiles` on the CPU, and
+    // only changed tiles are uploaded to `mTexture`
+    std::unique_ptr<DoodleTileSurface> mTiles;
+    winrt::com_ptr<ID3D11Texture2D> mTexture;
     winrt::com_ptr<ID2D1Bitmap1> mBitmap;
-    float mScale {-1.0f};
+
     std::vector<CursorEvent> mBufferedEvents;
-    bool mHaveCursor {false};
-    Geometry2D::Point<float> mCursorPoint;
     PixelSize mNativeSize {0, 0};
+
+    bool HaveStrokes() const;
+    void DropCache();
   };
   winrt::com_ptr<ID2D1DeviceContext> mDrawingContext;
   std::mutex mBufferedEventsMutex;
   std::unordered_map<PageID, Drawing> mDrawings;
+  // Most recently used first
+  std::list<PageID> mCachedPages;
 
-  ID2D1Bitmap* GetDrawingSurface(PageID);
+  bool LoadStrokes(PageID, Drawing*);
+  ID2D1Bitmap* GetCachedBitmap(PageID, Drawing*, const PixelSize& fallback);
+  void MarkCachedPageUsed(PageID);
+  void FinishStroke(PageID, Drawing*);
+  void UploadDirtyTiles(Drawing*);
 
-  void FlushCursorEvents();
+  /// Returns true if any page went from having no strokes to some strokes
+  bool FlushCursorEvents();
 
   ThreadGuard mThreadGuard;
 };
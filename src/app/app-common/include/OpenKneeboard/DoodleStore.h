@@ -0,0 +1,136 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <OpenKneeboard/inttypes.h>
+
+#include <shims/filesystem>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/** A single pen or eraser stroke.
+ *
+ * All values are resolution-independent, so strokes can be rasterized at any
+ * size.
+ */
+struct DoodleStroke {
+  enum class Tool : uint8_t {
+    Pen = 0,
+    Eraser = 1,
+  };
+
+  struct Point {
+    /// Fractions of the page size, scaled to [0, 65535]
+    uint16_t mX {};
+    uint16_t mY {};
+    /// Raw pen pressure, scaled to [0, 255]
+    uint8_t mPressure {};
+
+    constexpr bool operator==(const Point&) const noexcept = default;
+  };
+
+  /// About a quarter of a pixel at `MaxViewRenderSize`
+  static constexpr uint16_t DefaultSimplificationTolerance = 8;
+
+  Tool mTool {Tool::Pen};
+  /// 0xAARRGGBB
+  uint32_t mColor {0xff000000};
+  /// Fractions of the page height
+  float mMinimumRadius {};
+  float mSensitivity {};
+
+  std::vector<Point> mPoints;
+
+  /// Radius at the given point, as a fraction of the page height
+  float GetRadius(const Point&) const;
+};
+
+/** Remove points that don't visibly change the shape of the stroke.
+ *
+ * This is the Ramer-Douglas-Peucker algorithm, also taking changes in radius
+ * into account; `tolerance` is in the same units as the point coordinates.
+ */
+void SimplifyDoodleStroke(
+  DoodleStroke*,
+  uint16_t tolerance = DoodleStroke::DefaultSimplificationTolerance);
+
+/** Persistent strokes for a document, keyed by page index.
+ *
+ * The on-disk format is append-only: each finished stroke, and each clear,
+ * is a record appended to the file. Cleared strokes are dropped when the file
+ * is next loaded.
+ *
+ * Strokes are discarded if the document's size or modification time has
+ * changed, as page indices may no longer refer to the same content.
+ *
+ * Instances are shared between all users of the same document.
+ */
+class DoodleStore final {
+ public:
+  struct DocumentVersion {
+    uint64_t mSize {};
+    int64_t mModified {};
+
+    constexpr bool operator==(const DocumentVersion&) const noexcept = default;
+  };
+
+  DoodleStore() = delete;
+  ~DoodleStore();
+
+  static std::shared_ptr<DoodleStore> Get(
+    const std::filesystem::path& document);
+
+  bool HaveStrokes() const;
+  bool HaveStrokes(PageIndex) const;
+  std::vector<DoodleStroke> GetStrokes(PageIndex) const;
+
+  void Append(PageIndex, const DoodleStroke&);
+  void ClearPage(PageIndex);
+  void Clear();
+
+ private:
+  DoodleStore(
+    const std::filesystem::path& document,
+    const DocumentVersion&,
+    const std::filesystem::path& storePath);
+
+  void Load();
+  void Close();
+  void Rewrite();
+  void Write(const std::string& record);
+
+  std::filesystem::path mDocument;
+  DocumentVersion mDocumentVersion;
+  std::filesystem::path mStorePath;
+
+  mutable std::mutex mMutex;
+  std::map<PageIndex, std::vector<DoodleStroke>> mPages;
+  std::ofstream mFile;
+};
+
+}// namespace OpenKneeboard
@@ -0,0 +1,96 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <OpenKneeboard/Pixels.h>
+
+#include <compare>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/** A sparse, tiled, CPU-side surface for doodles.
+ *
+ * Tiles are only allocated once they've been drawn on, and changed tiles are
+ * tracked so that only they need to be uploaded to the GPU.
+ *
+ * Pixels are premultiplied 0xAARRGGBB, i.e. `DXGI_FORMAT_B8G8R8A8_UNORM` in
+ * memory.
+ */
+class DoodleTileSurface final {
+ public:
+  static constexpr uint32_t TileSize = 128;
+
+  struct TileCoord {
+    uint32_t mX {};
+    uint32_t mY {};
+
+    constexpr auto operator<=>(const TileCoord&) const noexcept = default;
+  };
+
+  /// In pixels
+  struct Vertex {
+    float mX {};
+    float mY {};
+    float mRadius {};
+  };
+
+  DoodleTileSurface() = delete;
+  explicit DoodleTileSurface(const PixelSize&);
+  ~DoodleTileSurface();
+
+  PixelSize GetSize() const;
+  bool IsEmpty() const;
+
+  /** Draw an anti-aliased line with round ends.
+   *
+   * The radius is interpolated between the two vertices; pass the same
+   * vertex twice to draw a dot.
+   */
+  void DrawSegment(const Vertex& from, const Vertex& to, uint32_t argb);
+  void EraseSegment(const Vertex& from, const Vertex& to);
+  void Clear();
+
+  /// Tiles that have changed since the previous call
+  std::vector<TileCoord> TakeDirtyTiles();
+
+  /// `TileSize * TileSize` pixels, or `nullptr` if the tile is empty
+  const uint32_t* GetTilePixels(const TileCoord&) const;
+  /// Clipped to the surface
+  PixelRect GetTileRect(const TileCoord&) const;
+
+ private:
+  PixelSize mSize;
+  uint32_t mColumns {};
+  uint32_t mRows {};
+
+  // Row-major; null if not drawn on
+  std::vector<std::unique_ptr<uint32_t[]>> mTiles;
+  std::vector<bool> mDirty;
+  std::vector<TileCoord> mDirtyTiles;
+
+  template <bool Erase>
+  void Rasterize(const Vertex& from, const Vertex& to, uint32_t argb);
+  void MarkDirty(uint32_t index);
+};
+
+}// namespace OpenKneeboard
@@ -0,0 +1,162 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <shims/filesystem>
+#include <shims/winrt/base.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/// OS-specific directory watching for `FilesystemWatchMultiplexer`.
+class IFilesystemWatchBackend {
+ public:
+  /** Called with the paths that changed.
+   *
+   * An empty span means that the changes are unknown - for example, because
+   * the OS's buffer overflowed - so everything should be considered changed.
+   */
+  using Callback
+    = std::function<void(std::span<const std::filesystem::path> changed)>;
+
+  class Watch {
+   public:
+    /// Must not return while the callback is running.
+    virtual ~Watch() = default;
+  };
+
+  virtual ~IFilesystemWatchBackend() = default;
+
+  /** Start watching a directory.
+   *
+   * The callback may be invoked from any thread, until the returned `Watch`
+   * is destroyed. Returns `nullptr` on failure.
+   */
+  virtual std::unique_ptr<Watch> CreateWatch(
+    const std::filesystem::path& directory,
+    bool recursive,
+    Callback)
+    = 0;
+};
+
+/** Shares filesystem change notifications across the process.
+ *
+ * Each watched directory has a single OS-level watch, however many files in
+ * it are being watched. Changes are filtered by path, and each subscriber is
+ * notified at most once per settle window.
+ */
+class FilesystemWatchMultiplexer final
+  : public std::enable_shared_from_this<FilesystemWatchMultiplexer> {
+ public:
+  static constexpr auto DefaultSettleTime = std::chrono::milliseconds(50);
+
+  struct Statistics {
+    size_t mWatches {0};
+    size_t mSubscriptions {0};
+    /// Notifications from the OS
+    uint64_t mWakeups {0};
+    /// Notifications that were merged into an already-pending delivery
+    uint64_t mCoalesced {0};
+    /// Calls to subscription callbacks
+    uint64_t mDeliveries {0};
+    std::chrono::steady_clock::time_point mSince;
+
+    double GetWakeupsPerSecond() const;
+  };
+
+  class Subscription final {
+   public:
+    Subscription() = delete;
+    ~Subscription();
+
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+
+   private:
+    friend class FilesystemWatchMultiplexer;
+    Subscription(const std::shared_ptr<FilesystemWatchMultiplexer>&, uint64_t);
+
+    std::shared_ptr<FilesystemWatchMultiplexer> mMultiplexer;
+    uint64_t mID {};
+  };
+
+  FilesystemWatchMultiplexer() = delete;
+  ~FilesystemWatchMultiplexer();
+
+  /// The process-wide instance, using the native backend.
+  static std::shared_ptr<FilesystemWatchMultiplexer> Get();
+  static std::shared_ptr<FilesystemWatchMultiplexer> Create(
+    std::unique_ptr<IFilesystemWatchBackend>);
+
+  /** Invoke `callback` when `path` changes.
+   *
+   * If `path` is a directory, any change within it counts; otherwise, only
+   * changes to that specific file count. The callback is invoked on a
+   * background thread, once the settle window has passed.
+   */
+  [[nodiscard]] std::unique_ptr<Subscription> Subscribe(
+    const std::filesystem::path& path,
+    std::function<void()> callback);
+
+  void SetSettleTime(std::chrono::milliseconds);
+  Statistics GetStatistics() const;
+
+ private:
+  explicit FilesystemWatchMultiplexer(std::unique_ptr<IFilesystemWatchBackend>);
+
+  // (directory, recursive)
+  using WatchKey = std::tuple<std::filesystem::path, bool>;
+
+  struct Subscriber {
+    std::filesystem::path mPath;
+    WatchKey mWatchKey;
+    std::function<void()> mCallback;
+    bool mPending {false};
+  };
+
+  struct WatchInfo {
+    std::unique_ptr<IFilesystemWatchBackend::Watch> mWatch;
+    std::vector<uint64_t> mSubscribers;
+  };
+
+  void Unsubscribe(uint64_t id);
+  void OnChanged(const WatchKey&, std::span<const std::filesystem::path>);
+  winrt::fire_and_forget Deliver(uint64_t id);
+
+  std::unique_ptr<IFilesystemWatchBackend> mBackend;
+
+  mutable std::mutex mMutex;
+  std::chrono::milliseconds mSettleTime {DefaultSettleTime};
+  uint64_t mNextID {0};
+  std::map<uint64_t, Subscriber> mSubscribers;
+  std::map<WatchKey, WatchInfo> mWatches;
+  Statistics mStatistics;
+};
+
+}// namespace OpenKneeboard
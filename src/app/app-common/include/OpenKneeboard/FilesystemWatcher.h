@@ -20,32 +20,30 @@
 #pragma once
 
 #include <OpenKneeboard/Events.h>
-
-#include <OpenKneeboard/final_release_deleter.h>
-#include <OpenKneeboard/handles.h>
+#include <OpenKneeboard/FilesystemWatchMultiplexer.h>
 
 #include <shims/filesystem>
 #include <shims/winrt/base.h>
 
-#include <winrt/Windows.Storage.Search.h>
-
+#include <atomic>
 #include <memory>
 
-#include <fileapi.h>
-
 namespace OpenKneeboard {
 
+/** Notifies when a file or directory changes.
+ *
+ * Notifications for regular files are only sent once the file has settled,
+ * i.e. is no longer being written to.
+ *
+ * OS-level watches are shared via `FilesystemWatchMultiplexer`, so watching
+ * many files in the same directory is cheap.
+ */
 class FilesystemWatcher final
   : public std::enable_shared_from_this<FilesystemWatcher> {
  public:
-  using unique_changenotification = std::
-    unique_ptr<HANDLE, CHandleDeleter<HANDLE, &FindCloseChangeNotification>>;
   static std::shared_ptr<FilesystemWatcher> Create(
     const std::filesystem::path&);
 
-  static winrt::fire_and_forget final_release(
-    std::unique_ptr<FilesystemWatcher>);
-
   Event<std::filesystem::path> evFilesystemModifiedEvent;
 
   FilesystemWatcher() = delete;
@@ -54,20 +52,15 @@ class FilesystemWatcher final
  private:
   FilesystemWatcher(const std::filesystem::path&);
   void Initialize();
-  winrt::Windows::Foundation::IAsyncAction Run();
   winrt::fire_and_forget OnContentsChanged();
 
-  winrt::Windows::Foundation::IAsyncAction mImpl {nullptr};
-
   winrt::apartment_context mOwnerThread;
   std::filesystem::path mPath;
 
   std::filesystem::file_time_type mLastWriteTime;
-  bool mSettling = false;
+  std::atomic_bool mSettling = false;
 
-  unique_changenotification mHandle;
-  std::stop_source mStop;
-  winrt::handle mShutdownHandle;
+  std::unique_ptr<FilesystemWatchMultiplexer::Subscription> mSubscription;
 };
 
 }// namespace OpenKneeboard
@@ -116,6 +116,9 @@ class KneeboardState final
 
   ProfileSettings GetProfileSettings() const;
   void SetProfileSettings(const ProfileSettings&);
+  /// Remove a profile and erase its settings, switching to the default profile
+  /// if it's active
+  void RemoveProfile(const std::string& profileID);
 
   void NotifyAppWindowIsForeground(bool isForeground);
 
@@ -167,6 +170,7 @@ class KneeboardState final
   audited_ptr<DXResources> mDXResources;
   ProfileSettings mProfiles {ProfileSettings::Load()};
   Settings mSettings {Settings::Load(mProfiles.mActiveProfile)};
+  SettingsWriter mSettingsWriter;
 
   uint8_t mInputViewIndex = 0;
   std::vector<std::shared_ptr<KneeboardView>> mViews;
@@ -195,6 +199,8 @@ class KneeboardState final
     const std::shared_ptr<GameInstance>& game);
   void OnGameEvent(const GameEvent& ev) noexcept;
 
+  void OnCurrentTabChanged();
+
   void BeforeFrame();
   void AfterFrame(FramePostEventKind);
 
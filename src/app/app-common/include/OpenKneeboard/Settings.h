@@ -30,6 +30,13 @@
 
 #include <shims/filesystem>
 
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
 namespace OpenKneeboard {
 
 #define OPENKNEEBOARD_SETTINGS_SECTIONS \
@@ -60,4 +67,72 @@ struct Settings final {
 
 OPENKNEEBOARD_DECLARE_SPARSE_JSON(Settings);
 
+/** Saves settings from a background thread.
+ *
+ * `Settings::Save()` re-reads the profile and its parent, then rewrites every
+ * section; that's too slow to do for every change, e.g. while dragging a
+ * slider.
+ *
+ * This keeps what's on disk in memory, waits for changes to settle, then
+ * only writes the sections that actually changed.
+ */
+class SettingsWriter final {
+ public:
+  SettingsWriter();
+  ~SettingsWriter();
+
+  SettingsWriter(const SettingsWriter&) = delete;
+  SettingsWriter& operator=(const SettingsWriter&) = delete;
+
+  void Save(std::string_view profileID, const Settings&);
+
+  /** Write any pending changes, and forget what's on disk.
+   *
+   * Call this before anything else reads or modifies the settings files.
+   */
+  void Flush();
+
+  /** Load a profile's settings, writing any pending changes first.
+   *
+   * Recently-used profiles are returned from memory; this makes switching
+   * between profiles much cheaper than `Settings::Load()`.
+   */
+  Settings Load(std::string_view profileID);
+  /// Forget a removed profile, discarding any pending changes
+  void Forget(std::string_view profileID);
+
+  static constexpr auto SettleTime = std::chrono::milliseconds(500);
+  static constexpr auto MaxDelay = std::chrono::seconds(5);
+
+ private:
+  using PendingSettings = std::map<std::string, Settings, std::less<>>;
+
+  struct FileState {
+    nlohmann::json mJSON;
+    std::filesystem::file_time_type mLastWriteTime;
+  };
+
+  std::mutex mMutex;
+  std::condition_variable_any mWakeup;
+  PendingSettings mPending;
+  std::chrono::steady_clock::time_point mFirstPendingAt;
+  std::chrono::steady_clock::time_point mLastPendingAt;
+
+  // Everything below is protected by mWriteMutex
+  std::mutex mWriteMutex;
+  std::unordered_map<std::string, Settings> mBaselines;
+  std::map<std::filesystem::path, FileState> mFiles;
+
+  std::jthread mThread;
+
+  void Run(std::stop_token);
+  /// Caller must hold mWriteMutex, which must be locked before mMutex
+  PendingSettings TakePending();
+  void Write(const PendingSettings&);
+  void Write(const std::string& profileID, const Settings&);
+  const Settings& GetBaseline(const std::string& profileID);
+  nlohmann::json GetFileContents(const std::filesystem::path&);
+  void SetFileContents(const std::filesystem::path&, const nlohmann::json&);
+};
+
 }// namespace OpenKneeboard
@@ -22,6 +22,7 @@
 #include <OpenKneeboard/DXResources.h>
 #include <OpenKneeboard/Events.h>
 #include <OpenKneeboard/IPageSource.h>
+#include <OpenKneeboard/PageIDIndex.h>
 #include <OpenKneeboard/ThreadGuard.h>
 
 #include <OpenKneeboard/audited_ptr.h>
@@ -90,6 +91,10 @@ class TabView final : private EventReceiver {
   KneeboardState* mKneeboard;
 
   std::shared_ptr<ITab> mRootTab;
+  // Updated when the root tab's pages change; this is done lazily, as
+  // querying the tab's pages would wake it up if it's hibernating
+  mutable PageIDIndex mRootTabPageIDs;
+  mutable bool mRootTabPageIDsStale {true};
   struct PagePosition {
     PageID mID;
     // The ID is the source of truth (so e.g. bookmarks and doodles stay on the
@@ -101,7 +106,10 @@ class TabView final : private EventReceiver {
     // feel best.
     PageIndex mIndex;
   };
-  std::optional<PagePosition> mRootTabPage;
+  // A null ID means we should find the page by index when we next look at
+  // the tab; this is the initial state, and set when the tab hibernates
+  mutable std::optional<PagePosition> mRootTabPage {
+    PagePosition {PageID(nullptr), 0}};
 
   // For now, just navigation views, maybe more later
   std::shared_ptr<ITab> mActiveSubTab;
@@ -109,6 +117,9 @@ class TabView final : private EventReceiver {
 
   TabMode mTabMode = TabMode::Normal;
 
+  void UpdateRootTabPageIDs() const;
+  void RestoreRootTabPage() const;
+  bool IsRootTabHibernating() const;
   void OnTabContentChanged();
   void OnTabPageAppended(SuggestedPageAppendAction);
 
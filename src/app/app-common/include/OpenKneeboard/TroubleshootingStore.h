@@ -23,7 +23,9 @@
 #include <OpenKneeboard/dprint.h>
 
 #include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
@@ -70,8 +72,14 @@ class TroubleshootingStore final : private EventReceiver {
   std::jthread mDPrintThread;
   std::map<std::string, GameEventEntry> mGameEvents;
   std::optional<std::ofstream> mLogFile;
+  std::jthread mLogRotationThread;
 
   void InitializeLogFile();
+  static void RotateLogFiles(
+    std::stop_token,
+    std::vector<std::filesystem::path> existingFiles,
+    size_t maxLogFiles,
+    uint64_t maxLogBytes);
   void WriteDPrintMessageToLogFile(const DPrintEntry&);
 
   TroubleshootingStore();
@@ -86,6 +86,11 @@ ProcessPickerDialog::ProcessPickerDialog() {
     return it.as<GameInstanceUIData>().Name();
   });
 
+  for (const auto& it: games) {
+    // The 'name' is just the file basename
+    mSearchIndex.Add({to_string(it.as<GameInstanceUIData>().Path())});
+  }
+
   mProcesses = games;
   List().ItemsSource(single_threaded_vector(std::move(games)));
 }
@@ -128,14 +133,8 @@ void ProcessPickerDialog::OnAutoSuggestTextChanged(
     return;
   }
 
+  // Already sorted by relevance, then by name
   auto matching = this->GetFilteredProcesses(queryText);
-
-  std::ranges::sort(matching, {}, [](const auto& inspectable) {
-    return fold_utf8(
-      to_string(inspectable.as<OpenKneeboardApp::GameInstanceUIData>()
-                  .GetStringRepresentation()));
-  });
-
   box.ItemsSource(single_threaded_vector(std::move(matching)));
 }
 
@@ -145,32 +144,10 @@ std::vector<IInspectable> ProcessPickerDialog::GetFilteredProcesses(
     return mProcesses;
   }
 
-  const auto folded = fold_utf8(to_utf8(queryText));
-  auto words = std::string_view {folded}
-    | std::views::split(std::string_view {" "})
-    | std::views::transform([](auto subRange) {
-                 return std::string_view {subRange.begin(), subRange.end()};
-               });
-
   std::vector<IInspectable> ret;
-  for (auto rawData: mProcesses) {
-    auto process = rawData.as<OpenKneeboardApp::GameInstanceUIData>();
-    // The 'name' is just the file basename
-    const auto path = fold_utf8(winrt::to_string(process.Path()));
-
-    bool matchedAllWords = true;
-    for (auto word: words) {
-      if (path.find(word) != path.npos) {
-        continue;
-      }
-      matchedAllWords = false;
-      break;
-    }
-    if (matchedAllWords) {
-      ret.push_back(process);
-    }
+  for (const auto& match: mSearchIndex.Search(to_utf8(queryText))) {
+    ret.push_back(mProcesses.at(match.mIndex));
   }
-
   return ret;
 }
 
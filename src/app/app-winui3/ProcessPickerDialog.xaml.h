@@ -23,6 +23,8 @@
 #include "ProcessPickerDialog.g.h"
 // clang-format on
 
+#include <OpenKneeboard/SearchIndex.h>
+
 using namespace winrt::Microsoft::UI::Xaml;
 using namespace winrt::Microsoft::UI::Xaml::Controls;
 
@@ -48,6 +50,7 @@ struct ProcessPickerDialog : ProcessPickerDialogT<ProcessPickerDialog> {
  private:
   hstring mSelectedPath;
   std::vector<IInspectable> mProcesses;
+  OpenKneeboard::SearchIndex mSearchIndex;
   bool mFiltered {false};
 
   std::vector<IInspectable> GetFilteredProcesses(std::wstring_view queryText);
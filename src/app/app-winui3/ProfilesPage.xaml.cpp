@@ -113,7 +113,7 @@ fire_and_forget ProfilesPage::RemoveProfile(
   const IInspectable& sender,
   const RoutedEventArgs&) {
   const auto id {to_string(unbox_value<hstring>(sender.as<Button>().Tag()))};
-  auto profileSettings = mKneeboard->GetProfileSettings();
+  const auto profileSettings = mKneeboard->GetProfileSettings();
   const auto profile = profileSettings.mProfiles.at(id);
   const auto sorted = profileSettings.GetSortedProfiles();
   const auto index = std::ranges::find(sorted, profile) - sorted.begin();
@@ -133,16 +133,7 @@ fire_and_forget ProfilesPage::RemoveProfile(
     co_return;
   }
 
-  // Actually erase the settings
-  const auto parentSettings = Settings::Load("default");
-  parentSettings.Save(id);
-
-  // ... and remove from the list
-  if (id == profileSettings.mActiveProfile) {
-    profileSettings.mActiveProfile = "default";
-  }
-  profileSettings.mProfiles.erase(id);
-  mKneeboard->SetProfileSettings(profileSettings);
+  mKneeboard->RemoveProfile(id);
   mUIProfiles.RemoveAt(static_cast<uint32_t>(index));
   List().SelectedIndex(0);
 }
@@ -28,6 +28,9 @@
 
 #include <OpenKneeboard/WindowCaptureTab.h>
 
+#include <OpenKneeboard/utf8.h>
+
+#include <algorithm>
 #include <string_view>
 
 using namespace winrt::Windows::Foundation::Collections;
@@ -51,6 +54,18 @@ WindowPickerDialog::WindowPickerDialog() {
     winrtWindows.push_back(uiData);
   }
 
+  // Sorted once here so that search results with equal relevance are in
+  // alphabetical order
+  std::ranges::sort(winrtWindows, {}, [](const auto& inspectable) {
+    return fold_utf8(
+      to_string(inspectable.as<OpenKneeboardApp::WindowPickerUIData>()
+                  .GetStringRepresentation()));
+  });
+  for (const auto& it: winrtWindows) {
+    const auto window = it.as<OpenKneeboardApp::WindowPickerUIData>();
+    mSearchIndex.Add({to_string(window.Title()), to_string(window.Path())});
+  }
+
   mWindows = winrtWindows;
   List().ItemsSource(
     single_threaded_vector<IInspectable>(std::move(winrtWindows)));
@@ -94,14 +109,8 @@ void WindowPickerDialog::OnAutoSuggestTextChanged(
     return;
   }
 
+  // Already sorted by relevance, then alphabetically
   auto matching = this->GetFilteredWindows(queryText);
-
-  std::ranges::sort(matching, {}, [](const auto& inspectable) {
-    return fold_utf8(
-      to_string(inspectable.as<OpenKneeboardApp::WindowPickerUIData>()
-                  .GetStringRepresentation()));
-  });
-
   box.ItemsSource(single_threaded_vector(std::move(matching)));
 }
 
@@ -111,35 +120,10 @@ std::vector<IInspectable> WindowPickerDialog::GetFilteredWindows(
     return mWindows;
   }
 
-  const auto folded = fold_utf8(to_utf8(queryText));
-  auto words = std::string_view {folded}
-    | std::views::split(std::string_view {" "})
-    | std::views::transform([](auto subRange) {
-                 return std::string_view {subRange.begin(), subRange.end()};
-               });
-
   std::vector<IInspectable> ret;
-  for (auto rawData: mWindows) {
-    auto window = rawData.as<OpenKneeboardApp::WindowPickerUIData>();
-    const auto title = fold_utf8(winrt::to_string(window.Title()));
-    const auto path = fold_utf8(winrt::to_string(window.Path()));
-
-    bool matchedAllWords = true;
-    for (auto word: words) {
-      if (title.find(word) != title.npos) {
-        continue;
-      }
-      if (path.find(word) != path.npos) {
-        continue;
-      }
-      matchedAllWords = false;
-      break;
-    }
-    if (matchedAllWords) {
-      ret.push_back(window);
-    }
+  for (const auto& match: mSearchIndex.Search(to_utf8(queryText))) {
+    ret.push_back(mWindows.at(match.mIndex));
   }
-
   return ret;
 }
 
@@ -24,6 +24,8 @@
 #include "WindowPickerUIData.g.h"
 // clang-format on
 
+#include <OpenKneeboard/SearchIndex.h>
+
 using namespace winrt::Microsoft::UI::Xaml;
 using namespace winrt::Microsoft::UI::Xaml::Controls;
 using namespace winrt::Microsoft::UI::Xaml::Data;
@@ -52,6 +54,7 @@ struct WindowPickerDialog : WindowPickerDialogT<WindowPickerDialog> {
  private:
   uint64_t mHwnd {};
   std::vector<IInspectable> mWindows;
+  OpenKneeboard::SearchIndex mSearchIndex;
   bool mFiltered {false};
 
   std::vector<IInspectable> GetFilteredWindows(std::wstring_view queryText);
@@ -264,7 +264,8 @@ XrResult OpenXRKneeboard::xrEndFrame(
   }
 
   const auto hmdPose = this->GetHMDPose(frameEndInfo->displayTime);
-  auto vrLayers = this->GetLayers(snapshot, hmdPose);
+  auto& vrLayers = mVRLayers;
+  this->GetLayers(snapshot, hmdPose, vrLayers);
   const auto layerCount
     = (vrLayers.size() + frameEndInfo->layerCount) <= mMaxLayerCount
     ? vrLayers.size()
@@ -277,7 +278,8 @@ XrResult OpenXRKneeboard::xrEndFrame(
 
   auto config = snapshot.GetConfig();
 
-  std::vector<const XrCompositionLayerBaseHeader*> nextLayers;
+  auto& nextLayers = mNextLayers;
+  nextLayers.clear();
   nextLayers.reserve(frameEndInfo->layerCount + layerCount);
   std::copy(
     frameEndInfo->layers,
@@ -287,17 +289,10 @@ XrResult OpenXRKneeboard::xrEndFrame(
   uint8_t topMost = layerCount - 1;
 
   bool needRender = config.mVR.mQuirks.mOpenXR_AlwaysUpdateSwapchain;
-  std::vector<SHM::LayerSprite> layerSprites;
-  std::vector<uint64_t> cacheKeys;
-  std::vector<XrCompositionLayerQuad> addedXRLayers;
-  layerSprites.reserve(layerCount);
-  cacheKeys.reserve(layerCount);
-  addedXRLayers.reserve(layerCount);
-
   for (size_t layerIndex = 0; layerIndex < layerCount; ++layerIndex) {
     const auto [layer, params] = vrLayers.at(layerIndex);
 
-    cacheKeys.push_back(params.mCacheKey);
+    mLayerCacheKeys[layerIndex] = params.mCacheKey;
     PixelRect destRect {
       Spriting::GetOffset(layerIndex, snapshot.GetLayerCount()),
       layer->mVR.mLocationOnTexture.mSize,
@@ -317,11 +312,11 @@ XrResult OpenXRKneeboard::xrEndFrame(
         break;
     }
 
-    layerSprites.push_back(SHM::LayerSprite {
+    mLayerSprites[layerIndex] = SHM::LayerSprite {
       .mSourceRect = layer->mVR.mLocationOnTexture,
       .mDestRect = destRect,
       .mOpacity = params.mKneeboardOpacity,
-    });
+    };
 
     if (params.mCacheKey != mRenderCacheKeys.at(layerIndex)) {
       needRender = true;
@@ -335,7 +330,7 @@ XrResult OpenXRKneeboard::xrEndFrame(
       SHM::SHARED_TEXTURE_IS_PREMULTIPLIED,
       "Use premultiplied alpha in shared texture, or pass "
       "XR_COMPOSITION_LAYER_UNPREMULTIPLIED_ALPHA_BIT");
-    addedXRLayers.push_back({
+    mAddedXRLayers[layerIndex] = {
       .type = XR_TYPE_COMPOSITION_LAYER_QUAD,
       .next = nullptr,
       .layerFlags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT 
@@ -349,14 +344,14 @@ XrResult OpenXRKneeboard::xrEndFrame(
       },
       .pose = this->GetXrPosef(params.mKneeboardPose),
       .size = { params.mKneeboardSize.x, params.mKneeboardSize.y },
-    });
+    };
 
-    nextLayers.push_back(
-      reinterpret_cast<XrCompositionLayerBaseHeader*>(&addedXRLayers.back()));
+    nextLayers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(
+      &mAddedXRLayers[layerIndex]));
   }
 
   if (topMost != layerCount - 1) {
-    std::swap(addedXRLayers.back(), addedXRLayers.at(topMost));
+    std::swap(mAddedXRLayers.at(layerCount - 1), mAddedXRLayers.at(topMost));
   }
 
   if (needRender) {
@@ -379,7 +374,10 @@ XrResult OpenXRKneeboard::xrEndFrame(
     {
       OPENKNEEBOARD_TraceLoggingScope("RenderLayers()");
       this->RenderLayers(
-        mSwapchain, swapchainTextureIndex, snapshot, layerSprites);
+        mSwapchain,
+        swapchainTextureIndex,
+        snapshot,
+        std::span {mLayerSprites.data(), layerCount});
     }
 
     {
@@ -387,9 +385,7 @@ XrResult OpenXRKneeboard::xrEndFrame(
       check_xrresult(mOpenXR->xrReleaseSwapchainImage(mSwapchain, nullptr));
     }
 
-    for (size_t i = 0; i < cacheKeys.size(); ++i) {
-      mRenderCacheKeys[i] = cacheKeys.at(i);
-    }
+    std::copy_n(mLayerCacheKeys.begin(), layerCount, mRenderCacheKeys.begin());
   }
 
   XrFrameEndInfo nextFrameEndInfo {*frameEndInfo};
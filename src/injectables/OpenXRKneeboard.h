@@ -33,8 +33,10 @@
 
 #include <openxr/openxr.h>
 
+#include <array>
 #include <format>
 #include <span>
+#include <vector>
 
 template <class CharT>
 struct std::formatter<XrResult, CharT> : std::formatter<int, CharT> {};
@@ -87,6 +89,13 @@ class OpenXRKneeboard : public VRKneeboard {
   PixelSize mSwapchainDimensions;
   std::array<uint64_t, MaxViewCount> mRenderCacheKeys;
 
+  // Reused every frame to avoid heap allocations in the game's render thread
+  std::vector<Layer> mVRLayers;
+  std::vector<const XrCompositionLayerBaseHeader*> mNextLayers;
+  std::array<SHM::LayerSprite, MaxViewCount> mLayerSprites {};
+  std::array<uint64_t, MaxViewCount> mLayerCacheKeys {};
+  std::array<XrCompositionLayerQuad, MaxViewCount> mAddedXRLayers {};
+
   XrSpace mLocalSpace = nullptr;
   XrSpace mViewSpace = nullptr;
 
@@ -21,6 +21,8 @@
 
 #include <OpenKneeboard/dprint.h>
 
+#include <utility>
+
 // clang-format off
 #include <Windows.h>
 #include <Psapi.h>
@@ -28,6 +30,50 @@
 
 namespace OpenKneeboard {
 
+namespace {
+
+const IMAGE_NT_HEADERS* GetNTHeaders(HMODULE hModule) {
+  auto base = reinterpret_cast<const std::byte*>(hModule);
+  auto dos = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+  if (dos->e_magic != IMAGE_DOS_SIGNATURE) {
+    return nullptr;
+  }
+  auto nt = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dos->e_lfanew);
+  if (nt->Signature != IMAGE_NT_SIGNATURE) {
+    return nullptr;
+  }
+  return nt;
+}
+
+/* Sections containing code; other sections are skipped as they're usually
+ * the majority of the image in games, e.g. embedded resources */
+std::vector<std::pair<std::byte*, std::byte*>> GetExecutableSections(
+  HMODULE hModule,
+  const MODULEINFO& info) {
+  auto base = reinterpret_cast<std::byte*>(info.lpBaseOfDll);
+  auto nt = GetNTHeaders(hModule);
+  if (!nt) {
+    return {{base, base + info.SizeOfImage}};
+  }
+
+  std::vector<std::pair<std::byte*, std::byte*>> ret;
+  auto section = IMAGE_FIRST_SECTION(nt);
+  for (WORD i = 0; i < nt->FileHeader.NumberOfSections; ++i, ++section) {
+    if (!(section->Characteristics & IMAGE_SCN_MEM_EXECUTE)) {
+      continue;
+    }
+    auto sectionBegin = base + section->VirtualAddress;
+    ret.push_back({sectionBegin, sectionBegin + section->Misc.VirtualSize});
+  }
+
+  if (ret.empty()) {
+    return {{base, base + info.SizeOfImage}};
+  }
+  return ret;
+}
+
+}// namespace
+
 std::vector<BytePattern> ComputeFunctionPatterns(
   std::basic_string_view<unsigned char> rawPattern) {
   std::vector<BytePattern> patterns;
@@ -71,31 +117,33 @@ void* FindFunctionPattern(
   dprintf(
     "Code search range: {:#018x}-{:#018x}", (uint64_t)begin, (uint64_t)end);
 
-  const uint64_t firstPattern = allPatterns.front().value,
-                 firstMask = allPatterns.front().mask;
-  auto patterns = allPatterns;
-  patterns.erase(patterns.begin());
   // Stack entries (including functions) are always aligned on 16-byte
   // boundaries
-  for (auto func = begin; func < end; func += (16 / sizeof(*func))) {
-    auto it = func;
-    if ((*it & firstMask) != firstPattern) {
+  constexpr auto step = 16 / sizeof(*begin);
+  const auto misalignment = reinterpret_cast<uintptr_t>(begin) % 16;
+  if (misalignment) {
+    begin += (16 - misalignment) / sizeof(*begin);
+  }
+
+  const uint64_t firstPattern = allPatterns.front().value,
+                 firstMask = allPatterns.front().mask;
+  for (auto func = begin; func < end; func += step) {
+    if ((*func & firstMask) != firstPattern) [[likely]] {
       continue;
     }
-    for (auto& pattern: patterns) {
-      it++;
-      if (it >= end) {
-        return nullptr;
-      }
-
-      if ((*it & pattern.mask) != pattern.value) {
-        goto FindFunctionPattern_NextBlock;
+    if (func + allPatterns.size() > end) {
+      return nullptr;
+    }
+    bool matches = true;
+    for (size_t i = 1; i < allPatterns.size(); ++i) {
+      if ((func[i] & allPatterns[i].mask) != allPatterns[i].value) {
+        matches = false;
+        break;
       }
     }
-    return reinterpret_cast<void*>(func);
-
-  FindFunctionPattern_NextBlock:
-    continue;
+    if (matches) {
+      return reinterpret_cast<void*>(func);
+    }
   }
 
   return nullptr;
@@ -114,25 +162,33 @@ void* FindFunctionPatternInModule(
   if (!GetModuleInformation(
         GetCurrentProcess(), hModule, &info, sizeof(info))) {
     dprintf("Failed to GetModuleInformation() for {}", moduleName);
-    return 0;
+    return nullptr;
   }
 
-  auto begin = info.lpBaseOfDll;
-  auto end = reinterpret_cast<void*>(
-    reinterpret_cast<std::byte*>(info.lpBaseOfDll) + info.SizeOfImage);
-  auto pattern = ComputeFunctionPatterns(rawPattern);
-  auto addr = FindFunctionPattern(pattern, begin, end);
-  if (addr == nullptr || foundMultiple == nullptr) {
-    return addr;
-  }
+  const auto pattern = ComputeFunctionPatterns(rawPattern);
+  void* addr = nullptr;
+  for (auto [begin, end]: GetExecutableSections(hModule, info)) {
+    auto found = FindFunctionPattern(pattern, begin, end);
+    if (!found) {
+      continue;
+    }
+    if (addr) {
+      // Already found one in an earlier section
+      *foundMultiple = true;
+      return addr;
+    }
+    addr = found;
+    if (!foundMultiple) {
+      return addr;
+    }
 
-  auto nextAddr = reinterpret_cast<uintptr_t>(addr)
-    + (pattern.size() * sizeof(pattern.front().value));
-  // 16-byte alignment for all stack addresses
-  nextAddr -= (nextAddr % 16);
-  begin = reinterpret_cast<void*>(nextAddr);
-  if (FindFunctionPattern(pattern, begin, end)) {
-    *foundMultiple = true;
+    // 16-byte alignment is restored by `FindFunctionPattern()`
+    begin = reinterpret_cast<std::byte*>(addr)
+      + (pattern.size() * sizeof(pattern.front().value));
+    if (begin < end && FindFunctionPattern(pattern, begin, end)) {
+      *foundMultiple = true;
+      return addr;
+    }
   }
 
   return addr;
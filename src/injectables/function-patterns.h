@@ -18,7 +18,9 @@
  * USA.
  */
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace OpenKneeboard {
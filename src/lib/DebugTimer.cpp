@@ -18,14 +18,11 @@
  * USA.
  */
 #include <OpenKneeboard/DebugTimer.h>
-#include <OpenKneeboard/dprint.h>
-
-#include <format>
 
 namespace OpenKneeboard {
 
-DebugTimer::DebugTimer(std::string_view label)
-  : mLabel(label), mStart(std::chrono::steady_clock::now()) {
+DebugTimer::DebugTimer(std::string_view label) {
+  mTimer.emplace(Metrics::GetHistogram(label));
 }
 
 DebugTimer::~DebugTimer() {
@@ -33,16 +30,7 @@ DebugTimer::~DebugTimer() {
 }
 
 void DebugTimer::End() {
-  if (mFinished) {
-    return;
-  }
-
-  mFinished = true;
-  dprintf(
-    "Timer: {} = {}",
-    mLabel,
-    std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - mStart));
+  mTimer.reset();
 }
 
 }// namespace OpenKneeboard
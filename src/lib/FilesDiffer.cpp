@@ -20,13 +20,59 @@
 #include <OpenKneeboard/FilesDiffer.h>
 #include <OpenKneeboard/Win32.h>
 
+#include <OpenKneeboard/dprint.h>
+
 #include <shims/filesystem>
 #include <shims/winrt/base.h>
 
+#include <Windows.h>
+
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
 
 namespace OpenKneeboard {
 
+namespace {
+
+constexpr size_t ChunkSize = 1024 * 1024;
+
+winrt::file_handle OpenForRead(const std::filesystem::path& path) {
+  return Win32::CreateFileW(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_WRITE,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+    NULL);
+}
+
+/// Reads until `buffer` is full or EOF; returns the number of bytes read
+std::optional<size_t>
+ReadChunk(HANDLE file, std::byte* buffer, size_t bufferSize) {
+  size_t total = 0;
+  while (total < bufferSize) {
+    DWORD bytesRead {};
+    if (!ReadFile(
+          file,
+          buffer + total,
+          static_cast<DWORD>(bufferSize - total),
+          &bytesRead,
+          nullptr)) {
+      return std::nullopt;
+    }
+    if (bytesRead == 0) {
+      break;
+    }
+    total += bytesRead;
+  }
+  return total;
+}
+
+}// namespace
+
 bool FilesDiffer(
   const std::filesystem::path& a,
   const std::filesystem::path& b) {
@@ -45,39 +91,38 @@ bool FilesDiffer(
     return true;
   }
 
-  const auto af = Win32::CreateFileW(
-    a.c_str(),
-    GENERIC_READ,
-    FILE_SHARE_READ | FILE_SHARE_WRITE,
-    nullptr,
-    OPEN_EXISTING,
-    FILE_ATTRIBUTE_NORMAL,
-    NULL);
-  const auto bf = Win32::CreateFileW(
-    b.c_str(),
-    GENERIC_READ,
-    FILE_SHARE_READ | FILE_SHARE_WRITE,
-    nullptr,
-    OPEN_EXISTING,
-    FILE_ATTRIBUTE_NORMAL,
-    NULL);
-
-  const auto afm = Win32::CreateFileMappingW(
-    af.get(), nullptr, PAGE_READONLY, 0, 0, nullptr);
-  const auto bfm = Win32::CreateFileMappingW(
-    bf.get(), nullptr, PAGE_READONLY, 0, 0, nullptr);
-
-  auto av = reinterpret_cast<std::byte*>(
-    MapViewOfFile(afm.get(), FILE_MAP_READ, 0, 0, 0));
-  auto bv = reinterpret_cast<std::byte*>(
-    MapViewOfFile(bfm.get(), FILE_MAP_READ, 0, 0, 0));
-
-  const auto equal = std::equal(av, av + size, bv, bv + size);
+  const auto af = OpenForRead(a);
+  const auto bf = OpenForRead(b);
+  if (!(af && bf)) {
+    // We can't tell, so assume the caller needs to do something
+    dprintf("Failed to open '{}' or '{}' for comparison", a, b);
+    return true;
+  }
 
-  UnmapViewOfFile(av);
-  UnmapViewOfFile(bv);
+  // +1 so that EOF is detected without a second read
+  const auto bufferSize
+    = static_cast<size_t>(std::min<uint64_t>(size + 1, ChunkSize));
+  const auto buffers = std::make_unique<std::byte[]>(bufferSize * 2);
+  const auto aBuffer = buffers.get();
+  const auto bBuffer = aBuffer + bufferSize;
 
-  return !equal;
+  // Stop at the first differing chunk
+  while (true) {
+    const auto aSize = ReadChunk(af.get(), aBuffer, bufferSize);
+    const auto bSize = ReadChunk(bf.get(), bBuffer, bufferSize);
+    if (!(aSize && bSize)) {
+      return true;
+    }
+    if (*aSize != *bSize) {
+      return true;
+    }
+    if (*aSize == 0) {
+      return false;
+    }
+    if (std::memcmp(aBuffer, bBuffer, *aSize) != 0) {
+      return true;
+    }
+  }
 }
 
 }// namespace OpenKneeboard
@@ -18,6 +18,7 @@
  * USA.
  */
 #include <OpenKneeboard/Filesystem.h>
+#include <OpenKneeboard/Win32.h>
 
 #include <OpenKneeboard/dprint.h>
 #include <OpenKneeboard/hresult.h>
@@ -27,10 +28,15 @@
 
 #include <Windows.h>
 
+#include <algorithm>
 #include <format>
 #include <mutex>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
 
 #include <ShlObj.h>
+#include <winioctl.h>
 
 namespace OpenKneeboard::Filesystem {
 
@@ -175,26 +181,256 @@ ScopedDeleter::~ScopedDeleter() noexcept {
   }
 }
 
-TemporaryCopy::TemporaryCopy(
-  const std::filesystem::path& source,
+namespace {
+
+struct SnapshotSourceInfo {
+  uint32_t mVolumeSerialNumber {};
+  uint64_t mFileIndex {};
+  uint64_t mFileSize {};
+  uint64_t mLastWriteTime {};
+
+  constexpr bool operator==(const SnapshotSourceInfo&) const noexcept
+    = default;
+};
+
+struct SnapshotCacheEntry {
+  SnapshotSourceInfo mSourceInfo;
+  std::weak_ptr<TemporarySnapshot> mSnapshot;
+};
+
+std::optional<SnapshotSourceInfo> GetSnapshotSourceInfo(HANDLE file) {
+  BY_HANDLE_FILE_INFORMATION info {};
+  if (!GetFileInformationByHandle(file, &info)) {
+    return std::nullopt;
+  }
+  return SnapshotSourceInfo {
+    .mVolumeSerialNumber = info.dwVolumeSerialNumber,
+    .mFileIndex = (static_cast<uint64_t>(info.nFileIndexHigh) << 32)
+      | info.nFileIndexLow,
+    .mFileSize = (static_cast<uint64_t>(info.nFileSizeHigh) << 32)
+      | info.nFileSizeLow,
+    .mLastWriteTime
+    = (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32)
+      | info.ftLastWriteTime.dwLowDateTime,
+  };
+}
+
+/** Clone the extents of `source` into a new file at `destination`.
+ *
+ * This is only supported by filesystems with block refcounting, e.g. ReFS
+ * (including Dev Drives); it's near-instant and doesn't use any extra disk
+ * space until either file is modified.
+ *
+ * Returns false if unsupported; the caller is expected to fall back to a full
+ * copy.
+ */
+bool TryBlockClone(
+  HANDLE source,
+  uint64_t size,
   const std::filesystem::path& destination) {
-  if (!std::filesystem::exists(source)) {
-    throw std::logic_error("TemporaryCopy created without a source file");
+  DWORD fsFlags {};
+  if (!GetVolumeInformationByHandleW(
+        source, nullptr, 0, nullptr, nullptr, &fsFlags, nullptr, 0)) {
+    return false;
+  }
+  if (!(fsFlags & FILE_SUPPORTS_BLOCK_REFCOUNTING)) {
+    return false;
+  }
+
+  wchar_t volume[MAX_PATH];
+  if (!GetVolumePathNameW(destination.c_str(), volume, MAX_PATH)) {
+    return false;
+  }
+  DWORD sectorsPerCluster {};
+  DWORD bytesPerSector {};
+  DWORD freeClusters {};
+  DWORD totalClusters {};
+  if (!GetDiskFreeSpaceW(
+        volume,
+        &sectorsPerCluster,
+        &bytesPerSector,
+        &freeClusters,
+        &totalClusters)) {
+    return false;
+  }
+  const uint64_t clusterSize
+    = static_cast<uint64_t>(sectorsPerCluster) * bytesPerSector;
+  if (clusterSize == 0) {
+    return false;
+  }
+
+  const auto dest = Win32::CreateFileW(
+    destination.c_str(),
+    GENERIC_READ | GENERIC_WRITE | DELETE,
+    0,
+    nullptr,
+    CREATE_NEW,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL);
+  if (!dest) {
+    return false;
+  }
+
+  bool success = false;
+  const scope_guard deleteOnFailure([&]() {
+    if (success) {
+      return;
+    }
+    FILE_DISPOSITION_INFO disposition {.DeleteFile = TRUE};
+    SetFileInformationByHandle(
+      dest.get(), FileDispositionInfo, &disposition, sizeof(disposition));
+  });
+
+  FILE_END_OF_FILE_INFO eof {};
+  eof.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+  if (!SetFileInformationByHandle(
+        dest.get(), FileEndOfFileInfo, &eof, sizeof(eof))) {
+    return false;
+  }
+
+  // Each call is limited to < 4GB, and must be a multiple of the cluster
+  // size, except that the last region may extend past EOF
+  const uint64_t maxChunk = (1ull << 31);
+  for (uint64_t offset = 0; offset < size; offset += maxChunk) {
+    const auto remaining = std::min(size - offset, maxChunk);
+    DUPLICATE_EXTENTS_DATA extents {
+      .FileHandle = source,
+    };
+    extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+    extents.ByteCount.QuadPart = static_cast<LONGLONG>(
+      ((remaining + clusterSize - 1) / clusterSize) * clusterSize);
+    DWORD bytesReturned {};
+    if (!DeviceIoControl(
+          dest.get(),
+          FSCTL_DUPLICATE_EXTENTS_TO_FILE,
+          &extents,
+          sizeof(extents),
+          nullptr,
+          0,
+          &bytesReturned,
+          nullptr)) {
+      return false;
+    }
   }
+
+  success = true;
+  return true;
+}
+
+}// namespace
+
+TemporarySnapshot::TemporarySnapshot(
+  const std::filesystem::path& path,
+  Strategy strategy)
+  : mPath(path), mStrategy(strategy) {
+}
+
+std::shared_ptr<TemporarySnapshot> TemporarySnapshot::Create(
+  const std::filesystem::path& source) {
+  static std::mutex sMutex;
+  static std::unordered_map<std::wstring, SnapshotCacheEntry> sCache;
+  static uint64_t sCount {0};
+
+  if (!std::filesystem::is_regular_file(source)) {
+    throw std::logic_error("TemporarySnapshot created without a source file");
+  }
+
+  const auto sourceFile = Win32::CreateFileW(
+    source.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL);
+  if (!sourceFile) {
+    throw std::system_error(
+      static_cast<int>(GetLastError()),
+      std::system_category(),
+      "Failed to open TemporarySnapshot source");
+  }
+  const auto sourceInfo = GetSnapshotSourceInfo(sourceFile.get());
+
+  const auto cacheKey = std::filesystem::weakly_canonical(source).wstring();
+  const auto findExisting = [&]() -> std::shared_ptr<TemporarySnapshot> {
+    if (!sourceInfo) {
+      return nullptr;
+    }
+    const auto it = sCache.find(cacheKey);
+    if (it == sCache.end() || it->second.mSourceInfo != *sourceInfo) {
+      return nullptr;
+    }
+    return it->second.mSnapshot.lock();
+  };
+
+  // Only hold the lock for the cache; copying can take a while, and would
+  // block snapshots of unrelated files
+  uint64_t index {};
+  {
+    const std::unique_lock lock(sMutex);
+    std::erase_if(
+      sCache, [](const auto& it) { return it.second.mSnapshot.expired(); });
+    if (auto existing = findExisting()) {
+      return existing;
+    }
+    index = ++sCount;
+  }
+
+  const auto destination = GetTemporaryDirectory()
+    / std::format(L"{:08x}-{}{}",
+                  index,
+                  source.stem().wstring().substr(0, 16),
+                  source.extension().wstring());
   if (std::filesystem::exists(destination)) {
     throw std::logic_error(
-      "TemporaryCopy created, but destination already exists");
+      "TemporarySnapshot created, but destination already exists");
+  }
+
+  auto strategy = Strategy::BlockClone;
+  if (!(sourceInfo
+        && TryBlockClone(
+          sourceFile.get(), sourceInfo->mFileSize, destination))) {
+    strategy = Strategy::Copy;
+    std::filesystem::copy(source, destination);
+  }
+  dprintf(
+    "Created {} snapshot of '{}' at '{}'",
+    strategy == Strategy::BlockClone ? "block clone" : "full copy",
+    source,
+    destination);
+
+  std::shared_ptr<TemporarySnapshot> ret {
+    new TemporarySnapshot(destination, strategy)};
+  if (!sourceInfo) {
+    return ret;
   }
-  std::filesystem::copy(source, destination);
-  mCopy = destination;
+
+  std::shared_ptr<TemporarySnapshot> existing;
+  {
+    const std::unique_lock lock(sMutex);
+    // Another thread may have snapshotted the same file while we were copying
+    existing = findExisting();
+    if (!existing) {
+      sCache.insert_or_assign(cacheKey, SnapshotCacheEntry {*sourceInfo, ret});
+    }
+  }
+  // If so, use theirs; ours is removed when `ret` goes out of scope, outside
+  // the lock
+  return existing ? existing : ret;
+}
+
+TemporarySnapshot::~TemporarySnapshot() noexcept {
+  std::error_code ignored;
+  std::filesystem::remove(mPath, ignored);
 }
 
-TemporaryCopy::~TemporaryCopy() noexcept {
-  std::filesystem::remove(mCopy);
+std::filesystem::path TemporarySnapshot::GetPath() const noexcept {
+  return mPath;
 }
 
-std::filesystem::path TemporaryCopy::GetPath() const noexcept {
-  return mCopy;
+TemporarySnapshot::Strategy TemporarySnapshot::GetStrategy() const noexcept {
+  return mStrategy;
 }
 
 };// namespace OpenKneeboard::Filesystem
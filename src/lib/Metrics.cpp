@@ -0,0 +1,257 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/Metrics.h>
+
+#include <OpenKneeboard/dprint.h>
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+
+namespace OpenKneeboard::Metrics {
+
+namespace {
+
+constexpr auto SnapshotInterval = std::chrono::minutes(5);
+
+template <class T>
+struct Entry {
+  std::unique_ptr<T> mMetric {std::make_unique<T>()};
+  // Used to skip unchanged metrics in `LogSnapshot()`
+  std::optional<uint64_t> mLastLogged;
+};
+
+struct Registry {
+  std::shared_mutex mMutex;
+  std::map<std::string, Entry<Histogram>, std::less<>> mHistograms;
+  std::map<std::string, Entry<Counter>, std::less<>> mCounters;
+  std::map<std::string, Entry<Gauge>, std::less<>> mGauges;
+};
+
+Registry& GetRegistry() {
+  static Registry sRegistry;
+  return sRegistry;
+}
+
+template <class T>
+T& GetMetric(
+  std::map<std::string, Entry<T>, std::less<>>& map,
+  std::string_view name) {
+  auto& registry = GetRegistry();
+  {
+    std::shared_lock lock(registry.mMutex);
+    if (auto it = map.find(name); it != map.end()) {
+      return *it->second.mMetric;
+    }
+  }
+  std::unique_lock lock(registry.mMutex);
+  if (auto it = map.find(name); it != map.end()) {
+    return *it->second.mMetric;
+  }
+  return *map.emplace(std::string {name}, Entry<T> {}).first->second.mMetric;
+}
+
+std::atomic<std::chrono::steady_clock::rep> gNextSnapshot {0};
+
+void MaybeLogSnapshot(std::chrono::steady_clock::time_point now) {
+  auto next = gNextSnapshot.load(std::memory_order_relaxed);
+  const auto nowRep = now.time_since_epoch().count();
+  if (nowRep < next) [[likely]] {
+    return;
+  }
+  const auto newNext = (now + SnapshotInterval).time_since_epoch().count();
+  if (!gNextSnapshot.compare_exchange_strong(
+        next, newNext, std::memory_order_relaxed)) {
+    // Another thread is logging it
+    return;
+  }
+  // Skip the first; it's just setting the first deadline
+  if (next != 0) {
+    LogSnapshot();
+  }
+}
+
+std::string FormatDuration(std::chrono::nanoseconds value) {
+  return std::format(
+    "{:.3f}ms", std::chrono::duration<double, std::milli>(value).count());
+}
+
+}// namespace
+
+size_t Histogram::GetBucketIndex(uint64_t value) noexcept {
+  if (value < SubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  const auto exponent = std::bit_width(value) - (SubBucketBits + 1);
+  const auto subBucket = (value >> exponent) - SubBuckets;
+  return ((exponent + 1) * SubBuckets) + static_cast<size_t>(subBucket);
+}
+
+uint64_t Histogram::GetBucketMidpoint(size_t index) {
+  if (index < SubBuckets) {
+    return index;
+  }
+  const auto exponent = (index / SubBuckets) - 1;
+  const auto subBucket = index % SubBuckets;
+  const auto lower = static_cast<uint64_t>(SubBuckets + subBucket) << exponent;
+  return lower + ((uint64_t {1} << exponent) / 2);
+}
+
+void Histogram::Record(std::chrono::nanoseconds duration) noexcept {
+  const auto value = static_cast<uint64_t>(std::max<int64_t>(
+    duration.count(), 0));
+  mBuckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  mTotal.fetch_add(value, std::memory_order_relaxed);
+  auto max = mMax.load(std::memory_order_relaxed);
+  while (value > max
+         && !mMax.compare_exchange_weak(
+           max, value, std::memory_order_relaxed)) {
+  }
+  // Last, so that `GetCount()` changing implies the buckets have too
+  mCount.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t Histogram::GetCount() const noexcept {
+  return mCount.load(std::memory_order_acquire);
+}
+
+Histogram::Summary Histogram::GetSummary() const {
+  // Other threads may be recording concurrently, so count from the buckets
+  // rather than trusting `mCount` to match them
+  std::array<uint64_t, BucketCount> buckets;
+  uint64_t count = 0;
+  for (size_t i = 0; i < BucketCount; ++i) {
+    buckets[i] = mBuckets[i].load(std::memory_order_relaxed);
+    count += buckets[i];
+  }
+
+  Summary ret {
+    .mCount = count,
+    .mTotal = std::chrono::nanoseconds(mTotal.load(std::memory_order_relaxed)),
+    .mMax = std::chrono::nanoseconds(mMax.load(std::memory_order_relaxed)),
+  };
+  if (count == 0) {
+    return ret;
+  }
+
+  const auto percentile = [&](uint64_t percent) {
+    // Rank of the sample at this percentile, rounding up, 1-based
+    const auto rank = std::max<uint64_t>(1, ((count * percent) + 99) / 100);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        const auto max = static_cast<uint64_t>(ret.mMax.count());
+        return std::chrono::nanoseconds(std::min(GetBucketMidpoint(i), max));
+      }
+    }
+    return ret.mMax;
+  };
+  ret.mP50 = percentile(50);
+  ret.mP90 = percentile(90);
+  ret.mP99 = percentile(99);
+  return ret;
+}
+
+Histogram& GetHistogram(std::string_view name) {
+  return GetMetric(GetRegistry().mHistograms, name);
+}
+
+Counter& GetCounter(std::string_view name) {
+  return GetMetric(GetRegistry().mCounters, name);
+}
+
+Gauge& GetGauge(std::string_view name) {
+  return GetMetric(GetRegistry().mGauges, name);
+}
+
+void LogSnapshot() {
+  auto& registry = GetRegistry();
+  std::unique_lock lock(registry.mMutex);
+
+  bool first = true;
+  const auto logHeader = [&first]() {
+    if (first) {
+      first = false;
+      dprintf(
+        "Metrics: {:<40} {:>8} {:>12} {:>12} {:>12} {:>12}",
+        "histogram",
+        "count",
+        "p50",
+        "p90",
+        "p99",
+        "max");
+    }
+  };
+
+  for (auto& [name, entry]: registry.mHistograms) {
+    const auto count = entry.mMetric->GetCount();
+    if (entry.mLastLogged == count) {
+      continue;
+    }
+    entry.mLastLogged = count;
+    const auto summary = entry.mMetric->GetSummary();
+    logHeader();
+    dprintf(
+      "Metrics: {:<40} {:>8} {:>12} {:>12} {:>12} {:>12}",
+      name,
+      summary.mCount,
+      FormatDuration(summary.mP50),
+      FormatDuration(summary.mP90),
+      FormatDuration(summary.mP99),
+      FormatDuration(summary.mMax));
+  }
+
+  for (auto& [name, entry]: registry.mCounters) {
+    const auto value = entry.mMetric->Get();
+    if (entry.mLastLogged == value) {
+      continue;
+    }
+    entry.mLastLogged = value;
+    dprintf("Metrics: counter {} = {}", name, value);
+  }
+
+  for (auto& [name, entry]: registry.mGauges) {
+    const auto value = entry.mMetric->Get();
+    if (entry.mLastLogged == static_cast<uint64_t>(value)) {
+      continue;
+    }
+    entry.mLastLogged = static_cast<uint64_t>(value);
+    dprintf("Metrics: gauge {} = {}", name, value);
+  }
+}
+
+ScopedTimer::ScopedTimer(Histogram& histogram)
+  : mHistogram(histogram), mStart(std::chrono::steady_clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+  const auto now = std::chrono::steady_clock::now();
+  mHistogram.Record(now - mStart);
+  MaybeLogSnapshot(now);
+}
+
+}// namespace OpenKneeboard::Metrics
@@ -123,7 +123,7 @@ static std::vector<Bookmark> ExtractBookmarks(
   QPDFOutlineDocumentHelper& outlineHelper,
   const PageIndexMap& pageIndices) noexcept {
   std::vector<Bookmark> bookmarks;
-  DebugTimer timer("Bookmarks");
+  DebugTimer timer("PDF/Bookmarks");
   auto outlines = outlineHelper.getTopLevelOutlines();
   ExtractBookmarks(
     outlineHelper, outlines, pageIndices, std::back_inserter(bookmarks));
@@ -271,7 +271,7 @@ static std::vector<std::vector<Link>> ExtractLinks(
   QPDFOutlineDocumentHelper& outlineHelper,
   std::vector<QPDFPageObjectHelper>& pages,
   const PageIndexMap& pageIndices) {
-  DebugTimer timer("Links");
+  DebugTimer timer("PDF/Links");
   std::vector<std::vector<Link>> allLinks;
   allLinks.reserve(pages.size());
 
@@ -288,7 +288,7 @@ PDF::Impl::Impl(const std::filesystem::path& path) {
     return;
   }
 
-  DebugTimer initTimer("PDF Init");
+  DebugTimer initTimer("PDF/Init");
 
   const auto fileSize = std::filesystem::file_size(path);
   const auto wpath = path.wstring();
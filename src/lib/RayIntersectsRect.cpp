@@ -29,11 +29,20 @@ bool RayIntersectsRect(
   const Vector3& rectCenter,
   const Quaternion& rectOrientation,
   const Vector2& rectSize) {
-  const Vector3 rayNormal(Vector3::Transform(Vector3::Forward, rayOrientation));
-  const Ray ray(rayOrigin, rayNormal);
+  return RayIntersectsRect(
+    Ray(rayOrigin, Vector3::Transform(Vector3::Forward, rayOrientation)),
+    Matrix::CreateFromQuaternion(rectOrientation)
+      * Matrix::CreateTranslation(rectCenter),
+    rectSize);
+}
 
-  const Plane plane(
-    rectCenter, Vector3::Transform(Vector3::Backward, rectOrientation));
+bool RayIntersectsRect(
+  const Ray& ray,
+  const Matrix& rectTransform,
+  const Vector2& rectSize) {
+  // For a rigid transform, the rows of the rotation are the rectangle's axes
+  const auto rectCenter = rectTransform.Translation();
+  const Plane plane(rectCenter, rectTransform.Backward());
 
   // Does the ray intersect the infinite plane?
   float rayLength = 0;
@@ -42,17 +51,17 @@ bool RayIntersectsRect(
   }
 
   // Where does it intersect the infinite plane?
-  const auto worldPoint = rayOrigin + (rayNormal * rayLength);
+  const auto worldPoint = ray.position + (ray.direction * rayLength);
 
   // Is that point within the rectangle?
   const auto point = worldPoint - rectCenter;
 
-  const auto x = point.Dot(Vector3::Transform(Vector3::UnitX, rectOrientation));
+  const auto x = point.Dot(rectTransform.Right());
   if (abs(x) > rectSize.x / 2) {
     return false;
   }
 
-  const auto y = point.Dot(Vector3::Transform(Vector3::UnitY, rectOrientation));
+  const auto y = point.Dot(rectTransform.Up());
   if (abs(y) > rectSize.y / 2) {
     return false;
   }
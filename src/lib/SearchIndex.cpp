@@ -0,0 +1,197 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/SearchIndex.h>
+
+#include <OpenKneeboard/utf8.h>
+
+#include <algorithm>
+#include <ranges>
+
+namespace OpenKneeboard {
+
+namespace {
+
+enum Score : uint32_t {
+  NoMatch = 0,
+  InitialsMatch = 1,
+  SubstringMatch = 2,
+  TokenPrefixMatch = 3,
+  PrefixMatch = 4,
+};
+
+constexpr bool IsSeparator(char c) noexcept {
+  switch (c) {
+    case ' ':
+    case '\\':
+    case '/':
+    case '.':
+    case '-':
+    case '_':
+    case '(':
+    case ')':
+    case '[':
+    case ']':
+    case ':':
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::vector<std::string_view> SplitWords(std::string_view query) {
+  std::vector<std::string_view> ret;
+  for (auto&& word: std::views::split(query, ' ')) {
+    if (!word.empty()) {
+      ret.emplace_back(word.begin(), word.end());
+    }
+  }
+  return ret;
+}
+
+}// namespace
+
+size_t SearchIndex::Add(std::initializer_list<std::string_view> fields) {
+  Candidate candidate;
+  candidate.mFields.reserve(fields.size());
+  for (const auto& raw: fields) {
+    Field field {.mFolded = fold_utf8(raw)};
+    const auto& folded = field.mFolded;
+    for (size_t i = 0; i < folded.size(); ++i) {
+      if (IsSeparator(folded[i])) {
+        continue;
+      }
+      if (i == 0 || IsSeparator(folded[i - 1])) {
+        field.mTokenStarts.push_back(i);
+        field.mInitials.push_back(folded[i]);
+      }
+    }
+    candidate.mFields.push_back(std::move(field));
+  }
+  mCandidates.push_back(std::move(candidate));
+
+  mLastQuery.clear();
+  mLastMatches.clear();
+
+  return mCandidates.size() - 1;
+}
+
+size_t SearchIndex::GetSize() const noexcept {
+  return mCandidates.size();
+}
+
+uint32_t SearchIndex::ScoreWord(
+  const Field& field,
+  std::string_view word) noexcept {
+  const std::string_view folded {field.mFolded};
+  if (folded.starts_with(word)) {
+    return PrefixMatch;
+  }
+
+  if (folded.find(word) != folded.npos) {
+    for (const auto start: field.mTokenStarts) {
+      if (folded.substr(start).starts_with(word)) {
+        return TokenPrefixMatch;
+      }
+    }
+    return SubstringMatch;
+  }
+
+  // Subsequence of initials; greedy is sufficient for subsequences
+  const std::string_view initials {field.mInitials};
+  size_t next = 0;
+  for (const auto c: word) {
+    next = initials.find(c, next);
+    if (next == initials.npos) {
+      return NoMatch;
+    }
+    ++next;
+  }
+  return InitialsMatch;
+}
+
+std::vector<SearchIndex::Match> SearchIndex::Search(
+  std::string_view query) const {
+  const auto folded = fold_utf8(query);
+  const auto words = SplitWords(folded);
+
+  std::vector<Match> ret;
+  if (words.empty()) {
+    ret.reserve(mCandidates.size());
+    for (size_t i = 0; i < mCandidates.size(); ++i) {
+      ret.push_back({i, 0});
+    }
+    mLastQuery.clear();
+    mLastMatches.clear();
+    return ret;
+  }
+
+  // Extending a query can only remove matches, so if this is an extension
+  // of the previous query, there's no need to look at anything else
+  const auto isRefinement
+    = (!mLastQuery.empty()) && folded.starts_with(mLastQuery);
+
+  const auto scoreCandidate = [&words](const Candidate& candidate) {
+    uint32_t total = 0;
+    for (const auto word: words) {
+      uint32_t best = NoMatch;
+      for (const auto& field: candidate.mFields) {
+        best = std::max(best, ScoreWord(field, word));
+        if (best == PrefixMatch) {
+          break;
+        }
+      }
+      if (best == NoMatch) {
+        return uint32_t {NoMatch};
+      }
+      total += best;
+    }
+    return total;
+  };
+
+  const auto tryCandidate = [&](size_t index) {
+    const auto score = scoreCandidate(mCandidates.at(index));
+    if (score != NoMatch) {
+      ret.push_back({index, score});
+    }
+  };
+
+  if (isRefinement) {
+    for (const auto& previous: mLastMatches) {
+      tryCandidate(previous.mIndex);
+    }
+  } else {
+    for (size_t i = 0; i < mCandidates.size(); ++i) {
+      tryCandidate(i);
+    }
+  }
+
+  std::ranges::sort(ret, [](const Match& a, const Match& b) {
+    if (a.mScore != b.mScore) {
+      return a.mScore > b.mScore;
+    }
+    return a.mIndex < b.mIndex;
+  });
+
+  mLastQuery = folded;
+  mLastMatches = ret;
+  return ret;
+}
+
+}// namespace OpenKneeboard
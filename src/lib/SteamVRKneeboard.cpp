@@ -19,6 +19,7 @@
  */
 #include <OpenKneeboard/D3D11.h>
 #include <OpenKneeboard/DXResources.h>
+#include <OpenKneeboard/Metrics.h>
 #include <OpenKneeboard/RayIntersectsRect.h>
 #include <OpenKneeboard/SHM.h>
 #include <OpenKneeboard/SHM/ActiveConsumers.h>
@@ -34,6 +35,8 @@
 
 #include <directxtk/SimpleMath.h>
 
+#include <cmath>
+#include <numbers>
 #include <thread>
 
 #include <TlHelp32.h>
@@ -47,6 +50,15 @@ using namespace DirectX::SimpleMath;
 
 namespace OpenKneeboard {
 
+namespace {
+// Below these, head movement can't meaningfully change the gaze target
+constexpr float MinPositionDelta = 0.001f;// meters
+constexpr float MinRotationDelta = 0.1f * std::numbers::pi_v<float> / 180;
+
+// Refresh anyway in case of anything we don't track
+constexpr std::chrono::seconds MaxUpdateInterval {1};
+}// namespace
+
 SteamVRKneeboard::SteamVRKneeboard() {
   OPENKNEEBOARD_TraceLoggingScope("SteamVRKneeboard::SteamVRKneeboard()");
   auto d3d = mDXR.mD3D11Device.get();
@@ -109,6 +121,7 @@ void SteamVRKneeboard::Reset() {
   dprint(__FUNCTION__);
 
   vr::VR_Shutdown();
+  mLastUpdate = {};
   mIVRSystem = {};
   mIVROverlay = {};
   for (auto& layer: mLayers) {
@@ -235,6 +248,15 @@ void SteamVRKneeboard::Tick() {
     return;
   }
   const auto hmdPose = *maybeHMDPose;
+
+  const auto now = std::chrono::steady_clock::now();
+  const auto renderCacheKey = snapshot.GetRenderCacheKey();
+  if (!this->IsUpdateNeeded(renderCacheKey, hmdPose, now)) {
+    static auto& sSkipped = Metrics::GetCounter("SteamVR/SkippedUpdates");
+    sSkipped.Add();
+    return;
+  }
+
   const auto vrLayers = this->GetLayers(snapshot, hmdPose);
 
   auto srv
@@ -399,9 +421,43 @@ void SteamVRKneeboard::Tick() {
       continue;
     }
   }
+
+  mLastUpdate = {
+    .mRenderCacheKey = renderCacheKey,
+    .mHMDPose = hmdPose,
+    .mTime = now,
+  };
+}
+
+bool SteamVRKneeboard::IsUpdateNeeded(
+  size_t renderCacheKey,
+  const Pose& hmdPose,
+  std::chrono::steady_clock::time_point now) const {
+  if (!mLastUpdate) {
+    return true;
+  }
+  const auto& last = *mLastUpdate;
+  if (renderCacheKey != last.mRenderCacheKey) {
+    return true;
+  }
+  if (now - last.mTime >= MaxUpdateInterval) {
+    return true;
+  }
+
+  const auto positionDelta
+    = Vector3::Distance(hmdPose.mPosition, last.mHMDPose.mPosition);
+  if (positionDelta >= MinPositionDelta) {
+    return true;
+  }
+
+  // The angle between two unit quaternions is 2 * acos(|q1 . q2|)
+  const auto dot
+    = std::abs(hmdPose.mOrientation.Dot(last.mHMDPose.mOrientation));
+  return dot < std::cos(MinRotationDelta / 2);
 }
 
 void SteamVRKneeboard::HideAllOverlays() {
+  mLastUpdate = {};
   for (auto& layerState: mLayers) {
     if (layerState.mOverlay && layerState.mVisible) {
       layerState.mVisible = false;
@@ -507,10 +563,19 @@ winrt::Windows::Foundation::IAsyncAction SteamVRKneeboard::Run(
   mGPUFlushEvent.close();
   mGPUFlushEvent = winrt::handle {CreateEventW(nullptr, false, false, nullptr)};
 
+  auto& tickHistogram = Metrics::GetHistogram("SteamVR/Tick");
+  auto& missedFrames = Metrics::GetCounter("SteamVR/MissedFrames");
+
   while (!stopToken.stop_requested()) {
     if (
       IsSteamVRRunning() && vr::VR_IsHmdPresent() && this->InitializeOpenVR()) {
+      const auto tickStart = std::chrono::steady_clock::now();
       this->Tick();
+      const auto tickDuration = std::chrono::steady_clock::now() - tickStart;
+      tickHistogram.Record(tickDuration);
+      if (tickDuration > frameSleep) {
+        missedFrames.Add();
+      }
       if (this->mIVROverlay) {
         this->mIVROverlay->WaitFrameSync(frameSleep.count());
       } else {
@@ -0,0 +1,261 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#include <OpenKneeboard/TraceRecorder.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace OpenKneeboard::TraceRecorder {
+
+namespace {
+
+struct Event {
+  std::chrono::steady_clock::time_point mWhen;
+  const char* mName {nullptr};
+  int64_t mValue {0};
+  EventKind mKind {};
+};
+
+/* Written only by the owning thread; readers only look at the first
+ * `mCount` events, so neither side needs a lock.
+ *
+ * This is append-only rather than a ring, so the exporter never sees an
+ * event being overwritten; once full, further events are counted as
+ * dropped.
+ */
+struct ThreadBuffer {
+  static constexpr size_t Capacity = 64 * 1024;
+
+  ThreadBuffer(uint64_t threadID)
+    : mThreadID(threadID), mEvents(std::make_unique<Event[]>(Capacity)) {
+  }
+
+  const uint64_t mThreadID;
+  std::unique_ptr<Event[]> mEvents;
+  std::atomic<size_t> mCount {0};
+  std::atomic<uint64_t> mDropped {0};
+};
+
+struct State {
+  std::mutex mMutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> mBuffers;
+  std::chrono::steady_clock::time_point mEpoch {
+    std::chrono::steady_clock::now()};
+
+  ~State();
+};
+
+State& GetState() {
+  static State sState;
+  return sState;
+}
+
+ThreadBuffer& GetThreadBuffer() {
+  // Shared with `State`, so events outlive the thread that recorded them
+  thread_local std::shared_ptr<ThreadBuffer> tBuffer;
+  if (!tBuffer) [[unlikely]] {
+    auto& state = GetState();
+    std::unique_lock lock(state.mMutex);
+    tBuffer = std::make_shared<ThreadBuffer>(state.mBuffers.size() + 1);
+    state.mBuffers.push_back(tBuffer);
+  }
+  return *tBuffer;
+}
+
+bool WriteChromeTrace(State&, const std::filesystem::path&);
+
+std::string EscapeJSON(std::string_view in) {
+  std::string out;
+  out.reserve(in.size());
+  for (const auto c: in) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out += std::format("\\u{:04x}", static_cast<unsigned int>(c));
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out;
+}
+
+State::~State() {
+  const auto directory = std::getenv("OPENKNEEBOARD_TRACE_DIRECTORY");
+  if (!(directory && *directory)) {
+    return;
+  }
+  // Each module linking this has its own recorder, so several may write a
+  // trace for the same process
+  std::random_device random;
+  WriteChromeTrace(
+    *this,
+    std::filesystem::path(directory)
+    / std::format(
+      "OpenKneeboard-{:%Y%m%dT%H%M%S}-{:08x}.json",
+      std::chrono::time_point_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now()),
+      random()));
+}
+
+bool StartFromEnvironment() {
+  const auto directory = std::getenv("OPENKNEEBOARD_TRACE_DIRECTORY");
+  if (directory && *directory) {
+    // Make sure the state (and its destructor) exists
+    GetState();
+    return true;
+  }
+  return false;
+}
+
+}// namespace
+
+namespace Detail {
+
+std::atomic_bool gEnabled {
+  OPENKNEEBOARD_HAVE_TRACE_RECORDER && StartFromEnvironment()};
+
+void Record(EventKind kind, const char* name, int64_t value) noexcept {
+  auto& buffer = GetThreadBuffer();
+  const auto index = buffer.mCount.load(std::memory_order_relaxed);
+  if (index >= ThreadBuffer::Capacity) [[unlikely]] {
+    buffer.mDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.mEvents[index] = {
+    .mWhen = std::chrono::steady_clock::now(),
+    .mName = name,
+    .mValue = value,
+    .mKind = kind,
+  };
+  buffer.mCount.store(index + 1, std::memory_order_release);
+}
+
+}// namespace Detail
+
+void Start() {
+  GetState();
+  Detail::gEnabled.store(true);
+}
+
+void Stop() {
+  Detail::gEnabled.store(false);
+}
+
+bool WriteChromeTrace(const std::filesystem::path& path) {
+  return WriteChromeTrace(GetState(), path);
+}
+
+namespace {
+
+bool WriteChromeTrace(State& state, const std::filesystem::path& path) {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    std::unique_lock lock(state.mMutex);
+    buffers = state.mBuffers;
+  }
+
+  std::ofstream f(path, std::ios::binary | std::ios::trunc);
+  if (!f) {
+    return false;
+  }
+
+  f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  const auto separator = [&first]() {
+    if (first) {
+      first = false;
+      return "\n";
+    }
+    return ",\n";
+  };
+
+  for (const auto& buffer: buffers) {
+    const auto count = buffer->mCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+      const auto& event = buffer->mEvents[i];
+      const auto ts = std::chrono::duration<double, std::micro>(
+                        event.mWhen - state.mEpoch)
+                        .count();
+      const auto name = EscapeJSON(event.mName);
+      switch (event.mKind) {
+        case EventKind::Begin:
+        case EventKind::End:
+          f << std::format(
+            "{}{{\"name\":\"{}\",\"ph\":\"{}\",\"ts\":{:.3f},\"pid\":1,"
+            "\"tid\":{}}}",
+            separator(),
+            name,
+            event.mKind == EventKind::Begin ? 'B' : 'E',
+            ts,
+            buffer->mThreadID);
+          break;
+        case EventKind::Instant:
+          f << std::format(
+            "{}{{\"name\":\"{}\",\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3f},"
+            "\"pid\":1,\"tid\":{}}}",
+            separator(),
+            name,
+            ts,
+            buffer->mThreadID);
+          break;
+        case EventKind::Counter:
+          f << std::format(
+            "{}{{\"name\":\"{}\",\"ph\":\"C\",\"ts\":{:.3f},\"pid\":1,"
+            "\"tid\":{},\"args\":{{\"value\":{}}}}}",
+            separator(),
+            name,
+            ts,
+            buffer->mThreadID,
+            event.mValue);
+          break;
+      }
+    }
+
+    const auto dropped = buffer->mDropped.load(std::memory_order_relaxed);
+    if (dropped) {
+      f << std::format(
+        "{}{{\"name\":\"TraceRecorder dropped events\",\"ph\":\"C\","
+        "\"ts\":0,\"pid\":1,\"tid\":{},\"args\":{{\"value\":{}}}}}",
+        separator(),
+        buffer->mThreadID,
+        dropped);
+    }
+  }
+  f << "\n]}\n";
+  return f.good();
+}
+
+}// namespace
+
+}// namespace OpenKneeboard::TraceRecorder
@@ -27,36 +27,24 @@ using namespace DirectX::SimpleMath;
 
 namespace OpenKneeboard {
 
-VRKneeboard::Pose VRKneeboard::GetKneeboardPose(
-  const VRRenderConfig& vr,
-  const SHM::LayerConfig& layer,
-  const Pose& hmdPose) {
-  if (!mEyeHeight) {
-    mEyeHeight = {hmdPose.mPosition.y};
-  }
+VRKneeboard::Matrix VRKneeboard::GetKneeboardTransform(
+  const SHM::LayerConfig& layer) const {
   const auto& pose = layer.mVR.mPose;
-  this->MaybeRecenter(vr, hmdPose);
-  auto matrix = Matrix::CreateRotationX(pose.mRX)
-    * Matrix::CreateRotationY(pose.mRY) * Matrix::CreateRotationZ(pose.mRZ)
+  return Matrix::CreateRotationX(pose.mRX) * Matrix::CreateRotationY(pose.mRY)
+    * Matrix::CreateRotationZ(pose.mRZ)
     * Matrix::CreateTranslation({
       pose.mX,
       pose.mEyeY + *mEyeHeight,
       pose.mZ,
     })
     * mRecenter;
-
-  return {
-    .mPosition = matrix.Translation(),
-    .mOrientation = Quaternion::CreateFromRotationMatrix(matrix),
-  };
 }
 
 Vector2 VRKneeboard::GetKneeboardSize(
   const SHM::Config& config,
   const SHM::LayerConfig& layer,
-  bool isLookingAtKneeboard) {
-  const auto sizes = this->GetSizes(config.mVR, layer);
-
+  const Sizes& sizes,
+  bool isLookingAtKneeboard) const {
   return config.mVR.mForceZoom
       || (isLookingAtKneeboard && layer.mVR.mEnableGazeZoom)
     ? sizes.mZoomedSize
@@ -106,13 +94,29 @@ void VRKneeboard::Recenter(const VRRenderConfig& vr, const Pose& hmdPose) {
 std::vector<VRKneeboard::Layer> VRKneeboard::GetLayers(
   const SHM::Snapshot& snapshot,
   const Pose& hmdPose) {
+  std::vector<Layer> ret;
+  this->GetLayers(snapshot, hmdPose, ret);
+  return ret;
+}
+
+void VRKneeboard::GetLayers(
+  const SHM::Snapshot& snapshot,
+  const Pose& hmdPose,
+  std::vector<Layer>& ret) {
   if (!mEyeHeight) {
     mEyeHeight = {hmdPose.mPosition.y};
   }
 
+  const auto config = snapshot.GetConfig();
+  this->MaybeRecenter(config.mVR, hmdPose);
+  const auto renderCacheKey = snapshot.GetRenderCacheKey();
+  const Ray gaze(
+    hmdPose.mPosition,
+    Vector3::Transform(Vector3::Forward, hmdPose.mOrientation));
+
   const auto totalLayers = snapshot.GetLayerCount();
 
-  std::vector<Layer> ret;
+  ret.clear();
   ret.reserve(totalLayers);
   for (uint32_t layerIndex = 0; layerIndex < totalLayers; ++layerIndex) {
     const auto layerConfig = snapshot.GetLayerConfig(layerIndex);
@@ -121,10 +125,10 @@ std::vector<VRKneeboard::Layer> VRKneeboard::GetLayers(
     }
 
     ret.push_back(Layer {
-      layerConfig, GetRenderParameters(snapshot, *layerConfig, hmdPose)});
+      layerConfig,
+      GetRenderParameters(config, renderCacheKey, *layerConfig, gaze)});
   }
 
-  const auto config = snapshot.GetConfig();
   if (config.mVR.mEnableGazeInputFocus) {
     const auto activeLayerID = config.mGlobalInputLayerID;
 
@@ -138,20 +142,19 @@ std::vector<VRKneeboard::Layer> VRKneeboard::GetLayers(
       }
     }
   }
-
-  return ret;
 }
 
 VRKneeboard::RenderParameters VRKneeboard::GetRenderParameters(
-  const SHM::Snapshot& snapshot,
+  const SHM::Config& config,
+  size_t renderCacheKey,
   const SHM::LayerConfig& layer,
-  const Pose& hmdPose) {
-  auto config = snapshot.GetConfig();
-  const auto kneeboardPose = this->GetKneeboardPose(config.mVR, layer, hmdPose);
+  const Ray& gaze) {
+  const auto transform = this->GetKneeboardTransform(layer);
+  const auto sizes = this->GetSizes(config.mVR, layer);
   const auto isLookingAtKneeboard
-    = this->IsLookingAtKneeboard(config, layer, hmdPose, kneeboardPose);
+    = this->IsLookingAtKneeboard(layer, sizes, gaze, transform);
 
-  auto cacheKey = snapshot.GetRenderCacheKey();
+  auto cacheKey = renderCacheKey;
   if (isLookingAtKneeboard) {
     cacheKey |= 1;
   } else {
@@ -159,9 +162,12 @@ VRKneeboard::RenderParameters VRKneeboard::GetRenderParameters(
   }
 
   return {
-    .mKneeboardPose = kneeboardPose,
+    .mKneeboardPose = {
+      .mPosition = transform.Translation(),
+      .mOrientation = Quaternion::CreateFromRotationMatrix(transform),
+    },
     .mKneeboardSize
-    = this->GetKneeboardSize(config, layer, isLookingAtKneeboard),
+    = this->GetKneeboardSize(config, layer, sizes, isLookingAtKneeboard),
     .mKneeboardOpacity = isLookingAtKneeboard ? layer.mVR.mOpacity.mGaze
                                               : layer.mVR.mOpacity.mNormal,
     .mCacheKey = cacheKey,
@@ -170,10 +176,10 @@ VRKneeboard::RenderParameters VRKneeboard::GetRenderParameters(
 }
 
 bool VRKneeboard::IsLookingAtKneeboard(
-  const SHM::Config& config,
   const SHM::LayerConfig& layer,
-  const Pose& hmdPose,
-  const Pose& kneeboardPose) {
+  const Sizes& sizes,
+  const Ray& gaze,
+  const Matrix& kneeboardTransform) {
   auto& isLookingAtKneeboard = mIsLookingAtKneeboard[layer.mLayerID];
 
   if (
@@ -182,19 +188,14 @@ bool VRKneeboard::IsLookingAtKneeboard(
     return false;
   }
 
-  const auto sizes = this->GetSizes(config.mVR, layer);
   auto currentSize
     = isLookingAtKneeboard ? sizes.mZoomedSize : sizes.mNormalSize;
 
   currentSize.x *= layer.mVR.mGazeTargetScale.mHorizontal;
   currentSize.y *= layer.mVR.mGazeTargetScale.mVertical;
 
-  isLookingAtKneeboard = RayIntersectsRect(
-    hmdPose.mPosition,
-    hmdPose.mOrientation,
-    kneeboardPose.mPosition,
-    kneeboardPose.mOrientation,
-    currentSize);
+  isLookingAtKneeboard
+    = RayIntersectsRect(gaze, kneeboardTransform, currentSize);
 
   return isLookingAtKneeboard;
 }
@@ -28,7 +28,10 @@
 
 #include <Windows.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <optional>
 
 namespace OpenKneeboard {
@@ -36,8 +39,10 @@ namespace OpenKneeboard {
 static std::wstring GetDPrintResourceName(std::wstring_view key) {
   // v2: explicit size added
   // v3: compatibility for 32-bit sender and 64-bit receiver
+  // v4: multi-message ring buffer instead of a single message
+  // v5: smaller ring, and detection of torn messages
   return std::format(
-    L"{}.dprint.v3.{}", OpenKneeboard::ProjectReverseDomainW, key);
+    L"{}.dprint.v5.{}", OpenKneeboard::ProjectReverseDomainW, key);
 }
 
 #define IPC_RESOURCE_NAME_FUNC(resource) \
@@ -49,76 +54,183 @@ static std::wstring GetDPrintResourceName(std::wstring_view key) {
     sCache = GetDPrintResourceName(L#resource); \
     return sCache; \
   }
-IPC_RESOURCE_NAME_FUNC(BufferReadyEvent)
 IPC_RESOURCE_NAME_FUNC(DataReadyEvent)
 IPC_RESOURCE_NAME_FUNC(Mapping)
 IPC_RESOURCE_NAME_FUNC(Mutex)
 #undef IPC_RESOURCE_NAME_FUNC
 
+/* If you change this structure, you *MUST* also change the version
+ * in `GetDPrintResourceName()`
+ *
+ * USE DEFINED-SIZE FIELDS ONLY - THIS STRUCT MUST BE
+ * COMPATIBLE BETWEEN 32-BIT AND 64-BIT BINARIES.
+ *
+ * Each slot's sequence number is `index` when it is free for the writer
+ * claiming `index`, and `index + 1` once that writer has published it; the
+ * receiver then sets it to `index + Capacity`, freeing it for the next lap.
+ *
+ * A writer that the receiver skipped as stalled may still be writing when the
+ * slot is reused; writers store their index in `mWriterIndex` before copying
+ * their message, so the receiver can tell if another writer interfered.
+ */
+struct DPrintRingSlot {
+  alignas(8) uint64_t mSequence {};
+  uint64_t mWriterIndex {};
+  DPrintMessage mMessage {};
+};
+
+struct DPrintRing {
+  // The receiver drains the ring whenever it's signalled, so this only needs
+  // to absorb bursts, e.g. the few dozen lines logged while a game loads;
+  // every process with a hook maps it, so keep it small (~256KiB)
+  static constexpr uint64_t Capacity = 64;
+  static_assert((Capacity & (Capacity - 1)) == 0);
+
+  alignas(64) uint64_t mWriteIndex {};
+  alignas(64) uint64_t mReadIndex {};
+  uint64_t mDroppedCount {};
+  uint64_t mReceiverActive {};
+
+  alignas(64) DPrintRingSlot mSlots[Capacity];
+};
+static_assert(std::is_standard_layout_v<DPrintRing>);
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free);
+
 static DPrintSettings gSettings;
 static std::wstring gPrefixW;
 
 static DPrintMessageHeader gIPCMessageHeader;
 
-static void WriteIPCMessage(std::wstring_view message) {
-  {
-    winrt::handle mutex {
-      OpenMutexW(SYNCHRONIZE, false, GetDPrintMutexName().data())};
-    if (!mutex) {
-      return;
-    }
+namespace {
+
+/* Keeps the ring mapped for the life of the process, so writing a message
+ * is a copy and an event signal, instead of opening and mapping the shared
+ * resources each time.
+ *
+ * Never destroyed: other threads may still be writing during static
+ * destruction, and the OS cleans up when the process exits.
+ */
+class DPrintWriter final {
+ public:
+  void Write(std::wstring_view message);
+
+ private:
+  static constexpr uint64_t RetryIntervalMS = 1000;
+
+  std::mutex mMutex;
+  std::atomic<DPrintRing*> mRing {nullptr};
+  winrt::handle mMapping;
+  winrt::handle mDataReadyEvent;
+  uint64_t mLastAttemptAt {0};
+
+  DPrintRing* GetRing();
+};
+
+DPrintRing* DPrintWriter::GetRing() {
+  if (auto ring = mRing.load(std::memory_order_acquire)) {
+    return ring;
   }
 
-  winrt::handle bufferReadyEvent {
-    OpenEventW(SYNCHRONIZE, false, GetDPrintBufferReadyEventName().data())};
-  if (!bufferReadyEvent) {
-    OPENKNEEBOARD_BREAK;
-    return;
+  std::unique_lock lock(mMutex);
+  if (auto ring = mRing.load(std::memory_order_acquire)) {
+    return ring;
+  }
+
+  // Don't hammer the kernel if OpenKneeboard isn't running
+  const auto now = GetTickCount64();
+  if (mLastAttemptAt && (now - mLastAttemptAt) < RetryIntervalMS) {
+    return nullptr;
+  }
+  mLastAttemptAt = now;
+
+  winrt::handle mapping {OpenFileMappingW(
+    FILE_MAP_READ | FILE_MAP_WRITE, false, GetDPrintMappingName().data())};
+  if (!mapping) {
+    return nullptr;
   }
   winrt::handle dataReadyEvent {OpenEventW(
-    SYNCHRONIZE | EVENT_MODIFY_STATE,
-    false,
-    GetDPrintDataReadyEventName().data())};
+    EVENT_MODIFY_STATE, false, GetDPrintDataReadyEventName().data())};
   if (!dataReadyEvent) {
+    return nullptr;
+  }
+
+  auto ring = reinterpret_cast<DPrintRing*>(MapViewOfFile(
+    mapping.get(), FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(DPrintRing)));
+  if (!ring) {
     OPENKNEEBOARD_BREAK;
-    return;
+    return nullptr;
   }
 
-  if (WaitForSingleObject(bufferReadyEvent.get(), 100) == WAIT_TIMEOUT) {
+  mMapping = std::move(mapping);
+  mDataReadyEvent = std::move(dataReadyEvent);
+  mRing.store(ring, std::memory_order_release);
+  return ring;
+}
+
+void DPrintWriter::Write(std::wstring_view message) {
+  auto ring = this->GetRing();
+  if (!ring) {
     return;
   }
-
-  auto mapping = Win32::CreateFileMappingW(
-    INVALID_HANDLE_VALUE,
-    nullptr,
-    PAGE_READWRITE,
-    0,
-    sizeof(DPrintMessage),
-    GetDPrintMappingName().data());
-  if (!mapping) {
-    OPENKNEEBOARD_BREAK;
+  if (!std::atomic_ref(ring->mReceiverActive)
+         .load(std::memory_order_acquire)) {
     return;
   }
 
-  void* shm
-    = MapViewOfFile(mapping.get(), FILE_MAP_WRITE, 0, 0, sizeof(DPrintMessage));
-  if (!shm) {
-    OPENKNEEBOARD_BREAK;
-    return;
+  std::atomic_ref writeIndex(ring->mWriteIndex);
+  auto index = writeIndex.load(std::memory_order_relaxed);
+  DPrintRingSlot* slot = nullptr;
+  while (true) {
+    slot = &ring->mSlots[index % DPrintRing::Capacity];
+    const auto sequence
+      = std::atomic_ref(slot->mSequence).load(std::memory_order_acquire);
+    const auto delta = static_cast<int64_t>(sequence - index);
+    if (delta == 0) {
+      if (writeIndex.compare_exchange_weak(
+            index, index + 1, std::memory_order_relaxed)) {
+        break;
+      }
+      continue;
+    }
+    if (delta < 0) {
+      // Full; never block the caller, which may well be a game's render
+      // thread
+      std::atomic_ref(ring->mDroppedCount)
+        .fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    index = writeIndex.load(std::memory_order_relaxed);
   }
 
-  memset(shm, 0, sizeof(DPrintMessage));
+  std::atomic_ref(slot->mWriterIndex).store(index, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  auto& out = slot->mMessage;
+  out.mHeader = gIPCMessageHeader;
+  const auto length = std::min<size_t>(
+    message.size(), static_cast<size_t>(DPrintMessage::MaxMessageLength));
+  memcpy(out.mMessage, message.data(), length * sizeof(message[0]));
+  out.mMessageLength = length;
+
+  auto expected = index;
+  if (!std::atomic_ref(slot->mSequence)
+         .compare_exchange_strong(
+           expected,
+           index + 1,
+           std::memory_order_release,
+           std::memory_order_relaxed)) {
+    // The receiver gave up waiting for us, and counted this as dropped
+    return;
+  }
+  SetEvent(mDataReadyEvent.get());
+}
 
-  auto messageSHM = reinterpret_cast<DPrintMessage*>(shm);
-  messageSHM->mHeader = gIPCMessageHeader;
-  memcpy(
-    messageSHM->mMessage, message.data(), message.size() * sizeof(message[0]));
-  messageSHM->mMessageLength = message.size();
+}// namespace
 
-  FlushViewOfFile(shm, sizeof(DPrintMessage));
-  UnmapViewOfFile(shm);
-  mapping = {};
-  SetEvent(dataReadyEvent.get());
+static void WriteIPCMessage(std::wstring_view message) {
+  // Intentionally leaked; see `DPrintWriter`
+  static auto sWriter = new DPrintWriter();
+  sWriter->Write(message);
 }
 
 static bool IsDebugStreamEnabledInRegistry() {
@@ -214,10 +326,13 @@ DPrintReceiver::DPrintReceiver() {
     if (mUsable) {
       return;
     }
+    if (mRing) {
+      UnmapViewOfFile(mRing);
+      mRing = nullptr;
+    }
     mMutex = {};
     mMapping = {};
     mDataReadyEvent = {};
-    mBufferReadyEvent = {};
   });
 
   mMutex = Win32::CreateMutexW(nullptr, true, GetDPrintMutexName().data());
@@ -235,19 +350,15 @@ DPrintReceiver::DPrintReceiver() {
     nullptr,
     PAGE_READWRITE,
     0,
-    sizeof(DPrintMessage),
+    sizeof(DPrintRing),
     GetDPrintMappingName().data());
   if (!mMapping) {
     OPENKNEEBOARD_BREAK;
     return;
   }
-
-  mBufferReadyEvent = Win32::CreateEventW(
-    nullptr, false, false, GetDPrintBufferReadyEventName().data());
-  if (!mBufferReadyEvent) {
-    OPENKNEEBOARD_BREAK;
-    return;
-  }
+  // Writers keep the mapping open, so it may outlive a previous receiver; if
+  // so, carry on from where that receiver left off.
+  const auto isNewRing = (GetLastError() != ERROR_ALREADY_EXISTS);
 
   mDataReadyEvent = Win32::CreateEventW(
     nullptr, false, false, GetDPrintDataReadyEventName().data());
@@ -256,23 +367,35 @@ DPrintReceiver::DPrintReceiver() {
     return;
   }
 
-  mSHM = reinterpret_cast<DPrintMessage*>(MapViewOfFile(
+  mRing = reinterpret_cast<DPrintRing*>(MapViewOfFile(
     mMapping.get(),
     FILE_MAP_READ | FILE_MAP_WRITE,
     0,
     0,
-    sizeof(DPrintMessage)));
-  if (!mSHM) {
+    sizeof(DPrintRing)));
+  if (!mRing) {
     OPENKNEEBOARD_BREAK;
     return;
   }
 
+  if (isNewRing) {
+    for (uint64_t i = 0; i < DPrintRing::Capacity; ++i) {
+      std::atomic_ref(mRing->mSlots[i].mSequence)
+        .store(i, std::memory_order_relaxed);
+    }
+  }
+  mReportedDropped = std::atomic_ref(mRing->mDroppedCount).load();
+  std::atomic_ref(mRing->mReceiverActive)
+    .store(1, std::memory_order_release);
+
   mUsable = true;
 }
 
 DPrintReceiver::~DPrintReceiver() {
-  if (mSHM) {
-    UnmapViewOfFile(mSHM);
+  if (mRing) {
+    std::atomic_ref(mRing->mReceiverActive)
+      .store(0, std::memory_order_release);
+    UnmapViewOfFile(mRing);
   }
 }
 
@@ -280,6 +403,79 @@ bool DPrintReceiver::IsUsable() const {
   return mUsable;
 }
 
+void DPrintReceiver::Drain() {
+  // If a writer claims a slot then dies before publishing it, skip it after
+  // this long rather than blocking the ring forever
+  constexpr auto StalledSlotTimeout = std::chrono::seconds(1);
+
+  std::atomic_ref readIndex(mRing->mReadIndex);
+  while (true) {
+    const auto index = readIndex.load(std::memory_order_relaxed);
+    auto& slot = mRing->mSlots[index % DPrintRing::Capacity];
+    std::atomic_ref sequence(slot.mSequence);
+
+    if (sequence.load(std::memory_order_acquire) == index + 1) {
+      const DPrintMessage message = slot.mMessage;
+      // Re-validate after copying
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const auto writerIndex
+        = std::atomic_ref(slot.mWriterIndex).load(std::memory_order_relaxed);
+      const auto isTorn = (writerIndex != index)
+        || (sequence.load(std::memory_order_relaxed) != index + 1);
+
+      sequence.store(index + DPrintRing::Capacity, std::memory_order_release);
+      readIndex.store(index + 1, std::memory_order_relaxed);
+      mStalledSince = {};
+
+      if (isTorn) {
+        // A stalled writer that we skipped wrote to the slot while we were
+        // copying it
+        std::atomic_ref(mRing->mDroppedCount)
+          .fetch_add(1, std::memory_order_relaxed);
+      } else {
+        this->OnMessage(message);
+      }
+      continue;
+    }
+
+    if (
+      std::atomic_ref(mRing->mWriteIndex).load(std::memory_order_relaxed)
+      <= index) {
+      // Empty
+      mStalledSince = {};
+      break;
+    }
+
+    // Claimed, but not yet published
+    const auto now = std::chrono::steady_clock::now();
+    if (!mStalledSince) {
+      mStalledSince = now;
+      break;
+    }
+    if (now - *mStalledSince < StalledSlotTimeout) {
+      break;
+    }
+    auto expected = index;
+    if (sequence.compare_exchange_strong(
+          expected,
+          index + DPrintRing::Capacity,
+          std::memory_order_acq_rel)) {
+      std::atomic_ref(mRing->mDroppedCount)
+        .fetch_add(1, std::memory_order_relaxed);
+      readIndex.store(index + 1, std::memory_order_relaxed);
+      mStalledSince = {};
+    }
+  }
+
+  const auto dropped = std::atomic_ref(mRing->mDroppedCount).load();
+  if (dropped != mReportedDropped) {
+    dprintf(
+      "dprint buffer overflowed: {} messages dropped",
+      dropped - mReportedDropped);
+    mReportedDropped = dropped;
+  }
+}
+
 void DPrintReceiver::Run(std::stop_token stopToken) {
   if (!this->IsUsable()) {
     return;
@@ -295,28 +491,23 @@ void DPrintReceiver::Run(std::stop_token stopToken) {
   };
 
   while (true) {
-    // Unset canary
-    memset(mSHM, 0xcf, sizeof(DPrintMessage));
-
-    ResetEvent(mDataReadyEvent.get());
-    SetEvent(mBufferReadyEvent.get());
+    this->Drain();
 
+    // Writers don't wait for us, so a single wake may cover many messages;
+    // the timeout is only needed to recover from stalled slots.
     const auto result = WaitForMultipleObjects(
       sizeof(handles) / sizeof(handles[0]),
       handles,
       /* all = */ false,
-      /* ms = */ INFINITE);
+      /* ms = */ mStalledSince ? 100 : INFINITE);
 
     if (stopToken.stop_requested()) {
-      ResetEvent(mBufferReadyEvent.get());
       return;
     }
 
-    if (result != WAIT_OBJECT_0) {
+    if (result != WAIT_OBJECT_0 && result != WAIT_TIMEOUT) {
       OPENKNEEBOARD_BREAK;
     }
-
-    this->OnMessage(*mSHM);
   }
 }
 
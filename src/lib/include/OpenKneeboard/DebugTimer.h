@@ -19,11 +19,18 @@
  */
 #pragma once
 
-#include <chrono>
-#include <string>
+#include <OpenKneeboard/Metrics.h>
+
+#include <optional>
+#include <string_view>
 
 namespace OpenKneeboard {
 
+/** Records the time until `End()` or destruction in the named histogram.
+ *
+ * Timings are aggregated and periodically logged by `Metrics`, instead of
+ * logging each one.
+ */
 class DebugTimer {
  public:
   DebugTimer(std::string_view label);
@@ -32,10 +39,7 @@ class DebugTimer {
   void End();
 
  private:
-  std::string mLabel;
-  std::chrono::steady_clock::time_point mStart;
-
-  bool mFinished = false;
+  std::optional<Metrics::ScopedTimer> mTimer;
 };
 
 }// namespace OpenKneeboard
@@ -23,6 +23,9 @@
 
 namespace OpenKneeboard {
 
+/** Returns true if only one of the files exists, or if both exist but have
+ * different contents.
+ */
 bool FilesDiffer(
   const std::filesystem::path& a,
   const std::filesystem::path& b);
@@ -21,6 +21,8 @@
 
 #include <shims/filesystem>
 
+#include <memory>
+
 namespace OpenKneeboard::Filesystem {
 
 /** Differs from std::filesystem::temp_directory_path() in that
@@ -48,21 +50,39 @@ class ScopedDeleter {
   std::filesystem::path mPath;
 };
 
-class TemporaryCopy final {
+/** A read-only point-in-time snapshot of a file in the temporary directory.
+ *
+ * This allows the original file to be modified or deleted while the
+ * snapshot is in use.
+ *
+ * Snapshots are deduplicated: if the source file has not changed since an
+ * existing snapshot was taken, `Create()` returns the existing snapshot.
+ */
+class TemporarySnapshot final {
  public:
-  TemporaryCopy(
-    const std::filesystem::path& source,
-    const std::filesystem::path& destination);
-  ~TemporaryCopy() noexcept;
+  enum class Strategy {
+    /// Copy-on-write clone of the file extents; requires ReFS or similar
+    BlockClone,
+    /// Full copy of the file data
+    Copy,
+  };
 
-  TemporaryCopy() = delete;
-  TemporaryCopy(const TemporaryCopy&) = delete;
-  TemporaryCopy& operator=(const TemporaryCopy&) = delete;
+  static std::shared_ptr<TemporarySnapshot> Create(
+    const std::filesystem::path& source);
+  ~TemporarySnapshot() noexcept;
+
+  TemporarySnapshot() = delete;
+  TemporarySnapshot(const TemporarySnapshot&) = delete;
+  TemporarySnapshot& operator=(const TemporarySnapshot&) = delete;
 
   std::filesystem::path GetPath() const noexcept;
+  Strategy GetStrategy() const noexcept;
 
  private:
-  std::filesystem::path mCopy;
+  TemporarySnapshot(const std::filesystem::path& path, Strategy);
+
+  std::filesystem::path mPath;
+  Strategy mStrategy;
 };
 
 }// namespace OpenKneeboard::Filesystem
@@ -0,0 +1,124 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+/** Named histograms, counters and gauges.
+ *
+ * Recording is lock-free, and safe from any thread; looking up a metric by
+ * name takes a lock, so keep the reference, e.g.:
+ *
+ *   static auto& sHistogram = Metrics::GetHistogram("Foo");
+ *   sHistogram.Record(duration);
+ *
+ * Metrics that have changed are periodically written to the log, with
+ * percentiles for histograms.
+ */
+namespace OpenKneeboard::Metrics {
+
+/** HDR-style log-linear histogram of durations.
+ *
+ * Each power of two is split into `SubBuckets` linear buckets, so values are
+ * kept to within ~6%, from nanoseconds to years, in a fixed-size array.
+ */
+class Histogram final {
+ public:
+  struct Summary {
+    uint64_t mCount {};
+    std::chrono::nanoseconds mTotal {};
+    std::chrono::nanoseconds mMax {};
+    std::chrono::nanoseconds mP50 {};
+    std::chrono::nanoseconds mP90 {};
+    std::chrono::nanoseconds mP99 {};
+  };
+
+  void Record(std::chrono::nanoseconds) noexcept;
+  Summary GetSummary() const;
+  uint64_t GetCount() const noexcept;
+
+ private:
+  static constexpr size_t SubBucketBits = 4;
+  static constexpr size_t SubBuckets = 1 << SubBucketBits;
+  static constexpr size_t BucketCount = SubBuckets * (65 - SubBucketBits);
+
+  static size_t GetBucketIndex(uint64_t) noexcept;
+  static uint64_t GetBucketMidpoint(size_t);
+
+  std::array<std::atomic<uint64_t>, BucketCount> mBuckets {};
+  std::atomic<uint64_t> mCount {0};
+  std::atomic<uint64_t> mTotal {0};
+  std::atomic<uint64_t> mMax {0};
+};
+
+class Counter final {
+ public:
+  inline void Add(uint64_t value = 1) noexcept {
+    mValue.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  inline uint64_t Get() const noexcept {
+    return mValue.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> mValue {0};
+};
+
+class Gauge final {
+ public:
+  inline void Set(int64_t value) noexcept {
+    mValue.store(value, std::memory_order_relaxed);
+  }
+
+  inline int64_t Get() const noexcept {
+    return mValue.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> mValue {0};
+};
+
+Histogram& GetHistogram(std::string_view name);
+Counter& GetCounter(std::string_view name);
+Gauge& GetGauge(std::string_view name);
+
+/// Log all metrics that have changed since the last snapshot
+void LogSnapshot();
+
+/// Records its lifetime into a histogram
+class ScopedTimer final {
+ public:
+  ScopedTimer(Histogram&);
+  ~ScopedTimer();
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Histogram& mHistogram;
+  std::chrono::steady_clock::time_point mStart;
+};
+
+}// namespace OpenKneeboard::Metrics
@@ -30,4 +30,15 @@ bool RayIntersectsRect(
   const DirectX::SimpleMath::Quaternion& rectOrientation,
   const DirectX::SimpleMath::Vector2& rectSize);
 
+/** As above, but with the ray direction and rectangle transform precomputed.
+ *
+ * This is cheaper when testing one ray against several rectangles.
+ *
+ * `rectTransform` must only contain a rotation and translation.
+ */
+bool RayIntersectsRect(
+  const DirectX::SimpleMath::Ray& ray,
+  const DirectX::SimpleMath::Matrix& rectTransform,
+  const DirectX::SimpleMath::Vector2& rectSize);
+
 }
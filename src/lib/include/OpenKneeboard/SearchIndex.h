@@ -0,0 +1,83 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace OpenKneeboard {
+
+/** Case-insensitive search over a fixed list of candidates.
+ *
+ * Candidates are case-folded and tokenized once when added, so each search
+ * only folds the query. Each space-separated word of the query must match
+ * one of the candidate's fields as, in descending score order:
+ *
+ * - a prefix of the field
+ * - a prefix of a token within the field, e.g. a path component
+ * - a substring
+ * - the initials of successive tokens, e.g. 'msfs' for
+ *   'Microsoft Flight Simulator'
+ *
+ * If a query extends the previous query - as it usually does while typing -
+ * only the previous matches are searched.
+ *
+ * Not thread-safe.
+ */
+class SearchIndex final {
+ public:
+  struct Match {
+    size_t mIndex {};
+    uint32_t mScore {};
+  };
+
+  /// @returns the index of the new candidate
+  size_t Add(std::initializer_list<std::string_view> fields);
+  size_t GetSize() const noexcept;
+
+  /** Matches, sorted by descending score then by index.
+   *
+   * An empty query matches every candidate.
+   */
+  std::vector<Match> Search(std::string_view query) const;
+
+ private:
+  struct Field {
+    std::string mFolded;
+    // First character of each token
+    std::string mInitials;
+    std::vector<size_t> mTokenStarts;
+  };
+  struct Candidate {
+    std::vector<Field> mFields;
+  };
+
+  std::vector<Candidate> mCandidates;
+
+  mutable std::string mLastQuery;
+  mutable std::vector<Match> mLastMatches;
+
+  static uint32_t ScoreWord(const Field&, std::string_view word) noexcept;
+};
+
+}// namespace OpenKneeboard
@@ -31,6 +31,7 @@
 
 #include <directxtk/SimpleMath.h>
 
+#include <chrono>
 #include <memory>
 #include <optional>
 #include <stop_token>
@@ -59,6 +60,24 @@ class SteamVRKneeboard final : private VRKneeboard {
   void Reset();
   void HideAllOverlays();
 
+  struct LastUpdate {
+    size_t mRenderCacheKey {};
+    Pose mHMDPose;
+    std::chrono::steady_clock::time_point mTime;
+  };
+  /// Inputs to the last full update, if the overlays are up to date
+  std::optional<LastUpdate> mLastUpdate;
+
+  /** Whether anything that can affect the overlays has changed since
+   * the last update.
+   *
+   * The overlay transforms are in world space, so small head movements only
+   * matter if they can change what the user is looking at. */
+  bool IsUpdateNeeded(
+    size_t renderCacheKey,
+    const Pose& hmdPose,
+    std::chrono::steady_clock::time_point now) const;
+
   // Superclass of DXResources, but naming it like this for
   // consistency/familiarity in the code
   D3D11Resources mDXR;
@@ -0,0 +1,104 @@
+/*
+ * OpenKneeboard
+ *
+ * Copyright (C) 2022 Fred Emmott <fred@fredemmott.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301,
+ * USA.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+
+#ifndef OPENKNEEBOARD_HAVE_TRACE_RECORDER
+#define OPENKNEEBOARD_HAVE_TRACE_RECORDER 0
+#endif
+
+/** In-process recorder for the `OPENKNEEBOARD_TraceLogging*` macros.
+ *
+ * TraceLogging/ETW traces can only be viewed with WPA; this keeps a copy of
+ * scopes, instant events and counters in per-thread buffers, and exports them
+ * as Chrome Trace Event JSON, for chrome://tracing or https://ui.perfetto.dev
+ *
+ * - compile-time: `WITH_TRACE_RECORDER` CMake option
+ * - runtime: set the `OPENKNEEBOARD_TRACE_DIRECTORY` environment variable to
+ *   write a trace when the process (or DLL) exits, or call `Start()` and
+ *   `WriteChromeTrace()`
+ *
+ * This is standard C++ only, with no Windows dependencies.
+ */
+namespace OpenKneeboard::TraceRecorder {
+
+enum class EventKind : uint8_t {
+  Begin,
+  End,
+  Instant,
+  Counter,
+};
+
+namespace Detail {
+extern std::atomic_bool gEnabled;
+void Record(EventKind, const char* name, int64_t value) noexcept;
+}// namespace Detail
+
+inline bool IsEnabled() noexcept {
+#if OPENKNEEBOARD_HAVE_TRACE_RECORDER
+  return Detail::gEnabled.load(std::memory_order_relaxed);
+#else
+  return false;
+#endif
+}
+
+/** `name` must be a string literal, or otherwise outlive the recorder.
+ *
+ * @returns true if the scope was recorded, and `EndScope()` must be called.
+ */
+inline bool BeginScope(const char* name) noexcept {
+  if (!IsEnabled()) [[likely]] {
+    return false;
+  }
+  Detail::Record(EventKind::Begin, name, 0);
+  return true;
+}
+
+/// Call if and only if `BeginScope()` returned true.
+inline void EndScope(const char* name) noexcept {
+  Detail::Record(EventKind::End, name, 0);
+}
+
+inline void Instant(const char* name) noexcept {
+  if (IsEnabled()) [[unlikely]] {
+    Detail::Record(EventKind::Instant, name, 0);
+  }
+}
+
+inline void Counter(const char* name, int64_t value) noexcept {
+  if (IsEnabled()) [[unlikely]] {
+    Detail::Record(EventKind::Counter, name, value);
+  }
+}
+
+void Start();
+void Stop();
+
+/** Write all events recorded so far.
+ *
+ * Safe to call while other threads are recording; events recorded during the
+ * export may or may not be included.
+ */
+bool WriteChromeTrace(const std::filesystem::path&);
+
+}// namespace OpenKneeboard::TraceRecorder
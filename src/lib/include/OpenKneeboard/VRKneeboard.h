@@ -53,12 +53,14 @@ class VRKneeboard {
 
  protected:
   std::vector<Layer> GetLayers(const SHM::Snapshot&, const Pose& hmdPose);
+  /// Replaces the contents of `layers`, reusing its storage
+  void GetLayers(
+    const SHM::Snapshot&,
+    const Pose& hmdPose,
+    std::vector<Layer>& layers);
 
  private:
-  RenderParameters GetRenderParameters(
-    const SHM::Snapshot&,
-    const SHM::LayerConfig&,
-    const Pose& hmdPose);
+  using Ray = DirectX::SimpleMath::Ray;
 
   struct Sizes {
     Vector2 mNormalSize;
@@ -70,21 +72,27 @@ class VRKneeboard {
   std::unordered_map<uint64_t, bool> mIsLookingAtKneeboard;
   std::optional<float> mEyeHeight;
 
-  Pose GetKneeboardPose(
-    const VRRenderConfig& vr,
+  /** The config, cache key, and gaze ray are the same for every layer, so
+   * are computed once per frame by the caller. */
+  RenderParameters GetRenderParameters(
+    const SHM::Config&,
+    size_t renderCacheKey,
     const SHM::LayerConfig&,
-    const Pose& hmdPose);
+    const Ray& gaze);
+
+  Matrix GetKneeboardTransform(const SHM::LayerConfig&) const;
 
   Vector2 GetKneeboardSize(
     const SHM::Config& config,
     const SHM::LayerConfig&,
-    bool isLookingAtKneeboard);
+    const Sizes&,
+    bool isLookingAtKneeboard) const;
 
   bool IsLookingAtKneeboard(
-    const SHM::Config&,
     const SHM::LayerConfig&,
-    const Pose& hmdPose,
-    const Pose& kneeboardPose);
+    const Sizes&,
+    const Ray& gaze,
+    const Matrix& kneeboardTransform);
 
   Sizes GetSizes(const VRRenderConfig&, const SHM::LayerConfig&) const;
 
@@ -25,7 +25,9 @@
 #include <shims/source_location>
 #include <shims/winrt/base.h>
 
+#include <chrono>
 #include <format>
+#include <optional>
 #include <stop_token>
 #include <string>
 
@@ -108,6 +110,13 @@ struct DPrintMessage {
 static_assert(std::is_standard_layout_v<DPrintMessage>);
 static_assert(sizeof(DPrintMessage) == DPrintMessage::StructSize);
 
+/** Shared-memory ring of `DPrintMessage`s; defined in dprint.cpp.
+ *
+ * Any number of processes can write without blocking; messages are dropped
+ * and counted if the receiver falls behind.
+ */
+struct DPrintRing;
+
 class DPrintReceiver {
  public:
   DPrintReceiver();
@@ -122,11 +131,15 @@ class DPrintReceiver {
  private:
   winrt::handle mMutex;
   winrt::handle mMapping;
-  winrt::handle mBufferReadyEvent;
   winrt::handle mDataReadyEvent;
-  DPrintMessage* mSHM = nullptr;
+  DPrintRing* mRing = nullptr;
 
   bool mUsable = false;
+
+  uint64_t mReportedDropped {0};
+  std::optional<std::chrono::steady_clock::time_point> mStalledSince;
+
+  void Drain();
 };
 
 #define OPENKNEEBOARD_LOG_SOURCE_LOCATION_AND_FATAL( \
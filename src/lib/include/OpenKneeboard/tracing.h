@@ -23,6 +23,8 @@
 #include <Windows.h>
 // clang-format on
 
+#include <OpenKneeboard/TraceRecorder.h>
+
 #include <OpenKneeboard/macros.h>
 
 #include <exception>
@@ -131,6 +133,7 @@ static_assert(OPENKNEEBOARD_HAVE_NONSTANDARD_VA_ARGS_COMMA_ELISION);
     OPENKNEEBOARD_CONCAT2(_Impl, OKBTL_ACTIVITY) \
     (decltype(OPENKNEEBOARD_CONCAT2(_StartImpl, OKBTL_ACTIVITY))& startImpl) { \
       startImpl(*this); \
+      mRecorded = ::OpenKneeboard::TraceRecorder::BeginScope(OKBTL_NAME); \
     } \
     OPENKNEEBOARD_CONCAT2(~_Impl, OKBTL_ACTIVITY)() { \
       if (mAutoStop) { \
@@ -145,6 +148,9 @@ static_assert(OPENKNEEBOARD_HAVE_NONSTANDARD_VA_ARGS_COMMA_ELISION);
       } \
       mStopped = true; \
       mAutoStop = false; \
+      if (mRecorded) { \
+        ::OpenKneeboard::TraceRecorder::EndScope(OKBTL_NAME); \
+      } \
       const auto exceptionCount = std::uncaught_exceptions(); \
       if (exceptionCount) [[unlikely]] { \
         TraceLoggingWriteStop( \
@@ -164,6 +170,7 @@ static_assert(OPENKNEEBOARD_HAVE_NONSTANDARD_VA_ARGS_COMMA_ELISION);
    private: \
     bool mStopped {false}; \
     bool mAutoStop {true}; \
+    bool mRecorded {false}; \
   }; \
   OPENKNEEBOARD_CONCAT2(_Impl, OKBTL_ACTIVITY) \
   OKBTL_ACTIVITY {OPENKNEEBOARD_CONCAT2(_StartImpl, OKBTL_ACTIVITY)};
@@ -179,6 +186,9 @@ static_assert(OPENKNEEBOARD_HAVE_NONSTANDARD_VA_ARGS_COMMA_ELISION);
     } \
     this->CancelAutoStop(); \
     mStopped = true; \
+    if (mRecorded) { \
+      ::OpenKneeboard::TraceRecorder::EndScope(OKBTL_NAME); \
+    } \
     TraceLoggingWriteStop( \
       *this, OKBTL_NAME, TraceLoggingValue(result, "Result")); \
   }
@@ -195,13 +205,16 @@ static_assert(OPENKNEEBOARD_HAVE_NONSTANDARD_VA_ARGS_COMMA_ELISION);
     OPENKNEEBOARD_CONCAT2(_okbtlsa, __COUNTER__), OKBTL_NAME, ##__VA_ARGS__)
 
 #define OPENKNEEBOARD_TraceLoggingWrite(OKBTL_NAME, ...) \
-  TraceLoggingWrite( \
-    gTraceProvider, \
-    OKBTL_NAME, \
-    TraceLoggingValue(__FILE__, "File"), \
-    TraceLoggingValue(__LINE__, "Line"), \
-    TraceLoggingValue(__FUNCTION__, "Function"), \
-    ##__VA_ARGS__)
+  do { \
+    ::OpenKneeboard::TraceRecorder::Instant(OKBTL_NAME); \
+    TraceLoggingWrite( \
+      gTraceProvider, \
+      OKBTL_NAME, \
+      TraceLoggingValue(__FILE__, "File"), \
+      TraceLoggingValue(__LINE__, "Line"), \
+      TraceLoggingValue(__FUNCTION__, "Function"), \
+      ##__VA_ARGS__); \
+  } while (false)
 
 #endif
 